@@ -0,0 +1,173 @@
+#include "activate.h"
+#include "event.h"
+#include "util.h"
+#include "workspace.h"
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <wayland-client.h>
+
+static void send_activate(struct wayws_state *state, struct ws *target) {
+  ext_workspace_handle_v1_activate(target->h);
+  ext_workspace_manager_v1_commit(state->mgr);
+  wl_display_flush(state->dpy);
+}
+
+void activate_workspace(struct wayws_state *state, struct ws *target) {
+  send_activate(state, target);
+
+  // Run the hook in the background; the loop reaps it
+  if (state->opt_exec) {
+    const char *out = get_output_name_for_workspace(target);
+    struct tpl_record ev = {
+        .type = "activate",
+        .name = target->name,
+        .id = target->id,
+        .output = out,
+        .index = (long)target->index + 1,
+        .x = target->x,
+        .y = target->y,
+        .active = target->active,
+        .urgent = target->urgent,
+        .hidden = target->hidden,
+    };
+    run_exec_hook(state, &ev);
+  }
+}
+
+// Reads and dispatches whatever arrives within ms. Returns -1 if the
+// connection failed.
+static int dispatch_for(struct wayws_state *state, int ms) {
+  while (wl_display_prepare_read(state->dpy) != 0)
+    if (wl_display_dispatch_pending(state->dpy) < 0)
+      return -1;
+  wl_display_flush(state->dpy);
+  struct pollfd pfd = {.fd = wl_display_get_fd(state->dpy), .events = POLLIN};
+  int ret = poll(&pfd, 1, ms);
+  if (ret <= 0) {
+    wl_display_cancel_read(state->dpy);
+    return ret < 0 && errno != EINTR ? -1 : 0;
+  }
+  if (wl_display_read_events(state->dpy) != 0)
+    return -1;
+  state->read_ns = monotonic_ns();
+  return wl_display_dispatch_pending(state->dpy) < 0 ? -1 : 0;
+}
+
+int activate_wait(struct wayws_state *state, slab_handle_t h, int timeout_ms) {
+  uint64_t deadline = monotonic_ns() + (uint64_t)timeout_ms * 1000000u;
+  for (;;) {
+    // Looked up again each round: the workspace may be destroyed meanwhile
+    struct ws *w = slab_get(&state->ws_slab, h);
+    if (!w)
+      return -1;
+    if (w->active)
+      return 0;
+    uint64_t now = monotonic_ns();
+    if (now >= deadline)
+      return 1;
+    if (dispatch_for(state, (int)((deadline - now) / 1000000u) + 1) < 0)
+      return -1;
+  }
+}
+
+// The next inactive workspace at or after *next, round robin
+static struct ws *next_inactive(struct wayws_state *state, size_t *next) {
+  for (size_t i = 0; i < state->vlen; i++) {
+    size_t idx = (*next + i) % state->vlen;
+    if (!state->vec[idx]->active) {
+      *next = idx + 1;
+      return state->vec[idx];
+    }
+  }
+  return NULL;
+}
+
+int activate_bench(struct wayws_state *state, int n, int timeout_ms,
+                   volatile sig_atomic_t *stop) {
+  struct ws *home = current_ws(state, NULL);
+  slab_handle_t home_h = home ? slab_handle(&state->ws_slab, home) : SLAB_NULL;
+  uint64_t *samples = xrealloc(NULL, (size_t)n * sizeof *samples);
+  size_t done = 0, next = 0;
+  int ret = 0;
+
+  while (done < (size_t)n && !*stop) {
+    struct ws *target = next_inactive(state, &next);
+    if (!target) {
+      fputs("Error: --bench-activate needs a workspace that is not active.\n",
+            stderr);
+      ret = 1;
+      break;
+    }
+    slab_handle_t h = slab_handle(&state->ws_slab, target);
+    uint64_t start = monotonic_ns();
+    send_activate(state, target);
+    int r = activate_wait(state, h, timeout_ms);
+    if (r != 0) {
+      if (r > 0)
+        fprintf(stderr, "Error: activation %zu not confirmed within %d ms.\n",
+                done + 1, timeout_ms);
+      else
+        fputs("Error: workspace went away during the benchmark.\n", stderr);
+      ret = 1;
+      break;
+    }
+    samples[done++] = monotonic_ns() - start;
+  }
+
+  // Leave the user where they started
+  if (home_h != SLAB_NULL && (home = slab_get(&state->ws_slab, home_h)) &&
+      !home->active) {
+    send_activate(state, home);
+    activate_wait(state, home_h, timeout_ms);
+  }
+  if (done)
+    activate_report(stdout, samples, done);
+  free(samples);
+  return ret;
+}
+
+static int cmp_u64(const void *a, const void *b) {
+  uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+  return (x > y) - (x < y);
+}
+
+// Nearest-rank percentile of sorted samples
+static uint64_t percentile(const uint64_t *sorted, size_t n, unsigned pct) {
+  size_t rank = ((size_t)pct * n + 99) / 100;
+  return sorted[rank ? rank - 1 : 0];
+}
+
+static unsigned log2_bucket(uint64_t us) {
+  unsigned b = 0;
+  while (us >>= 1)
+    b++;
+  return b;
+}
+
+void activate_report(FILE *f, uint64_t *samples, size_t n) {
+  if (!n)
+    return;
+  qsort(samples, n, sizeof *samples, cmp_u64);
+  fprintf(f, "activations %zu\n", n);
+  fprintf(f, "min     %10.3f ms\n", samples[0] / 1e6);
+  fprintf(f, "median  %10.3f ms\n", percentile(samples, n, 50) / 1e6);
+  fprintf(f, "p99     %10.3f ms\n", percentile(samples, n, 99) / 1e6);
+  fprintf(f, "max     %10.3f ms\n", samples[n - 1] / 1e6);
+
+  // Buckets are powers of two in microseconds, from min to max
+  size_t counts[64] = {0}, most = 0;
+  unsigned lo = log2_bucket(samples[0] / 1000);
+  unsigned hi = log2_bucket(samples[n - 1] / 1000);
+  for (size_t i = 0; i < n; i++) {
+    size_t c = ++counts[log2_bucket(samples[i] / 1000)];
+    if (c > most)
+      most = c;
+  }
+  fputc('\n', f);
+  for (unsigned b = lo; b <= hi; b++) {
+    int width = (int)((counts[b] * 40 + most - 1) / most);
+    fprintf(f, "< %8llu us |%-40.*s %zu\n", 2ull << b, width,
+            "########################################", counts[b]);
+  }
+}
@@ -0,0 +1,32 @@
+#ifndef ACTIVATE_H
+#define ACTIVATE_H
+
+#include "slab.h"
+#include "types.h"
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// --wait default, and the per-switch limit of --bench-activate
+#define ACTIVATE_WAIT_MS 1000
+
+// Sends the activation request and starts the --exec hook, if any
+void activate_workspace(struct wayws_state *state, struct ws *target);
+
+// Dispatches compositor events until the workspace behind h is active.
+// Returns 0 once it is, 1 after timeout_ms, and -1 if the workspace went
+// away or the connection failed. A workspace that is already active
+// returns 0 at once.
+int activate_wait(struct wayws_state *state, slab_handle_t h, int timeout_ms);
+
+// --bench-activate: cycles through the inactive workspaces n times,
+// timing request to confirmed activation, then switches back and prints
+// the distribution. Returns the exit status.
+int activate_bench(struct wayws_state *state, int n, int timeout_ms,
+                   volatile sig_atomic_t *stop);
+
+// Prints min/median/p99/max and a log2 histogram of samples (ns). Sorts
+// samples in place.
+void activate_report(FILE *f, uint64_t *samples, size_t n);
+
+#endif // ACTIVATE_H
@@ -0,0 +1,61 @@
+#include "backlog.h"
+#include "util.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Entry seq is v[seq - base]; slots hold seq + 1 so that 0 means none
+static struct backlog_entry *queued(struct backlog *b, unsigned long *slot) {
+  if (*slot <= b->base || *slot > b->base + b->len)
+    return NULL;
+  struct backlog_entry *e = &b->v[*slot - 1 - b->base];
+  return e->slot == slot ? e : NULL;
+}
+
+struct backlog_entry *backlog_add(struct backlog *b, unsigned long *slot) {
+  struct backlog_entry *e = slot ? queued(b, slot) : NULL;
+  if (e) {
+    b->coalesced++;
+  } else {
+    if (b->len == BACKLOG_MAX) {
+      b->dropped++;
+      return NULL;
+    }
+    if (!b->v) {
+      b->v = xrealloc(NULL, BACKLOG_MAX * sizeof *b->v);
+      memset(b->v, 0, BACKLOG_MAX * sizeof *b->v);
+    }
+    e = &b->v[b->len++];
+    e->slot = slot;
+    if (slot)
+      *slot = b->base + b->len;
+  }
+  // The buffers stay allocated from one round to the next
+  e->line.len = 0;
+  e->lat_off = SIZE_MAX;
+  e->read_ns = 0;
+  return e;
+}
+
+void backlog_take(struct backlog *b, struct outbuf *out, uint64_t now) {
+  for (size_t i = 0; i < b->len; i++) {
+    const struct backlog_entry *e = &b->v[i];
+    if (e->lat_off == SIZE_MAX) {
+      outbuf_put(out, e->line.buf, e->line.len);
+      continue;
+    }
+    outbuf_put(out, e->line.buf, e->lat_off);
+    outbuf_put_uint(out, now - e->read_ns);
+    outbuf_put(out, e->line.buf + e->lat_off, e->line.len - e->lat_off);
+  }
+  // Every slot still pointing into this round now reads as none
+  b->base += b->len;
+  b->len = 0;
+}
+
+void backlog_free(struct backlog *b) {
+  if (b->v)
+    for (size_t i = 0; i < BACKLOG_MAX; i++)
+      outbuf_free(&b->v[i].line);
+  free(b->v);
+  *b = (struct backlog){0};
+}
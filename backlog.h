@@ -0,0 +1,44 @@
+#ifndef BACKLOG_H
+#define BACKLOG_H
+
+#include "outbuf.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Watch mode's events while the reader of stdout is behind. Rather than
+// queueing more after a backlog the reader has yet to get through, whole
+// batches are held here, and an event that only restates something (a
+// workspace's state, name or coordinates) replaces the one of its kind
+// still waiting from an earlier batch. Everything else keeps its place, so
+// creation and destruction are never lost or reordered. The backlog goes
+// out in one piece once the writer has room again.
+#define BACKLOG_MAX 4096 // entries; past that, events are dropped and counted
+
+struct backlog_entry {
+  unsigned long *slot; // only compared; NULL if nothing may replace it
+  struct outbuf line;
+  size_t lat_off; // where latency_ns goes in line, SIZE_MAX for nowhere
+  uint64_t read_ns;
+};
+
+// A zeroed backlog is empty and ready to use
+struct backlog {
+  struct backlog_entry *v; // BACKLOG_MAX, allocated on first use
+  size_t len;
+  unsigned long base;      // sequence number of v[0]
+  unsigned long coalesced; // events replaced by a newer one
+  unsigned long dropped;   // events that found the backlog full
+};
+
+// Returns the entry to serialize the next event into, or NULL if the
+// backlog is full and the event is dropped. slot, when not NULL, is the
+// caller's record (0 = none) of where its latest replaceable event of this
+// kind waits: if that entry is still queued it is emptied and reused in
+// place, otherwise a new one is appended and slot updated.
+struct backlog_entry *backlog_add(struct backlog *b, unsigned long *slot);
+// Appends every entry to out in order, latencies measured up to now, and
+// empties the backlog
+void backlog_take(struct backlog *b, struct outbuf *out, uint64_t now);
+void backlog_free(struct backlog *b);
+
+#endif // BACKLOG_H
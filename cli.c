@@ -0,0 +1,366 @@
+/* cli.c – command-line parsing
+ *
+ * Shared by main() and the daemon, which parses every forwarded command
+ * line against its own long-lived state.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
+
+#include "cli.h"
+#include "activate.h"
+#include "exec.h"
+#include "filter.h"
+#include "proc.h"
+#include "rules.h"
+#include "template.h"
+#include "util.h"
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Prints the help; outside the daemon that ends the process
+static int usage(const struct wayws_state *state, const char *prg,
+                 int forwarded) {
+  printf("Usage: %s [options] [<index>|<name>]\n\n"
+         "Options:\n"
+         "  -l, --list           List workspaces\n"
+         "  -w, --watch          Stay running and print JSON events\n"
+         "      --events LIST    With -w, only print these event types\n"
+         "                       (e.g. state,created,destroyed)\n"
+         "      --match KEY=VAL  With -w, only print events matching\n"
+         "                       active=, urgent=, hidden=, output= or name=\n"
+         "  -g, --grid N         Set grid width (default: 3)\n"
+         "  -e, --exec CMD       Execute command after an event or switch\n"
+         "      --exec-jobs N    Run at most N hooks at once (default: 1)\n"
+         "      --exec-direct    Run --exec CMD without a shell (split on blanks)\n"
+         "      --signal NAME:SIG  With -w, signal process NAME once per batch\n"
+         "                       of printed events (e.g. waybar:RTMIN+1)\n"
+         "      --latency        With -w, add latency_ns (read to queued for\n"
+         "                       output) to events\n"
+         "      --stats          With -w, report output queue depth, high-water\n"
+         "                       mark, drops and coalesced events on exit and\n"
+         "                       on SIGUSR1\n"
+         "      --rules FILE     With -w or --daemon, run the actions in FILE\n"
+         "      --waybar         Output in Waybar JSON format\n"
+         "      --json           Output in raw JSON format\n"
+         "      --output NAME    Filter output by output name\n"
+         "      --format TPL     Print -l, --json and -w records as TPL,\n"
+         "                       e.g. '{index}\\t{name}\\t{output}\\t{active}'\n"
+         "      --glyph-active G Set active workspace glyph (default: %s)\n"
+         "      --glyph-empty G  Set empty workspace glyph (default: %s)\n"
+         "      --id ID          Activate the workspace with protocol id ID\n"
+         "      --wait[=MS]      After switching, wait until the compositor reports\n"
+         "                       the workspace active (default: 1000 ms)\n"
+         "      --bench-activate N  Time N switches, print the latency distribution\n"
+         "      --up, --down, --left, --right  Navigate workspaces\n"
+         "      --daemon         Keep the connection open and serve commands\n"
+         "      --no-daemon      Do not forward the command to a running daemon\n"
+         "      --subscribe      With -w, read events from a running --serve\n"
+         "                       (JSON only; starts from a state snapshot)\n"
+         "      --serve          Keep the connection open and stream events to\n"
+         "                       every -w --subscribe on this display\n"
+         "      --from-shm       Print -l or --json from the snapshot a running\n"
+         "                       -w, --daemon or --serve publishes\n"
+         "      --debug-info     Print debugging information\n",
+         prg, state->glyph_active, state->glyph_empty);
+  if (!forwarded)
+    exit(1);
+  return 1;
+}
+
+// die(), unless the daemon is parsing a client's command line: one bad
+// request must not take it down, so the client gets the message instead
+static int reject(int forwarded, const char *msg) {
+  if (!forwarded)
+    die(msg);
+  fputs(msg, stderr);
+  return 1;
+}
+
+int parse_cli(struct wayws_state *state, int ac, char **av, int forwarded) {
+  static struct option longopts[] = {{"list", 0, 0, 'l'},
+                                     {"watch", 0, 0, 'w'},
+                                     {"grid", 1, 0, 'g'},
+                                     {"exec", 1, 0, 'e'},
+                                     {"waybar", 0, 0, 1004},
+                                     {"json", 0, 0, 1009},
+                                     {"output", 1, 0, 1010},
+                                     {"glyph-active", 1, 0, 1005},
+                                     {"glyph-empty", 1, 0, 1006},
+                                     {"up", 0, 0, 1000},
+                                     {"down", 0, 0, 1001},
+                                     {"left", 0, 0, 1002},
+                                     {"right", 0, 0, 1003},
+                                     {"debug-info", 0, 0, 1008},
+                                     {"daemon", 0, 0, 1011},
+                                     {"no-daemon", 0, 0, 1012},
+                                     {"id", 1, 0, 1013},
+                                     {"events", 1, 0, 1014},
+                                     {"match", 1, 0, 1015},
+                                     {"format", 1, 0, 1016},
+                                     {"exec-jobs", 1, 0, 1017},
+                                     {"exec-direct", 0, 0, 1018},
+                                     {"rules", 1, 0, 1019},
+                                     {"signal", 1, 0, 1020},
+                                     {"latency", 0, 0, 1021},
+                                     {"wait", 2, 0, 1022},
+                                     {"bench-activate", 1, 0, 1023},
+                                     {"serve", 0, 0, 1024},
+                                     {"from-shm", 0, 0, 1025},
+                                     {"stats", 0, 0, 1026},
+                                     {"subscribe", 0, 0, 1027},
+                                     {0, 0, 0, 0}};
+  int ch;
+  int filtered = 0;
+  const char *rules_path = NULL;
+  while ((ch = getopt_long(ac, av, "lwg:e:", longopts, NULL)) != -1) {
+    switch (ch) {
+    case 'l':
+      state->flag_list = 1;
+      break;
+    case 'w':
+      state->flag_watch = 1;
+      state->event_enabled = 1;  // Enable events when watch mode is on
+      break;
+    case 'g':
+      state->grid_cols = atoi(optarg);
+      if (state->grid_cols <= 0)
+        return usage(state, av[0], forwarded);
+      break;
+    case 'e':
+      state->opt_exec = optarg;
+      break;
+    case 1000:
+      state->move_dir = DIR_UP;
+      break;
+    case 1001:
+      state->move_dir = DIR_DOWN;
+      break;
+    case 1002:
+      state->move_dir = DIR_LEFT;
+      break;
+    case 1003:
+      state->move_dir = DIR_RIGHT;
+      break;
+    case 1004:
+      state->flag_waybar = 1;
+      break;
+    case 1009:
+      state->flag_json = 1;
+      break;
+    case 1010:
+      state->opt_output_name = optarg;
+      break;
+    case 1005:
+      state->glyph_active = optarg;
+      break;
+    case 1006:
+      state->glyph_empty = optarg;
+      break;
+    case 1008:
+      state->flag_debug = 1;
+      break;
+    case 1011:
+      state->flag_daemon = 1;
+      break;
+    case 1012:
+      state->flag_no_daemon = 1;
+      break;
+    case 1013:
+      state->want_id = optarg;
+      break;
+    case 1014:
+      if (filter_parse_events(&state->event_filter, optarg) != 0)
+        return reject(forwarded, "Error: Unknown event type in --events.\n");
+      filtered = 1;
+      break;
+    case 1015:
+      if (filter_parse_match(&state->event_filter, optarg) != 0)
+        return reject(forwarded, "Error: --match expects active=, urgent=, "
+                                 "hidden= (true/false), output= or name=.\n");
+      filtered = 1;
+      break;
+    case 1017:
+      state->exec.limit = atoi(optarg);
+      if (state->exec.limit <= 0 || state->exec.limit > EXEC_MAX_JOBS)
+        return reject(forwarded,
+                      "Error: --exec-jobs expects a number from 1 to 16.\n");
+      break;
+    case 1018:
+      state->flag_exec_direct = 1;
+      break;
+    case 1019:
+      rules_path = optarg;
+      break;
+    case 1020:
+      state->signals = xrealloc(state->signals, (state->nsignals + 1) *
+                                                    sizeof *state->signals);
+      if (proc_target_parse(&state->signals[state->nsignals], optarg) != 0)
+        return reject(forwarded, "Error: --signal expects NAME:SIG "
+                                 "(e.g. waybar:RTMIN+1).\n");
+      state->nsignals++;
+      break;
+    case 1021:
+      state->flag_latency = 1;
+      break;
+    case 1022:
+      state->wait_ms = optarg ? atoi(optarg) : ACTIVATE_WAIT_MS;
+      if (state->wait_ms <= 0)
+        return reject(forwarded,
+                      "Error: --wait expects a timeout in milliseconds.\n");
+      break;
+    case 1023:
+      state->bench_activations = atoi(optarg);
+      if (state->bench_activations <= 0)
+        return reject(forwarded, "Error: --bench-activate expects a number "
+                                 "of switches.\n");
+      break;
+    case 1024:
+      state->flag_serve = 1;
+      break;
+    case 1025:
+      state->flag_from_shm = 1;
+      break;
+    case 1026:
+      state->flag_stats = 1;
+      break;
+    case 1027:
+      state->flag_subscribe = 1;
+      break;
+    case 1016:
+      template_free(&state->format);
+      if (template_compile(&state->format, optarg) != 0)
+        return reject(forwarded, "Error: Invalid --format template (unknown "
+                                 "field or stray brace).\n");
+      state->opt_format = optarg;
+      break;
+    default:
+      return usage(state, av[0], forwarded);
+    }
+  }
+  if (optind < ac) {
+    if (state->move_dir != DIR_NONE)
+      return reject(forwarded, "Error: Cannot combine a directional move "
+                               "with an index or name.\n");
+    if (isnum(av[optind]))
+      state->want_idx = atoi(av[optind]);
+    else
+      state->want_name = av[optind];
+    ++optind;
+  }
+  if (optind != ac)
+    return usage(state, av[0], forwarded);
+  if (state->want_id &&
+      (state->want_idx > 0 || state->want_name || state->move_dir != DIR_NONE))
+    return reject(forwarded, "Error: --id cannot be combined with an index, "
+                             "name or direction.\n");
+  if (filtered && !state->flag_watch)
+    return reject(forwarded,
+                  "Error: --events and --match only apply to --watch.\n");
+  if (state->nsignals && !state->flag_watch)
+    return reject(forwarded, "Error: --signal only applies to --watch.\n");
+  if (state->flag_latency && (!state->flag_watch || state->opt_format))
+    return reject(forwarded,
+                  "Error: --latency only applies to --watch JSON events.\n");
+  if (state->flag_stats && !state->flag_watch)
+    return reject(forwarded, "Error: --stats only applies to --watch.\n");
+  if (rules_path) {
+    if (!state->flag_watch && !state->flag_daemon)
+      return reject(forwarded, "Error: --rules needs --watch or --daemon.\n");
+    char err[256], msg[300];
+    rules_free(state->rules);
+    state->rules = rules_load(rules_path, err, sizeof err);
+    if (!state->rules) {
+      snprintf(msg, sizeof msg, "Error: --rules: %s\n", err);
+      return reject(forwarded, msg);
+    }
+  }
+  if (state->flag_exec_direct) {
+    if (!state->opt_exec)
+      return reject(forwarded, "Error: --exec-direct needs --exec CMD.\n");
+    state->exec_argv = exec_split(state->opt_exec);
+    if (!state->exec_argv)
+      return reject(forwarded, "Error: --exec command is empty.\n");
+  }
+  int switching = (state->want_idx > 0) || state->want_name ||
+                  state->want_id || state->move_dir != DIR_NONE;
+  if (state->wait_ms && !switching && !state->bench_activations)
+    return reject(forwarded, "Error: --wait needs a workspace to activate.\n");
+  if (state->bench_activations && (switching || state->flag_watch))
+    return reject(forwarded, "Error: --bench-activate picks its own "
+                             "workspaces and cannot be combined with a "
+                             "switch or --watch.\n");
+  if (state->flag_serve &&
+      (state->flag_list || switching || state->flag_watch ||
+       state->flag_waybar || state->flag_json || state->flag_debug ||
+       state->flag_daemon || state->bench_activations || state->opt_exec ||
+       state->opt_format || rules_path))
+    return reject(forwarded, "Error: --serve cannot be combined with other "
+                             "commands; filters and formats belong to each "
+                             "-w.\n");
+  // An event server only prints JSON events; anything that acts on them or
+  // lists first needs a model of its own
+  if (state->flag_subscribe &&
+      (!state->flag_watch || state->flag_no_daemon || state->flag_list ||
+       switching || state->flag_waybar || state->flag_json ||
+       state->flag_debug || state->opt_exec || state->opt_format ||
+       rules_path || state->nsignals || state->flag_latency ||
+       state->flag_stats))
+    return reject(forwarded, "Error: --subscribe only applies to a plain "
+                             "--watch, with --events and --match at most.\n");
+  if (state->flag_from_shm &&
+      ((!state->flag_list && !state->flag_json) || switching ||
+       state->flag_watch || state->flag_waybar || state->flag_debug ||
+       state->flag_daemon || state->flag_serve || state->bench_activations))
+    return reject(forwarded,
+                  "Error: --from-shm only applies to -l and --json.\n");
+  if (!state->flag_list && !switching && !state->flag_watch &&
+      !state->flag_waybar && !state->flag_json && !state->flag_debug &&
+      !state->flag_daemon && !state->bench_activations && !state->flag_serve)
+    return usage(state, av[0], forwarded);
+  return 0;
+}
+
+void free_signals(struct wayws_state *state) {
+  for (size_t i = 0; i < state->nsignals; i++)
+    proc_target_close(&state->signals[i]);
+  free(state->signals);
+  state->signals = NULL;
+  state->nsignals = 0;
+}
+
+void set_cli_defaults(struct wayws_state *state) {
+  state->flag_list = 0;
+  state->flag_watch = 0;
+  state->flag_waybar = 0;
+  state->flag_json = 0;
+  state->flag_debug = 0;
+  state->flag_daemon = 0;
+  state->flag_no_daemon = 0;
+  state->flag_subscribe = 0;
+  state->flag_serve = 0;
+  state->flag_from_shm = 0;
+  state->opt_exec = NULL;
+  state->flag_exec_direct = 0;
+  exec_free_argv(state->exec_argv);
+  state->exec_argv = NULL;
+  state->exec.limit = 1;
+  free_signals(state);
+  state->flag_latency = 0;
+  state->flag_stats = 0;
+  state->wait_ms = 0;
+  state->bench_activations = 0;
+  state->opt_output_name = NULL;
+  state->opt_format = NULL;
+  template_free(&state->format);
+  state->glyph_active = "●";
+  state->glyph_empty = "○";
+  state->want_idx = -1;
+  state->want_name = NULL;
+  state->want_id = NULL;
+  state->move_dir = DIR_NONE;
+  state->event_filter = (struct event_filter){0};
+  state->grid_cols = 3;
+  state->event_enabled = 0; // Events disabled by default
+}
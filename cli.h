@@ -0,0 +1,18 @@
+#ifndef CLI_H
+#define CLI_H
+
+#include "types.h"
+
+// Parses the command line into state. A bad one prints why and exits,
+// unless forwarded is set (the daemon, serving a client), in which case
+// the message goes to stderr and parse_cli() returns 1; 0 on success.
+int parse_cli(struct wayws_state *state, int ac, char **av, int forwarded);
+
+// Resets everything parse_cli() may set, so the daemon can parse each
+// forwarded command line against the same long-lived state
+void set_cli_defaults(struct wayws_state *state);
+
+// Closes and forgets the --signal targets
+void free_signals(struct wayws_state *state);
+
+#endif // CLI_H
@@ -0,0 +1,258 @@
+#define _GNU_SOURCE
+
+#include "daemon.h"
+#include "exec.h"
+#include "types.h"
+#include "util.h"
+#include <errno.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Wire format (client -> daemon): a uint32_t payload length followed by the
+// NUL-separated argv. The client's stdout and stderr travel alongside as
+// SCM_RIGHTS so the daemon writes straight into the caller's terminal/pipe.
+// Reply (daemon -> client): one int32_t exit status.
+#define DAEMON_MAX_PAYLOAD 4096
+#define DAEMON_MAX_ARGS 64
+
+int daemon_socket_path(char *buf, size_t len) {
+  const char *dir = getenv("XDG_RUNTIME_DIR");
+  if (!dir || !*dir)
+    return -1;
+  const char *display = getenv("WAYLAND_DISPLAY");
+  if (!display || !*display)
+    display = "wayland-0";
+  const char *slash = strrchr(display, '/');
+  if (slash)
+    display = slash + 1;
+  int n = snprintf(buf, len, "%s/wayws-%s.sock", dir, display);
+  return (n < 0 || (size_t)n >= len) ? -1 : 0;
+}
+
+static int socket_addr(struct sockaddr_un *addr) {
+  memset(addr, 0, sizeof *addr);
+  addr->sun_family = AF_UNIX;
+  return daemon_socket_path(addr->sun_path, sizeof addr->sun_path);
+}
+
+static int connect_daemon(void) {
+  struct sockaddr_un addr;
+  if (socket_addr(&addr) != 0)
+    return -1;
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0)
+    return -1;
+  if (connect(fd, (struct sockaddr *)&addr, sizeof addr) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+// Returns 0 when a running daemon handled the command (its exit status is
+// stored in *status), or -1 when the caller should talk to Wayland itself.
+int daemon_forward(int argc, char **argv, int *status) {
+  char payload[DAEMON_MAX_PAYLOAD];
+  uint32_t len = 0;
+  if (argc > DAEMON_MAX_ARGS)
+    return -1;
+  for (int i = 0; i < argc; i++) {
+    size_t n = strlen(argv[i]) + 1;
+    if (len + n > sizeof payload)
+      return -1;
+    memcpy(payload + len, argv[i], n);
+    len += n;
+  }
+
+  int fd = connect_daemon();
+  if (fd < 0)
+    return -1;
+
+  int fds[2] = {STDOUT_FILENO, STDERR_FILENO};
+  union {
+    char buf[CMSG_SPACE(sizeof fds)];
+    struct cmsghdr align;
+  } ctl;
+  memset(&ctl, 0, sizeof ctl);
+  struct iovec iov[2] = {{&len, sizeof len}, {payload, len}};
+  struct msghdr msg = {.msg_iov = iov,
+                       .msg_iovlen = 2,
+                       .msg_control = ctl.buf,
+                       .msg_controllen = sizeof ctl.buf};
+  struct cmsghdr *c = CMSG_FIRSTHDR(&msg);
+  c->cmsg_level = SOL_SOCKET;
+  c->cmsg_type = SCM_RIGHTS;
+  c->cmsg_len = CMSG_LEN(sizeof fds);
+  memcpy(CMSG_DATA(c), fds, sizeof fds);
+
+  if (sendmsg(fd, &msg, MSG_NOSIGNAL) != (ssize_t)(sizeof len + len)) {
+    close(fd);
+    return -1;
+  }
+
+  // The request has been delivered; from here on we must not fall back to a
+  // direct connection or the command could run twice.
+  int32_t st;
+  if (recv(fd, &st, sizeof st, MSG_WAITALL) != (ssize_t)sizeof st) {
+    fputs("wayws: daemon closed the connection without replying.\n", stderr);
+    st = 1;
+  }
+  close(fd);
+  *status = st;
+  return 0;
+}
+
+static int listen_daemon(void) {
+  struct sockaddr_un addr;
+  if (socket_addr(&addr) != 0)
+    die("XDG_RUNTIME_DIR is not set; cannot create daemon socket.\n");
+
+  int probe = connect_daemon();
+  if (probe >= 0) {
+    close(probe);
+    die("Another wayws daemon is already running.\n");
+  }
+  unlink(addr.sun_path);
+
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+  if (fd < 0)
+    die("Failed to create daemon socket.\n");
+  mode_t old_mask = umask(0077);
+  int ret = bind(fd, (struct sockaddr *)&addr, sizeof addr);
+  umask(old_mask);
+  if (ret != 0 || listen(fd, 16) != 0)
+    die("Failed to bind daemon socket.\n");
+  return fd;
+}
+
+static int run_redirected(struct wayws_state *state, daemon_command_fn run,
+                          int out, int err, int argc, char **argv) {
+  fflush(stdout);
+  fflush(stderr);
+  int saved_out = dup(STDOUT_FILENO);
+  int saved_err = dup(STDERR_FILENO);
+  dup2(out, STDOUT_FILENO);
+  dup2(err, STDERR_FILENO);
+
+  int status = run(state, argc, argv);
+
+  fflush(stdout);
+  fflush(stderr);
+  dup2(saved_out, STDOUT_FILENO);
+  dup2(saved_err, STDERR_FILENO);
+  close(saved_out);
+  close(saved_err);
+  return status;
+}
+
+void daemon_serve_client(struct wayws_state *state, daemon_command_fn run,
+                         int cfd) {
+  // A stuck client must not wedge the daemon.
+  struct timeval tv = {.tv_sec = 1};
+  setsockopt(cfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof tv);
+
+  uint32_t len = 0;
+  int fds[2] = {-1, -1};
+  union {
+    char buf[CMSG_SPACE(sizeof fds)];
+    struct cmsghdr align;
+  } ctl;
+  struct iovec iov = {&len, sizeof len};
+  struct msghdr msg = {.msg_iov = &iov,
+                       .msg_iovlen = 1,
+                       .msg_control = ctl.buf,
+                       .msg_controllen = sizeof ctl.buf};
+  if (recvmsg(cfd, &msg, MSG_WAITALL | MSG_CMSG_CLOEXEC) != sizeof len)
+    return;
+  for (struct cmsghdr *c = CMSG_FIRSTHDR(&msg); c; c = CMSG_NXTHDR(&msg, c))
+    if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_RIGHTS &&
+        c->cmsg_len == CMSG_LEN(sizeof fds))
+      memcpy(fds, CMSG_DATA(c), sizeof fds);
+
+  int32_t status = 1;
+  char payload[DAEMON_MAX_PAYLOAD + 1];
+  char *argv[DAEMON_MAX_ARGS + 1];
+  int argc = 0;
+  if (fds[0] < 0 || fds[1] < 0 || len == 0 || len > DAEMON_MAX_PAYLOAD ||
+      recv(cfd, payload, len, MSG_WAITALL) != (ssize_t)len)
+    goto reply;
+  payload[len] = '\0';
+  for (uint32_t off = 0; off < len && argc < DAEMON_MAX_ARGS;) {
+    argv[argc++] = payload + off;
+    off += strlen(payload + off) + 1;
+  }
+  argv[argc] = NULL;
+  status = run_redirected(state, run, fds[0], fds[1], argc, argv);
+
+reply:
+  send(cfd, &status, sizeof status, MSG_NOSIGNAL);
+  if (fds[0] >= 0)
+    close(fds[0]);
+  if (fds[1] >= 0)
+    close(fds[1]);
+}
+
+int daemon_run(struct wayws_state *state, daemon_command_fn run,
+               volatile sig_atomic_t *stop) {
+  char path[sizeof(((struct sockaddr_un *)0)->sun_path)];
+  int lfd = listen_daemon();
+  daemon_socket_path(path, sizeof path);
+  // Clients that exit early (e.g. `wayws -l | head -1`) must not kill us.
+  signal(SIGPIPE, SIG_IGN);
+
+  int ret = 0;
+  while (!*stop) {
+    while (wl_display_prepare_read(state->dpy) != 0)
+      wl_display_dispatch_pending(state->dpy);
+    wl_display_flush(state->dpy);
+
+    struct pollfd pfd[3] = {
+        {.fd = wl_display_get_fd(state->dpy), .events = POLLIN},
+        {.fd = lfd, .events = POLLIN},
+        // --exec hooks started by served commands; -1 (ignored) until then
+        {.fd = exec_fd(&state->exec), .events = POLLIN},
+    };
+    if (poll(pfd, 3, -1) < 0) {
+      wl_display_cancel_read(state->dpy);
+      if (errno == EINTR)
+        continue;
+      ret = 1;
+      break;
+    }
+
+    if (pfd[0].revents) {
+      if (wl_display_read_events(state->dpy) != 0) {
+        fputs("Lost connection to the Wayland compositor.\n", stderr);
+        ret = 1;
+        break;
+      }
+    } else {
+      wl_display_cancel_read(state->dpy);
+    }
+    wl_display_dispatch_pending(state->dpy);
+
+    if (pfd[2].revents & POLLIN)
+      exec_reap(&state->exec);
+
+    if (pfd[1].revents & POLLIN) {
+      int cfd = accept4(lfd, NULL, NULL, SOCK_CLOEXEC);
+      if (cfd >= 0) {
+        daemon_serve_client(state, run, cfd);
+        close(cfd);
+      }
+    }
+  }
+
+  close(lfd);
+  unlink(path);
+  return ret;
+}
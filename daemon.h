@@ -0,0 +1,23 @@
+#ifndef DAEMON_H
+#define DAEMON_H
+
+#include "types.h"
+#include <signal.h>
+#include <stddef.h>
+
+// Runs one forwarded command line against the live model and returns the
+// exit status that should be reported back to the client.
+typedef int (*daemon_command_fn)(struct wayws_state *state, int argc,
+                                 char **argv);
+
+int daemon_socket_path(char *buf, size_t len);
+int daemon_forward(int argc, char **argv, int *status);
+int daemon_run(struct wayws_state *state, daemon_command_fn run,
+               volatile sig_atomic_t *stop);
+// Reads one request from an accepted connection, runs it with the client's
+// stdout and stderr, and replies with its status. Whatever the command line,
+// the daemon carries on with the next client afterwards.
+void daemon_serve_client(struct wayws_state *state, daemon_command_fn run,
+                         int cfd);
+
+#endif // DAEMON_H
@@ -1,16 +1,173 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <time.h>
+#include <unistd.h>
 #include "event.h"
+#include "backlog.h"
+#include "exec.h"
+#include "filter.h"
+#include "outbuf.h"
+#include "proc.h"
+#include "rules.h"
+#include "serve.h"
+#include "shm.h"
+#include "template.h"
 #include "util.h"
+#include "writer.h"
+
+// Type names, indexed by wayws_event_type_t
+struct event_name {
+    const char *s;
+    size_t len;
+};
+
+static const struct event_name event_names[] = {
+#define NAME(t, n) [t] = {n, sizeof(n) - 1}
+    NAME(EVENT_WORKSPACE_CREATED, "workspace_created"),
+    NAME(EVENT_WORKSPACE_DESTROYED, "workspace_destroyed"),
+    NAME(EVENT_WORKSPACE_ID, "workspace_id"),
+    NAME(EVENT_WORKSPACE_NAME, "workspace_name"),
+    NAME(EVENT_WORKSPACE_COORDINATES, "workspace_coordinates"),
+    NAME(EVENT_WORKSPACE_CAPABILITIES, "workspace_capabilities"),
+    NAME(EVENT_WORKSPACE_STATE, "workspace_state"),
+    NAME(EVENT_GROUP_CAPABILITIES, "group_capabilities"),
+    NAME(EVENT_GROUP_REMOVED, "group_removed"),
+    NAME(EVENT_WORKSPACE_ENTER, "workspace_enter"),
+    NAME(EVENT_WORKSPACE_LEAVE, "workspace_leave"),
+    NAME(EVENT_OUTPUT_ENTER, "output_enter"),
+    NAME(EVENT_OUTPUT_LEAVE, "output_leave"),
+#undef NAME
+};
+
+static const struct event_name *lookup_name(wayws_event_type_t type) {
+    static const struct event_name unknown = {"unknown", sizeof("unknown") - 1};
+    if ((size_t)type >= sizeof(event_names) / sizeof(event_names[0]) ||
+        !event_names[type].s)
+        return &unknown;
+    return &event_names[type];
+}
+
+const char *event_type_name(wayws_event_type_t type) {
+    return lookup_name(type)->s;
+}
+
+// Everything but the closing brace of an event's JSON object
+static void serialize_fields(struct outbuf *b, const wayws_event_t *ev) {
+    const struct event_name *name = lookup_name(ev->type);
+    outbuf_lit(b, "{\"type\":\"");
+    outbuf_put(b, name->s, name->len);
+    outbuf_lit(b, "\",\"workspace\":{\"name\":");
+    outbuf_put_json_string(b, ev->workspace_name);
+    outbuf_lit(b, ",\"index\":");
+    outbuf_put_int(b, ev->workspace_index);
+    outbuf_lit(b, ",\"output\":");
+    outbuf_put_json_string(b, ev->output_name);
+    outbuf_lit(b, ",\"x\":");
+    outbuf_put_int(b, ev->x);
+    outbuf_lit(b, ",\"y\":");
+    outbuf_put_int(b, ev->y);
+    outbuf_lit(b, ",\"active\":");
+    outbuf_put_bool(b, ev->active);
+    outbuf_lit(b, ",\"urgent\":");
+    outbuf_put_bool(b, ev->urgent);
+    outbuf_lit(b, ",\"hidden\":");
+    outbuf_put_bool(b, ev->hidden);
+    outbuf_lit(b, "},\"timestamp\":");
+    outbuf_put_uint(b, ev->timestamp);
+}
+
+// Appends one event as a JSON line
+void serialize_event(struct outbuf *b, const wayws_event_t *ev) {
+    serialize_fields(b, ev);
+    outbuf_lit(b, "}\n");
+}
+
+// Leaves room for latency_ns, which is only known once the event is written
+static void serialize_with_latency(struct wayws_state *state, const wayws_event_t *ev) {
+    struct outbuf *b = &state->event_out;
+    serialize_fields(b, ev);
+    outbuf_lit(b, ",\"latency_ns\":");
+    if (state->nlat == state->lat_cap) {
+        state->lat_cap = state->lat_cap ? 2 * state->lat_cap : 64;
+        state->lat_marks = xrealloc(state->lat_marks,
+                                    state->lat_cap * sizeof(*state->lat_marks));
+    }
+    state->lat_marks[state->nlat++] = (struct latency_mark){b->len, state->read_ns};
+    outbuf_lit(b, "}\n");
+}
+
+// Where w's latest event of this type waits in the backlog, if a newer one
+// may replace it. Any other event about w starts afresh, so nothing is
+// replaced across a creation, destruction, enter or leave.
+static unsigned long *backlog_slot(struct ws *w, wayws_event_type_t type) {
+    if (!w)
+        return NULL;
+    switch (type) {
+    case EVENT_WORKSPACE_STATE:
+        return &w->backlog_seq[0];
+    case EVENT_WORKSPACE_NAME:
+        return &w->backlog_seq[1];
+    case EVENT_WORKSPACE_COORDINATES:
+        return &w->backlog_seq[2];
+    default:
+        memset(w->backlog_seq, 0, sizeof(w->backlog_seq));
+        return NULL;
+    }
+}
+
+// Serializes the event into its backlog entry instead of event_out; the
+// latency is measured when the backlog is handed to the writer
+static void backlog_event(struct wayws_state *state, const wayws_event_t *ev,
+                          const struct tpl_record *r) {
+    struct backlog_entry *e =
+        backlog_add(&state->backlog, backlog_slot(ev->additional_data, ev->type));
+    if (!e)
+        return;
+    if (state->opt_format) {
+        template_render(&state->format, &e->line, r);
+    } else if (state->flag_latency && state->read_ns) {
+        serialize_fields(&e->line, ev);
+        outbuf_lit(&e->line, ",\"latency_ns\":");
+        e->lat_off = e->line.len;
+        e->read_ns = state->read_ns;
+        outbuf_lit(&e->line, "}\n");
+    } else {
+        serialize_event(&e->line, ev);
+    }
+}
+
+// Splices the latencies into the queue right before it is written. The
+// spliced copy becomes event_out, so neither buffer is reallocated per batch.
+static void fill_latencies(struct wayws_state *state) {
+    uint64_t now = monotonic_ns();
+    struct outbuf *in = &state->event_out, *out = &state->lat_out;
+    size_t from = 0;
+    out->len = 0;
+    for (size_t i = 0; i < state->nlat; i++) {
+        const struct latency_mark *m = &state->lat_marks[i];
+        outbuf_put(out, in->buf + from, m->off - from);
+        outbuf_put_uint(out, now - m->read_ns);
+        from = m->off;
+    }
+    outbuf_put(out, in->buf + from, in->len - from);
+    state->nlat = 0;
+    struct outbuf tmp = *in;
+    *in = *out;
+    *out = tmp;
+}
 
 // Event emission function
 void emit_event(struct wayws_state *state, wayws_event_type_t type,
                 const char *workspace_name, const char *output_name,
                 int workspace_index, int x, int y, int active, int urgent, int hidden,
                 enum dir direction, void *additional_data) {
-    if (!state->event_enabled && !state->event_callback)
+    // Filtered-out events are dropped before anything is formatted
+    int print = state->event_enabled &&
+                filter_accepts(&state->event_filter, type, workspace_name, output_name,
+                               active, urgent, hidden);
+    // Only rules compiled for this type are looked at
+    int ruled = rules_want(state->rules, type);
+    if (!print && !ruled && !state->event_callback)
         return;
     
     wayws_event_t event = {
@@ -24,35 +181,45 @@ void emit_event(struct wayws_state *state, wayws_event_type_t type,
         .urgent = urgent,
         .hidden = hidden,
         .direction = direction,
-        .timestamp = (unsigned long)time(NULL),
+        .timestamp = monotonic_ns(),
         .additional_data = additional_data
     };
+    const struct ws *w = additional_data;
+    struct tpl_record r = {
+        .name = event.workspace_name,
+        .id = w && w->id ? w->id : "",
+        .output = event.output_name,
+        .type = event_type_name(type),
+        .index = workspace_index,
+        .x = x,
+        .y = y,
+        .active = active,
+        .urgent = urgent,
+        .hidden = hidden,
+        .timestamp = event.timestamp,
+    };
+    
+    if (ruled)
+        rules_dispatch(state, type, &r);
     
-    // JSON format output
-    if (state->event_enabled) {
-        printf("{\"type\":\"%s\",\"workspace\":{\"name\":\"%s\",\"index\":%d,\"output\":\"%s\",\"x\":%d,\"y\":%d,\"active\":%s,\"urgent\":%s,\"hidden\":%s},\"timestamp\":%lu",
-               type == EVENT_WORKSPACE_CREATED ? "workspace_created" :
-               type == EVENT_WORKSPACE_DESTROYED ? "workspace_destroyed" :
-               type == EVENT_WORKSPACE_ID ? "workspace_id" :
-               type == EVENT_WORKSPACE_NAME ? "workspace_name" :
-               type == EVENT_WORKSPACE_COORDINATES ? "workspace_coordinates" :
-               type == EVENT_WORKSPACE_CAPABILITIES ? "workspace_capabilities" :
-               type == EVENT_WORKSPACE_STATE ? "workspace_state" :
-               type == EVENT_GROUP_CAPABILITIES ? "group_capabilities" :
-               type == EVENT_GROUP_REMOVED ? "group_removed" :
-               type == EVENT_WORKSPACE_ENTER ? "workspace_enter" :
-               type == EVENT_WORKSPACE_LEAVE ? "workspace_leave" :
-               type == EVENT_OUTPUT_ENTER ? "output_enter" :
-               type == EVENT_OUTPUT_LEAVE ? "output_leave" :
-               "unknown",
-               workspace_name ? workspace_name : "", workspace_index, 
-               output_name ? output_name : "", x, y,
-               active ? "true" : "false", urgent ? "true" : "false", hidden ? "true" : "false",
-               event.timestamp);
-        
-
-        printf("}\n");
-        fflush(stdout);
+    // Queued until the batch ends; only a runaway batch is written early
+    if (print) {
+        if (state->serve)
+            serve_append(state->serve, &event);
+        else if (state->backlogging)
+            backlog_event(state, &event, &r);
+        else if (state->opt_format)
+            template_render(&state->format, &state->event_out, &r);
+        else if (state->flag_latency && state->read_ns)
+            serialize_with_latency(state, &event);
+        else
+            serialize_event(&state->event_out, &event);
+        // The batch's hook run describes its last printed event
+        if (state->opt_exec)
+            exec_note(&state->exec, &r);
+        state->batch_events++;
+        if (state->event_out.len >= EVENT_OUT_FLUSH_AT)
+            flush_events(state);
     }
     
     // Call custom event callback if provided
@@ -61,6 +228,69 @@ void emit_event(struct wayws_state *state, wayws_event_type_t type,
     }
 }
 
+// Writes queued events to stdout with a single write(), or hands them to
+// the writer thread
+void flush_events(struct wayws_state *state) {
+    if (!state->event_out.len)
+        return;
+    if (state->nlat)
+        fill_latencies(state);
+    if (state->writer) {
+        writer_push(state->writer, state->event_out.buf, state->event_out.len);
+        state->event_out.len = 0;
+        return;
+    }
+    // Anything printed through stdio so far must go out first
+    fflush(stdout);
+    outbuf_flush(&state->event_out, STDOUT_FILENO);
+}
+
+// Flush everything emitted since the previous done event in one go, so
+// consumers never observe a half-applied compositor update.
+void end_event_batch(struct wayws_state *state) {
+    state->batch_seq++;
+    if (state->shm)
+        shm_publish(state->shm, state);
+    if (state->serve)
+        serve_commit(state->serve);
+    if (state->event_enabled)
+        flush_events(state);
+    // One hook run and one signal per batch that printed something, not
+    // one per event
+    if (state->batch_events && state->opt_exec)
+        run_exec_hook(state, &state->exec.last);
+    if (state->batch_events)
+        for (size_t i = 0; i < state->nsignals; i++)
+            proc_target_signal(&state->signals[i]);
+    state->batch_events = 0;
+    if (state->writer)
+        drain_backlog(state);
+}
+
+// Hands the backlog to the writer once it has room, and decides whether
+// the next batch is held back too. Only ever between batches, so a
+// replaced event never carries part of a batch out early.
+void drain_backlog(struct wayws_state *state) {
+    if (state->batch_events)
+        return;
+    if (state->backlog.len && writer_want_room(state->writer)) {
+        backlog_take(&state->backlog, &state->event_out, monotonic_ns());
+        writer_push(state->writer, state->event_out.buf, state->event_out.len);
+        state->event_out.len = 0;
+    }
+    state->backlogging = state->backlog.len || writer_backed_up(state->writer);
+}
+
+// Starts the --exec hook for ev, directly or through the shell
+void run_exec_hook(struct wayws_state *state, const struct tpl_record *ev) {
+    struct exec_job job = {
+        .cmd = state->opt_exec,
+        .argv = state->exec_argv,
+        .ev = ev,
+    };
+    exec_request(&state->exec, &job);
+}
+
 // Helper function to get output name for a workspace
 const char *get_output_name_for_workspace(struct ws *w) {
     if (!w || !w->group || !w->group->outputs || !w->group->outputs->output)
@@ -68,25 +298,53 @@ const char *get_output_name_for_workspace(struct ws *w) {
     return w->group->outputs->output->name ? w->group->outputs->output->name : "(unknown)";
 }
 
-// Add a pending event to the queue
+// Take a node from the pool, growing it by a whole chunk when empty
+static struct pending_event *pending_alloc(struct pending_pool *pool) {
+    if (!pool->free) {
+        struct pending_chunk *chunk = malloc(sizeof(*chunk));
+        if (!chunk) return NULL;
+        chunk->next = pool->chunks;
+        pool->chunks = chunk;
+        for (size_t i = 0; i < PENDING_CHUNK_SIZE; i++) {
+            chunk->nodes[i].next = pool->free;
+            pool->free = &chunk->nodes[i];
+        }
+    }
+    struct pending_event *pending = pool->free;
+    pool->free = pending->next;
+    return pending;
+}
+
+// Return a whole queue to the pool
+static void pending_release(struct pending_pool *pool, struct pending_event *head,
+                            struct pending_event *tail) {
+    if (!head) return;
+    tail->next = pool->free;
+    pool->free = head;
+}
+
+// Append a pending event to the workspace's queue
 void add_pending_event(struct wayws_state *state, wayws_event_type_t type,
                       struct ws *workspace, int x, int y, int active, int urgent, int hidden,
                       enum dir direction) {
-    struct pending_event *pending = calloc(1, sizeof(*pending));
+    struct pending_event *pending = pending_alloc(&state->pending_pool);
     if (!pending) return;
     
     pending->type = type;
-    pending->workspace = workspace;
     pending->x = x;
     pending->y = y;
     pending->active = active;
     pending->urgent = urgent;
     pending->hidden = hidden;
     pending->direction = direction;
+    pending->next = NULL;
     
-    // Add to front of list
-    pending->next = state->pending_events;
-    state->pending_events = pending;
+    // Add to back of queue so events come out in arrival order
+    if (workspace->pending_tail)
+        workspace->pending_tail->next = pending;
+    else
+        workspace->pending_head = pending;
+    workspace->pending_tail = pending;
 }
 
 // Emit all pending events for a workspace when output becomes available
@@ -97,50 +355,36 @@ void emit_pending_events_for_workspace(struct wayws_state *state, struct ws *wor
     }
     
     const char *output_name = workspace->group->outputs->output->name;
-    struct pending_event **pp = &state->pending_events;
+    struct pending_event *head = workspace->pending_head;
+    struct pending_event *tail = workspace->pending_tail;
+    workspace->pending_head = workspace->pending_tail = NULL;
     
-    while (*pp) {
-        struct pending_event *pending = *pp;
-        if (pending->workspace == workspace) {
-            // Emit the pending event with correct output name
-            emit_event(state, pending->type, 
-                      pending->workspace->name ? pending->workspace->name : "",
-                      output_name, pending->workspace->index + 1,
-                      pending->x, pending->y, pending->active, pending->urgent, pending->hidden,
-                      pending->direction, NULL);
-            
-            // Remove from list
-            *pp = pending->next;
-            free(pending);
-        } else {
-            pp = &pending->next;
-        }
+    for (struct pending_event *pending = head; pending; pending = pending->next) {
+        // Emit the pending event with correct output name
+        emit_event(state, pending->type, 
+                  workspace->name ? workspace->name : "",
+                  output_name, workspace->index + 1,
+                  pending->x, pending->y, pending->active, pending->urgent, pending->hidden,
+                  pending->direction, workspace);
     }
+    pending_release(&state->pending_pool, head, tail);
 }
 
 // Clean up pending events for a workspace when it's destroyed
 void cleanup_pending_events_for_workspace(struct wayws_state *state, struct ws *workspace) {
-    struct pending_event **pp = &state->pending_events;
-    
-    while (*pp) {
-        struct pending_event *pending = *pp;
-        if (pending->workspace == workspace) {
-            // Remove from list
-            *pp = pending->next;
-            free(pending);
-        } else {
-            pp = &pending->next;
-        }
-    }
+    pending_release(&state->pending_pool, workspace->pending_head,
+                    workspace->pending_tail);
+    workspace->pending_head = workspace->pending_tail = NULL;
 }
 
 // Clean up all pending events (for program shutdown)
 void cleanup_all_pending_events(struct wayws_state *state) {
-    struct pending_event *pending = state->pending_events;
-    while (pending) {
-        struct pending_event *next = pending->next;
-        free(pending);
-        pending = next;
+    for (size_t i = 0; i < state->vlen; i++)
+        state->vec[i]->pending_head = state->vec[i]->pending_tail = NULL;
+    while (state->pending_pool.chunks) {
+        struct pending_chunk *next = state->pending_pool.chunks->next;
+        free(state->pending_pool.chunks);
+        state->pending_pool.chunks = next;
     }
-    state->pending_events = NULL;
-} 
\ No newline at end of file
+    state->pending_pool.free = NULL;
+}
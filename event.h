@@ -1,14 +1,28 @@
 #ifndef EVENT_H
 #define EVENT_H
 
+#include "outbuf.h"
 #include "types.h"
 
+// Queued event output is written early once it grows past this
+#define EVENT_OUT_FLUSH_AT 65536
+
+const char *event_type_name(wayws_event_type_t type);
+void serialize_event(struct outbuf *b, const wayws_event_t *ev);
+void flush_events(struct wayws_state *state);
+
 // Event emission function
 void emit_event(struct wayws_state *state, wayws_event_type_t type,
                 const char *workspace_name, const char *output_name,
                 int workspace_index, int x, int y, int active, int urgent, int hidden,
                 enum dir direction, void *additional_data);
 
+// Marks the end of an atomic compositor batch (manager/output done)
+void end_event_batch(struct wayws_state *state);
+// Watch mode: writes out the backlog if the writer has room (see backlog.h)
+void drain_backlog(struct wayws_state *state);
+void run_exec_hook(struct wayws_state *state, const struct tpl_record *ev);
+
 // Helper function to get output name for a workspace
 const char *get_output_name_for_workspace(struct ws *w);
 
@@ -0,0 +1,283 @@
+#define _GNU_SOURCE
+#include "exec.h"
+#include "template.h"
+#include "util.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char **environ;
+
+struct exec_spec {
+  const void *key;
+  struct exec_spec *next; // queue link
+  int direct;  // posix_spawnp(argv[0]) instead of /bin/sh
+  char **argv; // owned
+  char **envp; // envp[0..nown) owned, the rest borrowed from environ
+  size_t nown;
+};
+
+static int sigchld_fd = -1;
+
+static void on_sigchld(int sig) {
+  (void)sig;
+  int saved = errno;
+  if (sigchld_fd >= 0 && write(sigchld_fd, "", 1) < 0) {
+    // Pipe full: a wakeup is already pending
+  }
+  errno = saved;
+}
+
+// The SIGCHLD plumbing is only set up once a hook actually runs, so plain
+// one-shot commands pay nothing for it.
+static int ensure_wake(struct exec_runner *r) {
+  if (r->armed)
+    return 0;
+  if (pipe2(r->wake, O_CLOEXEC | O_NONBLOCK) < 0)
+    return -1;
+  r->armed = 1;
+  sigchld_fd = r->wake[1];
+  struct sigaction sa = {0};
+  sa.sa_handler = on_sigchld;
+  sa.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+  sigemptyset(&sa.sa_mask);
+  sigaction(SIGCHLD, &sa, NULL);
+  return 0;
+}
+
+char **exec_split(const char *cmd) {
+  static const char blanks[] = " \t\n";
+  char **argv = NULL;
+  size_t n = 0;
+  for (const char *p = cmd + strspn(cmd, blanks); *p;
+       p += strspn(p, blanks)) {
+    size_t len = strcspn(p, blanks);
+    argv = xrealloc(argv, (n + 2) * sizeof *argv);
+    argv[n] = xrealloc(NULL, len + 1);
+    memcpy(argv[n], p, len);
+    argv[n][len] = '\0';
+    argv[++n] = NULL;
+    p += len;
+  }
+  return argv;
+}
+
+void exec_free_argv(char **argv) {
+  if (!argv)
+    return;
+  for (char **a = argv; *a; a++)
+    free(*a);
+  free(argv);
+}
+
+static char *env_str(const char *key, const char *val) {
+  size_t kl = strlen(key), vl = strlen(val ? val : "");
+  char *s = xrealloc(NULL, kl + vl + 2);
+  memcpy(s, key, kl);
+  s[kl] = '=';
+  memcpy(s + kl + 1, val ? val : "", vl + 1);
+  return s;
+}
+
+static char *env_num(const char *key, long v) {
+  char buf[24];
+  snprintf(buf, sizeof buf, "%ld", v);
+  return env_str(key, buf);
+}
+
+static struct exec_spec *prepare(const struct exec_job *job) {
+  struct exec_spec *s = xrealloc(NULL, sizeof *s);
+  s->key = job->key ? job->key
+           : job->argv ? (const void *)job->argv
+                       : (const void *)job->cmd;
+  s->next = NULL;
+  s->direct = job->argv != NULL;
+  if (s->direct) {
+    size_t n = 0;
+    while (job->argv[n])
+      n++;
+    s->argv = xrealloc(NULL, (n + 1) * sizeof *s->argv);
+    for (size_t i = 0; i < n; i++)
+      s->argv[i] = xstrdup(job->argv[i]);
+    s->argv[n] = NULL;
+  } else {
+    s->argv = xrealloc(NULL, 4 * sizeof *s->argv);
+    s->argv[0] = xstrdup("sh");
+    s->argv[1] = xstrdup("-c");
+    s->argv[2] = xstrdup(job->cmd);
+    s->argv[3] = NULL;
+  }
+
+  // Our own variables replace any inherited from an outer wayws
+  size_t nenv = 0;
+  for (char **e = environ; *e; e++)
+    nenv++;
+  char *own[10];
+  size_t nown = 0;
+  const struct tpl_record *ev = job->ev;
+  if (ev) {
+    own[nown++] = env_str("WAYWS_EVENT", ev->type);
+    own[nown++] = env_str("WAYWS_NAME", ev->name);
+    own[nown++] = env_str("WAYWS_ID", ev->id);
+    own[nown++] = env_str("WAYWS_OUTPUT", ev->output);
+    own[nown++] = env_num("WAYWS_INDEX", ev->index);
+    own[nown++] = env_num("WAYWS_X", ev->x);
+    own[nown++] = env_num("WAYWS_Y", ev->y);
+    own[nown++] = env_num("WAYWS_ACTIVE", !!ev->active);
+    own[nown++] = env_num("WAYWS_URGENT", !!ev->urgent);
+    own[nown++] = env_num("WAYWS_HIDDEN", !!ev->hidden);
+  }
+  s->envp = xrealloc(NULL, (nown + nenv + 1) * sizeof *s->envp);
+  memcpy(s->envp, own, nown * sizeof *own);
+  s->nown = nown;
+  size_t k = nown;
+  for (char **e = environ; *e; e++)
+    if (!ev || strncmp(*e, "WAYWS_", 6) != 0)
+      s->envp[k++] = *e;
+  s->envp[k] = NULL;
+  return s;
+}
+
+static void spec_free(struct exec_spec *s) {
+  if (!s)
+    return;
+  exec_free_argv(s->argv);
+  for (size_t i = 0; i < s->nown; i++)
+    free(s->envp[i]);
+  free(s->envp);
+  free(s);
+}
+
+static int spawn(struct exec_runner *r, const struct exec_spec *s) {
+  posix_spawnattr_t attr;
+  posix_spawnattr_init(&attr);
+  // The hook gets default signal handling, whatever we ignore or catch
+  sigset_t def, none;
+  sigemptyset(&def);
+  sigaddset(&def, SIGPIPE);
+  sigaddset(&def, SIGCHLD);
+  sigaddset(&def, SIGINT);
+  sigaddset(&def, SIGTERM);
+  sigemptyset(&none);
+  posix_spawnattr_setsigdefault(&attr, &def);
+  posix_spawnattr_setsigmask(&attr, &none);
+  posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETSIGMASK);
+
+  // Anything printed before the hook must reach the terminal first
+  fflush(stdout);
+  pid_t pid;
+  int err = s->direct
+                ? posix_spawnp(&pid, s->argv[0], NULL, &attr, s->argv, s->envp)
+                : posix_spawn(&pid, "/bin/sh", NULL, &attr, s->argv, s->envp);
+  posix_spawnattr_destroy(&attr);
+  if (err != 0) {
+    // argv[2] is the shell's command string
+    fprintf(stderr, "wayws: failed to run --exec hook %s: %s\n",
+            s->direct ? s->argv[0] : s->argv[2], strerror(err));
+    return -1;
+  }
+  r->pids[r->running++] = pid;
+  return 0;
+}
+
+static int slots(const struct exec_runner *r) {
+  int limit = r->limit > 0 ? r->limit : 1;
+  return limit < EXEC_MAX_JOBS ? limit : EXEC_MAX_JOBS;
+}
+
+int exec_request(struct exec_runner *r, const struct exec_job *job) {
+  if (ensure_wake(r) < 0)
+    return -1;
+  struct exec_spec *s = prepare(job);
+  if (r->running < slots(r)) {
+    int ret = spawn(r, s);
+    spec_free(s);
+    return ret;
+  }
+  // Busy: only the latest request per hook matters, run it once a slot
+  // frees up
+  struct exec_spec **pp = &r->queued;
+  while (*pp && (*pp)->key != s->key)
+    pp = &(*pp)->next;
+  if (*pp) {
+    s->next = (*pp)->next;
+    spec_free(*pp);
+  }
+  *pp = s;
+  return 0;
+}
+
+static void forget_last(struct exec_runner *r) {
+  free(r->last_buf);
+  r->last_buf = NULL;
+  r->last_cap = 0;
+  memset(&r->last, 0, sizeof r->last);
+}
+
+// Called for every printed event, so the strings are packed into one
+// buffer that only grows, instead of four allocations per note
+void exec_note(struct exec_runner *r, const struct tpl_record *ev) {
+  const char *src[4] = {ev->name, ev->id, ev->output, ev->type};
+  size_t len[4], total = 0;
+  for (int i = 0; i < 4; i++) {
+    len[i] = src[i] ? strlen(src[i]) + 1 : 0;
+    total += len[i];
+  }
+  if (total > r->last_cap) {
+    r->last_cap = total < 128 ? 128 : total * 2;
+    r->last_buf = xrealloc(r->last_buf, r->last_cap);
+  }
+  r->last = *ev;
+  const char **dst[4] = {&r->last.name, &r->last.id, &r->last.output,
+                         &r->last.type};
+  size_t off = 0;
+  for (int i = 0; i < 4; i++) {
+    *dst[i] = src[i] ? memcpy(r->last_buf + off, src[i], len[i]) : NULL;
+    off += len[i];
+  }
+}
+
+int exec_fd(const struct exec_runner *r) { return r->armed ? r->wake[0] : -1; }
+
+void exec_reap(struct exec_runner *r) {
+  char drain[64];
+  if (r->armed)
+    while (read(r->wake[0], drain, sizeof drain) > 0)
+      ;
+  for (int i = 0; i < r->running;) {
+    pid_t pid = waitpid(r->pids[i], NULL, WNOHANG);
+    if (pid == r->pids[i] || (pid < 0 && errno == ECHILD))
+      r->pids[i] = r->pids[--r->running];
+    else
+      i++;
+  }
+  while (r->queued && r->running < slots(r)) {
+    struct exec_spec *s = r->queued;
+    r->queued = s->next;
+    spawn(r, s);
+    spec_free(s);
+  }
+}
+
+// Hooks still running are left to finish on their own
+void exec_destroy(struct exec_runner *r) {
+  while (r->queued) {
+    struct exec_spec *next = r->queued->next;
+    spec_free(r->queued);
+    r->queued = next;
+  }
+  forget_last(r);
+  if (r->armed) {
+    signal(SIGCHLD, SIG_DFL);
+    sigchld_fd = -1;
+    close(r->wake[0]);
+    close(r->wake[1]);
+    r->armed = 0;
+  }
+}
@@ -0,0 +1,59 @@
+#ifndef EXEC_H
+#define EXEC_H
+
+#include "template.h"
+#include <sys/types.h>
+
+// Runs --exec hooks in the background. Hooks are spawned without waiting for
+// them; a zeroed runner is ready to use. Finished children are reaped from
+// the main loop when SIGCHLD makes exec_fd() readable, or when the watch
+// loop, which blocks SIGCHLD, reads it from its signalfd. At most `limit`
+// hooks run at once, and while all slots are busy further requests for the
+// same hook collapse into a single follow-up run.
+#define EXEC_MAX_JOBS 16
+
+struct exec_spec; // a fully prepared argv + environment
+
+struct exec_runner {
+  int limit;   // concurrent hooks, 1..EXEC_MAX_JOBS (0 reads as 1)
+  int armed;   // wake[] and the SIGCHLD handler are set up
+  int wake[2]; // SIGCHLD self-pipe
+  pid_t pids[EXEC_MAX_JOBS];
+  int running;
+  struct exec_spec *queued; // coalesced follow-ups, one per key, FIFO
+  struct tpl_record last;   // exec_note()'s copy; strings point into last_buf
+  char *last_buf;           // grown as needed, reused from one note to the next
+  size_t last_cap;
+};
+
+// One hook run. With argv set the program is started directly (argv[0] is
+// looked up in PATH, no shell); otherwise cmd goes through /bin/sh -c. The
+// fields of ev, if any, are exported as WAYWS_EVENT, WAYWS_NAME, ...
+// Requests with the same key are the same hook for coalescing; NULL keys
+// by cmd (or argv).
+struct exec_job {
+  const char *cmd;
+  char *const *argv;
+  const struct tpl_record *ev;
+  const void *key;
+};
+
+// Starts the job now if a slot is free, otherwise queues it as the hook's
+// follow-up (replacing one already queued for the same key). Returns 0, or
+// -1 if the spawn itself failed.
+int exec_request(struct exec_runner *r, const struct exec_job *job);
+// Remembers ev (copying its strings) as r->last, for a later request. The
+// previous note's strings are overwritten.
+void exec_note(struct exec_runner *r, const struct tpl_record *ev);
+// fd to poll for POLLIN, or -1 when no hook was ever started
+int exec_fd(const struct exec_runner *r);
+// Reaps finished hooks and starts the queued follow-up if a slot freed up
+void exec_reap(struct exec_runner *r);
+void exec_destroy(struct exec_runner *r);
+
+// Splits cmd on blanks into a NULL-terminated argv (no quoting). Returns
+// NULL if cmd has no words.
+char **exec_split(const char *cmd);
+void exec_free_argv(char **argv);
+
+#endif // EXEC_H
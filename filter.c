@@ -0,0 +1,89 @@
+#include "filter.h"
+#include "event.h"
+#include "types.h"
+#include <string.h>
+
+// Short names accepted by --events; the full type names work as well
+static const struct {
+  const char *name;
+  wayws_event_type_t type;
+} short_names[] = {
+    {"created", EVENT_WORKSPACE_CREATED},
+    {"destroyed", EVENT_WORKSPACE_DESTROYED},
+    {"id", EVENT_WORKSPACE_ID},
+    {"name", EVENT_WORKSPACE_NAME},
+    {"coordinates", EVENT_WORKSPACE_COORDINATES},
+    {"capabilities", EVENT_WORKSPACE_CAPABILITIES},
+    {"state", EVENT_WORKSPACE_STATE},
+    {"enter", EVENT_WORKSPACE_ENTER},
+    {"leave", EVENT_WORKSPACE_LEAVE},
+};
+
+static int lookup_type(const char *s, size_t n, wayws_event_type_t *out) {
+  for (size_t i = 0; i < sizeof short_names / sizeof short_names[0]; i++) {
+    if (strlen(short_names[i].name) == n &&
+        strncmp(short_names[i].name, s, n) == 0) {
+      *out = short_names[i].type;
+      return 0;
+    }
+  }
+  for (int t = 0; t < EVENT_TYPE_COUNT; t++) {
+    const char *full = event_type_name((wayws_event_type_t)t);
+    if (strlen(full) == n && strncmp(full, s, n) == 0) {
+      *out = (wayws_event_type_t)t;
+      return 0;
+    }
+  }
+  return -1;
+}
+
+int filter_parse_events(struct event_filter *f, const char *list) {
+  uint32_t types = 0;
+  for (const char *p = list;;) {
+    size_t n = strcspn(p, ",");
+    wayws_event_type_t t;
+    if (n == 0 || lookup_type(p, n, &t) != 0)
+      return -1;
+    types |= 1u << t;
+    if (!p[n])
+      break;
+    p += n + 1;
+  }
+  // Repeated --events options add up
+  f->types |= types;
+  return 0;
+}
+
+static int match_state(struct event_filter *f, unsigned bit, const char *v) {
+  if (strcmp(v, "true") == 0 || strcmp(v, "1") == 0)
+    f->state_want |= bit;
+  else if (strcmp(v, "false") == 0 || strcmp(v, "0") == 0)
+    f->state_want &= ~bit;
+  else
+    return -1;
+  f->state_mask |= bit;
+  return 0;
+}
+
+int filter_parse_match(struct event_filter *f, const char *pred) {
+  const char *eq = strchr(pred, '=');
+  if (!eq)
+    return -1;
+  size_t klen = (size_t)(eq - pred);
+  const char *v = eq + 1;
+  if (klen == 6 && strncmp(pred, "active", 6) == 0)
+    return match_state(f, FILTER_ACTIVE, v);
+  if (klen == 6 && strncmp(pred, "urgent", 6) == 0)
+    return match_state(f, FILTER_URGENT, v);
+  if (klen == 6 && strncmp(pred, "hidden", 6) == 0)
+    return match_state(f, FILTER_HIDDEN, v);
+  if (klen == 6 && strncmp(pred, "output", 6) == 0) {
+    f->output = v;
+    return 0;
+  }
+  if (klen == 4 && strncmp(pred, "name", 4) == 0) {
+    f->name = v;
+    return 0;
+  }
+  return -1;
+}
@@ -0,0 +1,32 @@
+#ifndef FILTER_H
+#define FILTER_H
+
+#include "types.h"
+#include <string.h>
+
+// Parse --events=LIST (comma separated event names) and --match KEY=VALUE
+// into f. Both return 0, or -1 if the argument is not understood.
+int filter_parse_events(struct event_filter *f, const char *list);
+int filter_parse_match(struct event_filter *f, const char *pred);
+
+// Whether watch mode should print this event. Called for every event before
+// anything is formatted, so it only compares integers and, for output= and
+// name=, one short string.
+static inline int filter_accepts(const struct event_filter *f,
+                                 wayws_event_type_t type, const char *name,
+                                 const char *output, int active, int urgent,
+                                 int hidden) {
+  if (f->types && !(f->types & (1u << type)))
+    return 0;
+  unsigned bits = (active ? FILTER_ACTIVE : 0) | (urgent ? FILTER_URGENT : 0) |
+                  (hidden ? FILTER_HIDDEN : 0);
+  if ((bits & f->state_mask) != f->state_want)
+    return 0;
+  if (f->output && strcmp(f->output, output ? output : "") != 0)
+    return 0;
+  if (f->name && strcmp(f->name, name ? name : "") != 0)
+    return 0;
+  return 1;
+}
+
+#endif // FILTER_H
@@ -0,0 +1,131 @@
+#include "hash.h"
+#include "util.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const char tombstone_key;
+#define TOMBSTONE (&tombstone_key)
+
+// FNV-1a
+uint32_t strmap_hash(const char *key) {
+  uint32_t h = 2166136261u;
+  for (const unsigned char *p = (const unsigned char *)key; *p; p++) {
+    h ^= *p;
+    h *= 16777619u;
+  }
+  return h;
+}
+
+static struct strmap_slot *find_slot(const struct strmap *m, const char *key,
+                                     uint32_t hash) {
+  size_t mask = m->cap - 1;
+  for (size_t i = hash & mask;; i = (i + 1) & mask) {
+    struct strmap_slot *s = &m->slots[i];
+    if (!s->key)
+      return NULL;
+    if (s->key != TOMBSTONE && s->hash == hash && strcmp(s->key, key) == 0)
+      return s;
+  }
+}
+
+void *strmap_get(const struct strmap *m, const char *key) {
+  if (!m->len || !key)
+    return NULL;
+  struct strmap_slot *s = find_slot(m, key, strmap_hash(key));
+  return s ? s->value : NULL;
+}
+
+static void insert_fresh(struct strmap *m, const char *key, void *value,
+                         uint32_t hash) {
+  size_t mask = m->cap - 1;
+  size_t i = hash & mask;
+  while (m->slots[i].key && m->slots[i].key != TOMBSTONE)
+    i = (i + 1) & mask;
+  if (!m->slots[i].key)
+    m->used++;
+  m->slots[i] = (struct strmap_slot){key, value, hash};
+  m->len++;
+}
+
+static void rehash(struct strmap *m, size_t cap) {
+  struct strmap_slot *old = m->slots;
+  size_t old_cap = m->cap;
+  m->slots = xrealloc(NULL, cap * sizeof *m->slots);
+  memset(m->slots, 0, cap * sizeof *m->slots);
+  m->cap = cap;
+  m->len = 0;
+  m->used = 0;
+  for (size_t i = 0; i < old_cap; i++)
+    if (old[i].key && old[i].key != TOMBSTONE)
+      insert_fresh(m, old[i].key, old[i].value, old[i].hash);
+  free(old);
+}
+
+void strmap_put(struct strmap *m, const char *key, void *value) {
+  uint32_t hash = strmap_hash(key);
+  if (m->len) {
+    struct strmap_slot *s = find_slot(m, key, hash);
+    if (s) {
+      s->key = key;
+      s->value = value;
+      return;
+    }
+  }
+  // Keep the load (tombstones included) under 3/4. Grow when mostly live,
+  // otherwise just purge the tombstones.
+  if ((m->used + 1) * 4 > m->cap * 3) {
+    size_t cap = m->cap ? m->cap : 16;
+    if ((m->len + 1) * 2 > cap)
+      cap *= 2;
+    rehash(m, cap);
+  }
+  insert_fresh(m, key, value, hash);
+}
+
+void *strmap_remove(struct strmap *m, const char *key) {
+  if (!m->len || !key)
+    return NULL;
+  struct strmap_slot *s = find_slot(m, key, strmap_hash(key));
+  if (!s)
+    return NULL;
+  void *value = s->value;
+  s->key = TOMBSTONE;
+  s->value = NULL;
+  m->len--;
+  return value;
+}
+
+void strmap_free(struct strmap *m) {
+  free(m->slots);
+  *m = (struct strmap){0};
+}
+
+uint32_t strintern_id(struct strintern *t, const char *s) {
+  uint32_t id = strintern_find(t, s);
+  if (id || !s)
+    return id;
+  if (t->len == t->cap) {
+    t->cap = t->cap ? t->cap * 2 : 8;
+    t->strs = xrealloc(t->strs, t->cap * sizeof *t->strs);
+  }
+  char *copy = xstrdup(s);
+  t->strs[t->len++] = copy;
+  strmap_put(&t->map, copy, (void *)(uintptr_t)t->len);
+  return t->len;
+}
+
+uint32_t strintern_find(const struct strintern *t, const char *s) {
+  return (uint32_t)(uintptr_t)strmap_get(&t->map, s);
+}
+
+const char *strintern_str(const struct strintern *t, uint32_t id) {
+  return id && id <= t->len ? t->strs[id - 1] : NULL;
+}
+
+void strintern_free(struct strintern *t) {
+  for (uint32_t i = 0; i < t->len; i++)
+    free(t->strs[i]);
+  free(t->strs);
+  strmap_free(&t->map);
+  *t = (struct strintern){0};
+}
@@ -0,0 +1,41 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Open-addressing string -> pointer map. Keys are borrowed: the caller owns
+// the strings and must remove an entry before freeing its key.
+struct strmap_slot {
+  const char *key;
+  void *value;
+  uint32_t hash;
+};
+
+struct strmap {
+  struct strmap_slot *slots;
+  size_t cap;  // power of two, 0 when empty
+  size_t len;  // live entries
+  size_t used; // live entries + tombstones
+};
+
+uint32_t strmap_hash(const char *key);
+void *strmap_get(const struct strmap *m, const char *key);
+void strmap_put(struct strmap *m, const char *key, void *value);
+void *strmap_remove(struct strmap *m, const char *key);
+void strmap_free(struct strmap *m);
+
+// Interns strings to small integer ids (1, 2, ...; 0 means "none"), so hot
+// paths can compare names as integers. The table owns its copies.
+struct strintern {
+  struct strmap map;
+  char **strs; // strs[id - 1]
+  uint32_t len, cap;
+};
+
+uint32_t strintern_id(struct strintern *t, const char *s);
+uint32_t strintern_find(const struct strintern *t, const char *s);
+const char *strintern_str(const struct strintern *t, uint32_t id);
+void strintern_free(struct strintern *t);
+
+#endif // HASH_H
@@ -0,0 +1,88 @@
+#define _GNU_SOURCE
+
+#include "loop.h"
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/signalfd.h>
+#include <unistd.h>
+
+int loop_init(struct loop *l) {
+  memset(l, 0, sizeof *l);
+  l->epfd = epoll_create1(EPOLL_CLOEXEC);
+  return l->epfd < 0 ? -1 : 0;
+}
+
+static int ctl(struct loop *l, int op, struct loop_source *src,
+               uint32_t events) {
+  struct epoll_event ev = {.events = events, .data.ptr = src};
+  return epoll_ctl(l->epfd, op, src->fd, &ev);
+}
+
+int loop_add(struct loop *l, struct loop_source *src, uint32_t events) {
+  src->kind = LOOP_FD;
+  return ctl(l, EPOLL_CTL_ADD, src, events);
+}
+
+void loop_remove(struct loop *l, struct loop_source *src) {
+  if (src->fd < 0)
+    return;
+  epoll_ctl(l->epfd, EPOLL_CTL_DEL, src->fd, NULL);
+  if (src->kind != LOOP_FD) {
+    close(src->fd);
+    src->fd = -1;
+  }
+}
+
+int loop_add_signals(struct loop *l, struct loop_source *src,
+                     const sigset_t *set) {
+  if (l->sig) {
+    errno = EBUSY;
+    return -1;
+  }
+  // Blocked first: a signal sent in between stays pending for the signalfd
+  // instead of running its handler
+  pthread_sigmask(SIG_BLOCK, set, &l->old_mask);
+  src->fd = signalfd(-1, set, SFD_CLOEXEC | SFD_NONBLOCK);
+  if (src->fd < 0 || ctl(l, EPOLL_CTL_ADD, src, EPOLLIN) != 0) {
+    int saved = errno;
+    if (src->fd >= 0)
+      close(src->fd);
+    src->fd = -1;
+    pthread_sigmask(SIG_SETMASK, &l->old_mask, NULL);
+    errno = saved;
+    return -1;
+  }
+  src->kind = LOOP_SIGNALS;
+  l->sig = src;
+  return 0;
+}
+
+int loop_signal(struct loop_source *src) {
+  struct signalfd_siginfo si;
+  ssize_t n = read(src->fd, &si, sizeof si);
+  return n == (ssize_t)sizeof si ? (int)si.ssi_signo : 0;
+}
+
+int loop_dispatch(struct loop *l, int timeout_ms) {
+  struct epoll_event evs[LOOP_MAX_EVENTS];
+  int n = epoll_wait(l->epfd, evs, LOOP_MAX_EVENTS, timeout_ms);
+  if (n < 0)
+    return errno == EINTR ? 0 : -1;
+  for (int i = 0; i < n; i++) {
+    struct loop_source *src = evs[i].data.ptr;
+    src->fn(src, evs[i].events);
+  }
+  return n;
+}
+
+void loop_destroy(struct loop *l) {
+  if (l->sig) {
+    loop_remove(l, l->sig);
+    pthread_sigmask(SIG_SETMASK, &l->old_mask, NULL);
+    l->sig = NULL;
+  }
+  if (l->epfd >= 0)
+    close(l->epfd);
+  l->epfd = -1;
+}
@@ -0,0 +1,56 @@
+#ifndef LOOP_H
+#define LOOP_H
+
+#include <signal.h>
+#include <stdint.h>
+#include <sys/epoll.h>
+
+// Event loop of the long-running watchers. One epoll set holds every fd
+// they wait on and signals arrive through a signalfd, so an idle watcher
+// sleeps in epoll_wait() until something happens rather than waking up to
+// look at a flag. A source is an fd and the function to run when it is
+// ready. The caller owns the struct, which must stay put while it is
+// registered.
+#define LOOP_MAX_EVENTS 16
+
+struct loop_source;
+typedef void (*loop_fn)(struct loop_source *src, uint32_t events);
+
+enum loop_kind { LOOP_FD, LOOP_SIGNALS };
+
+struct loop_source {
+  int fd;
+  loop_fn fn;
+  void *data;
+  enum loop_kind kind; // set by the loop_add* call
+};
+
+struct loop {
+  int epfd;
+  struct loop_source *sig; // at most one signal source
+  sigset_t old_mask;       // put back by loop_destroy()
+};
+
+// Returns 0, or -1 with errno set
+int loop_init(struct loop *l);
+// Watches src->fd, which stays the caller's, for events (EPOLLIN, ...)
+int loop_add(struct loop *l, struct loop_source *src, uint32_t events);
+// Stops watching src; fds the loop created itself are closed. Not from a
+// callback, unless src is that callback's own source: another one may
+// still be waiting its turn in the same round.
+void loop_remove(struct loop *l, struct loop_source *src);
+// Blocks the signals in set and hands them to src->fn through a signalfd
+// instead, which takes them one at a time from loop_signal()
+int loop_add_signals(struct loop *l, struct loop_source *src,
+                     const sigset_t *set);
+// The next pending signal of a signal source, 0 once there are none
+int loop_signal(struct loop_source *src);
+// Waits up to timeout_ms (-1: for as long as it takes) and runs every ready
+// source. Returns how many ran, or -1 if the wait failed; an interrupted
+// wait counts as none ready.
+int loop_dispatch(struct loop *l, int timeout_ms);
+// Removes the signal source, closes the epoll set and restores the signal
+// mask. Other sources must have been removed already.
+void loop_destroy(struct loop *l);
+
+#endif // LOOP_H
@@ -0,0 +1,164 @@
+#include "outbuf.h"
+#include "util.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static char *reserve(struct outbuf *b, size_t n) {
+  if (b->cap - b->len < n) {
+    size_t cap = b->cap ? b->cap : 4096;
+    while (cap - b->len < n)
+      cap *= 2;
+    b->buf = xrealloc(b->buf, cap);
+    b->cap = cap;
+  }
+  return b->buf + b->len;
+}
+
+void outbuf_put(struct outbuf *b, const char *s, size_t n) {
+  memcpy(reserve(b, n), s, n);
+  b->len += n;
+}
+
+void outbuf_puts(struct outbuf *b, const char *s) {
+  outbuf_put(b, s, strlen(s));
+}
+
+void outbuf_putc(struct outbuf *b, char c) {
+  *reserve(b, 1) = c;
+  b->len++;
+}
+
+void outbuf_put_uint(struct outbuf *b, unsigned long long v) {
+  char tmp[20];
+  char *p = tmp + sizeof tmp;
+  do {
+    *--p = (char)('0' + v % 10);
+    v /= 10;
+  } while (v);
+  outbuf_put(b, p, (size_t)(tmp + sizeof tmp - p));
+}
+
+void outbuf_put_int(struct outbuf *b, long long v) {
+  if (v < 0) {
+    outbuf_putc(b, '-');
+    outbuf_put_uint(b, 0ULL - (unsigned long long)v);
+  } else {
+    outbuf_put_uint(b, (unsigned long long)v);
+  }
+}
+
+void outbuf_put_hex(struct outbuf *b, uintptr_t v) {
+  static const char digits[] = "0123456789abcdef";
+  char tmp[2 * sizeof v];
+  char *p = tmp + sizeof tmp;
+  do {
+    *--p = digits[v & 0xf];
+    v >>= 4;
+  } while (v);
+  outbuf_lit(b, "0x");
+  outbuf_put(b, p, (size_t)(tmp + sizeof tmp - p));
+}
+
+void outbuf_put_bool(struct outbuf *b, int v) {
+  if (v)
+    outbuf_lit(b, "true");
+  else
+    outbuf_lit(b, "false");
+}
+
+// SWAR helpers: each returns a word with the high bit set in every byte lane
+// that matches (exact for "any lane matches", which is all we ask).
+#define ONES ((uint64_t)0x0101010101010101ULL)
+#define HIGHS ((uint64_t)0x8080808080808080ULL)
+
+static uint64_t lanes_zero(uint64_t v) { return (v - ONES) & ~v & HIGHS; }
+
+// Lanes below 0x20, '"' or '\\'. Bytes >= 0x80 (UTF-8) never match.
+static uint64_t lanes_to_escape(uint64_t v) {
+  return ((v - ONES * 0x20) & ~v & HIGHS) | lanes_zero(v ^ (ONES * '"')) |
+         lanes_zero(v ^ (ONES * '\\'));
+}
+
+static void put_escaped(struct outbuf *b, unsigned char c) {
+  static const char hex[] = "0123456789abcdef";
+  switch (c) {
+  case '"':
+    outbuf_lit(b, "\\\"");
+    break;
+  case '\\':
+    outbuf_lit(b, "\\\\");
+    break;
+  case '\n':
+    outbuf_lit(b, "\\n");
+    break;
+  case '\r':
+    outbuf_lit(b, "\\r");
+    break;
+  case '\t':
+    outbuf_lit(b, "\\t");
+    break;
+  case '\b':
+    outbuf_lit(b, "\\b");
+    break;
+  case '\f':
+    outbuf_lit(b, "\\f");
+    break;
+  default: {
+    char u[6] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xf]};
+    outbuf_put(b, u, sizeof u);
+  }
+  }
+}
+
+void outbuf_put_json_string(struct outbuf *b, const char *s) {
+  outbuf_putc(b, '"');
+  if (s) {
+    size_t n = strlen(s);
+    size_t i = 0, run = 0; // s[run..i) is clean and not yet copied
+    while (i < n) {
+      // Skip eight clean bytes at a time; drop to bytes around a match
+      if (n - i >= 8) {
+        uint64_t v;
+        memcpy(&v, s + i, sizeof v);
+        if (!lanes_to_escape(v)) {
+          i += 8;
+          continue;
+        }
+      }
+      unsigned char c = (unsigned char)s[i];
+      if (c < 0x20 || c == '"' || c == '\\') {
+        outbuf_put(b, s + run, i - run);
+        put_escaped(b, c);
+        run = i + 1;
+      }
+      i++;
+    }
+    outbuf_put(b, s + run, n - run);
+  }
+  outbuf_putc(b, '"');
+}
+
+int outbuf_flush(struct outbuf *b, int fd) {
+  int ret = 0;
+  size_t off = 0;
+  while (off < b->len) {
+    ssize_t w = write(fd, b->buf + off, b->len - off);
+    if (w < 0) {
+      if (errno == EINTR)
+        continue;
+      ret = -1;
+      break;
+    }
+    off += (size_t)w;
+  }
+  b->len = 0;
+  return ret;
+}
+
+void outbuf_free(struct outbuf *b) {
+  free(b->buf);
+  b->buf = NULL;
+  b->len = b->cap = 0;
+}
@@ -0,0 +1,32 @@
+#ifndef OUTBUF_H
+#define OUTBUF_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Growable byte buffer for building output without stdio. Callers append
+// pieces and hand the whole thing to write() in one go with outbuf_flush.
+struct outbuf {
+  char *buf;
+  size_t len, cap;
+};
+
+// Appends a string literal without a strlen
+#define outbuf_lit(b, s) outbuf_put((b), (s), sizeof(s) - 1)
+
+void outbuf_put(struct outbuf *b, const char *s, size_t n);
+void outbuf_puts(struct outbuf *b, const char *s);
+void outbuf_putc(struct outbuf *b, char c);
+void outbuf_put_int(struct outbuf *b, long long v);
+void outbuf_put_uint(struct outbuf *b, unsigned long long v);
+void outbuf_put_hex(struct outbuf *b, uintptr_t v);
+void outbuf_put_bool(struct outbuf *b, int v);
+// Appends s (NULL reads as "") as a quoted, escaped JSON string
+void outbuf_put_json_string(struct outbuf *b, const char *s);
+
+// Writes everything to fd (retrying short writes) and empties the buffer.
+// Returns 0, or -1 if the write failed; the data is dropped either way.
+int outbuf_flush(struct outbuf *b, int fd);
+void outbuf_free(struct outbuf *b);
+
+#endif // OUTBUF_H
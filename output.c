@@ -1,11 +1,27 @@
 #include "output.h"
+#include "outbuf.h"
+#include "template.h"
 #include "types.h"
 #include "util.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
-void print_waybar_output(struct wayws_state *state) {
+// The group shown for an output. With several on it, the one first on the
+// state's group list, as walking that list for the output used to pick.
+static struct workspace_group *waybar_group(const struct wayws_state *state,
+                                            const struct output *o) {
+  if (o->ngroups <= 1)
+    return o->ngroups ? o->groups[0] : NULL;
+  for (struct workspace_group *g = state->workspace_groups; g; g = g->next)
+    for (size_t i = 0; i < o->ngroups; i++)
+      if (o->groups[i] == g)
+        return g;
+  return NULL;
+}
+
+int print_waybar_output(struct wayws_state *state) {
   // Check if we have multiple outputs and no specific output is specified
   if (!state->opt_output_name) {
     int output_count = 0;
@@ -13,54 +29,36 @@ void print_waybar_output(struct wayws_state *state) {
       output_count++;
     }
     if (output_count > 1) {
-      die("Error: Multiple outputs detected. Use --output to specify which output to use with --waybar.\n");
+      fputs("Error: Multiple outputs detected. Use --output to specify which output to use with --waybar.\n",
+            stderr);
+      return -1;
     }
   }
 
+  uint32_t want = state->opt_output_name
+                     ? strintern_find(&state->output_names, state->opt_output_name)
+                     : 0;
+  // 0 is also the id of every output that has not sent its name
+  if (state->opt_output_name && !want) {
+    fprintf(stderr, "Error: No output named %s.\n", state->opt_output_name);
+    return -1;
+  }
   printf("{\"text\":\"");
   int first_monitor_printed = 1;
   for (struct output *o = state->all_outputs; o; o = o->next) {
-    if (state->opt_output_name && strcmp(o->name, state->opt_output_name) != 0)
+    if (state->opt_output_name && o->name_id != want)
       continue;
-    struct workspace_group *current_group = NULL;
-    for (struct workspace_group *g = state->workspace_groups; g && !current_group;
-         g = g->next)
-      for (struct group_output *go = g->outputs; go; go = go->next)
-        if (go->output == o) {
-          current_group = g;
-          break;
-        }
+    struct workspace_group *current_group = waybar_group(state, o);
     if (!current_group)
       continue;
     if (!first_monitor_printed)
       printf("\\n");
     first_monitor_printed = 0;
     
-    // Count workspaces for this monitor first
-    size_t monitor_ws_count = 0;
-    for (size_t i = 0; i < state->vlen; i++) {
-      if (state->vec[i]->group == current_group)
-        monitor_ws_count++;
-    }
-    
-    // Allocate array on heap to avoid stack overflow
+    // The group keeps its members in index order
+    struct ws **monitor_workspaces = current_group->members;
+    size_t monitor_ws_count = current_group->nmembers;
     if (monitor_ws_count == 0) continue;
-    struct ws **monitor_workspaces = malloc(monitor_ws_count * sizeof(struct ws *));
-    if (!monitor_workspaces) continue;
-    
-    // Fill the array
-    size_t idx = 0;
-    for (size_t i = 0; i < state->vlen; i++) {
-      if (state->vec[i]->group == current_group)
-        monitor_workspaces[idx++] = state->vec[i];
-    }
-    for (size_t i = 0; i + 1 < monitor_ws_count; i++)
-      for (size_t j = i + 1; j < monitor_ws_count; j++)
-        if (monitor_workspaces[i]->index > monitor_workspaces[j]->index) {
-          struct ws *tmp = monitor_workspaces[i];
-          monitor_workspaces[i] = monitor_workspaces[j];
-          monitor_workspaces[j] = tmp;
-        }
     for (size_t i = 0; i < monitor_ws_count; i++) {
       printf("%s", monitor_workspaces[i]->active ? state->glyph_active : state->glyph_empty);
       if ((i + 1) % state->grid_cols == 0 && i < monitor_ws_count - 1)
@@ -68,30 +66,89 @@ void print_waybar_output(struct wayws_state *state) {
       else if (i < monitor_ws_count - 1)
         printf(" ");
     }
-    free(monitor_workspaces);
   }
   printf("\"}\n");
   fflush(stdout);
+  return 0;
+}
+void workspace_record(const struct ws *w, struct tpl_record *r) {
+  const char *mon = "(unknown)";
+  if (w->group && w->group->outputs && w->group->outputs->output &&
+      w->group->outputs->output->name)
+    mon = w->group->outputs->output->name;
+  *r = (struct tpl_record){
+      .name = w->name,
+      .id = w->id,
+      .output = mon,
+      .index = (long)w->index + 1,
+      .x = w->x,
+      .y = w->y,
+      .active = w->active,
+      .urgent = w->urgent,
+      .hidden = w->hidden,
+  };
+}
+
+void print_list_record(const struct tpl_record *r) {
+  printf("%2ld  %-15s %-10s %s\n", r->index, r->output,
+         (r->name && r->name[0]) ? r->name : "(unnamed)",
+         r->active ? "*" : "");
 }
+
+void json_put_workspace(struct outbuf *b, const struct tpl_record *r,
+                        uintptr_t group) {
+  outbuf_lit(b, "{\"index\":");
+  outbuf_put_uint(b, (unsigned long)r->index);
+  outbuf_lit(b, ",\"name\":");
+  outbuf_put_json_string(b, r->name);
+  outbuf_lit(b, ",\"id\":");
+  outbuf_put_json_string(b, r->id);
+  outbuf_lit(b, ",\"active\":");
+  outbuf_put_bool(b, r->active);
+  outbuf_lit(b, ",\"urgent\":");
+  outbuf_put_bool(b, r->urgent);
+  outbuf_lit(b, ",\"hidden\":");
+  outbuf_put_bool(b, r->hidden);
+  outbuf_lit(b, ",\"x\":");
+  outbuf_put_int(b, r->x);
+  outbuf_lit(b, ",\"y\":");
+  outbuf_put_int(b, r->y);
+  outbuf_lit(b, ",\"monitor\":");
+  outbuf_put_json_string(b, r->output);
+  // Same spelling as printf's %p
+  outbuf_lit(b, ",\"group_handle\":\"");
+  if (group)
+    outbuf_put_hex(b, group);
+  else
+    outbuf_lit(b, "(nil)");
+  outbuf_lit(b, "\"}");
+}
+
+// -l / --json with --format: one rendered line per workspace
+void print_formatted_list(struct wayws_state *state) {
+  struct outbuf b = {0};
+  struct tpl_record r;
+  for (size_t i = 0; i < state->vlen; i++) {
+    workspace_record(state->vec[i], &r);
+    template_render(&state->format, &b, &r);
+  }
+  fflush(stdout);
+  outbuf_flush(&b, STDOUT_FILENO);
+  outbuf_free(&b);
+}
+
 void print_json_output(struct wayws_state *state) {
-  printf("[");
-  int first = 1;
+  struct outbuf b = {0};
+  struct tpl_record r;
+  outbuf_putc(&b, '[');
   for (size_t i = 0; i < state->vlen; i++) {
-    if (!first)
-      printf(",");
-    first = 0;
-    const char *mon = "(unknown)";
-    if (state->vec[i]->group && state->vec[i]->group->outputs &&
-        state->vec[i]->group->outputs->output && state->vec[i]->group->outputs->output->name)
-      mon = state->vec[i]->group->outputs->output->name;
-    printf("{\"index\":%zu,\"name\":\"%s\",\"active\":%s,\"urgent\":%s,"
-           "\"hidden\":%s,"
-           "\"x\":%d,\"y\":%d,\"monitor\":\"%s\",\"group_handle\":\"%p\"}",
-           state->vec[i]->index + 1, state->vec[i]->name ? state->vec[i]->name : "",
-           state->vec[i]->active ? "true" : "false", state->vec[i]->urgent ? "true" : "false",
-           state->vec[i]->hidden ? "true" : "false", state->vec[i]->x, state->vec[i]->y, mon,
-           (void *)state->vec[i]->group);
+    if (i)
+      outbuf_putc(&b, ',');
+    workspace_record(state->vec[i], &r);
+    json_put_workspace(&b, &r, (uintptr_t)state->vec[i]->group);
   }
-  printf("]\n");
+  outbuf_lit(&b, "]\n");
   fflush(stdout);
-}
\ No newline at end of file
+  outbuf_flush(&b, STDOUT_FILENO);
+  outbuf_free(&b);
+}
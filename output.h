@@ -1,9 +1,20 @@
 #ifndef OUTPUT_H
 #define OUTPUT_H
 
+#include "outbuf.h"
+#include "template.h"
 #include "types.h"
+#include <stdint.h>
 
-void print_waybar_output(struct wayws_state *state);
+int print_waybar_output(struct wayws_state *state);
 void print_json_output(struct wayws_state *state);
+void print_formatted_list(struct wayws_state *state);
+
+// The -l / --json / --format view of one workspace, shared with --from-shm
+void workspace_record(const struct ws *w, struct tpl_record *r);
+void print_list_record(const struct tpl_record *r);
+// Appends one --json array element; group is the workspace's group handle
+void json_put_workspace(struct outbuf *b, const struct tpl_record *r,
+                        uintptr_t group);
 
 #endif // OUTPUT_H
@@ -0,0 +1,31 @@
+#include "plan.h"
+#include "types.h"
+
+// Works out from the parsed CLI state which globals and events the command
+// actually consumes, so one-shot startup binds nothing it will not read.
+unsigned startup_plan(const struct wayws_state *state) {
+  // Anything that prints the model, or keeps it alive, needs all of it.
+  if (state->flag_watch || state->flag_daemon || state->flag_serve ||
+      state->flag_list ||
+      state->flag_waybar || state->flag_json || state->flag_debug)
+    return NEED_ALL;
+
+  // An --exec hook is handed the activated workspace's name, id and output
+  if (state->opt_exec)
+    return NEED_ALL;
+
+  unsigned need = 0;
+  // Resolving the current workspace on a named output needs output names.
+  if (state->opt_output_name)
+    need |= NEED_OUTPUTS | NEED_GROUPS | NEED_WS_EVENTS;
+  // Grid navigation needs the active workspace and its group's members.
+  if (state->move_dir != DIR_NONE)
+    need |= NEED_GROUPS | NEED_WS_EVENTS;
+  if (state->want_name || state->want_id)
+    need |= NEED_WS_EVENTS;
+  // Confirming an activation means watching workspace state.
+  if (state->wait_ms || state->bench_activations)
+    need |= NEED_WS_EVENTS;
+  // Activation by global index only needs the workspace handles.
+  return need;
+}
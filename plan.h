@@ -0,0 +1,17 @@
+#ifndef PLAN_H
+#define PLAN_H
+
+#include "types.h"
+
+// What a command needs from the compositor beyond the workspace manager and
+// the workspace handles themselves.
+enum startup_need {
+  NEED_OUTPUTS = 1 << 0,   // bind wl_output (names, geometry) and await done
+  NEED_GROUPS = 1 << 1,    // workspace group membership events
+  NEED_WS_EVENTS = 1 << 2, // per-workspace name/state/coordinate events
+  NEED_ALL = NEED_OUTPUTS | NEED_GROUPS | NEED_WS_EVENTS,
+};
+
+unsigned startup_plan(const struct wayws_state *state);
+
+#endif // PLAN_H
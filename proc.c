@@ -0,0 +1,189 @@
+#define _GNU_SOURCE
+#include "proc.h"
+#include "util.h"
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static const struct {
+  const char *name;
+  int sig;
+} signal_names[] = {
+    {"HUP", SIGHUP},   {"INT", SIGINT},   {"QUIT", SIGQUIT},
+    {"KILL", SIGKILL}, {"USR1", SIGUSR1}, {"USR2", SIGUSR2},
+    {"TERM", SIGTERM}, {"CONT", SIGCONT}, {"STOP", SIGSTOP},
+    {"WINCH", SIGWINCH},
+};
+
+int proc_parse_signal(const char *s) {
+  if (isnum(s)) {
+    int sig = atoi(s);
+    return sig > 0 && sig < NSIG ? sig : -1;
+  }
+  if (strncasecmp(s, "SIG", 3) == 0)
+    s += 3;
+  for (size_t i = 0; i < sizeof signal_names / sizeof signal_names[0]; i++)
+    if (strcasecmp(s, signal_names[i].name) == 0)
+      return signal_names[i].sig;
+  // RTMIN+n / RTMAX-n, as used by Waybar's custom modules
+  int base, dir;
+  if (strncasecmp(s, "RTMIN", 5) == 0) {
+    base = SIGRTMIN;
+    dir = 1;
+  } else if (strncasecmp(s, "RTMAX", 5) == 0) {
+    base = SIGRTMAX;
+    dir = -1;
+  } else {
+    return -1;
+  }
+  s += 5;
+  int off = 0;
+  if (*s) {
+    if (*s != (dir > 0 ? '+' : '-') || !isnum(s + 1))
+      return -1;
+    off = atoi(s + 1);
+  }
+  int sig = base + dir * off;
+  return sig >= SIGRTMIN && sig <= SIGRTMAX ? sig : -1;
+}
+
+size_t proc_find(const char *name, pid_t *pids, size_t max) {
+  DIR *d = opendir("/proc");
+  if (!d)
+    return 0;
+  pid_t self = getpid();
+  size_t n = 0;
+  for (struct dirent *e; n < max && (e = readdir(d));) {
+    if (!isnum(e->d_name))
+      continue;
+    pid_t pid = (pid_t)atoi(e->d_name);
+    if (pid == self)
+      continue;
+    char path[64], comm[64];
+    snprintf(path, sizeof path, "/proc/%d/comm", (int)pid);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+      continue;
+    ssize_t len = read(fd, comm, sizeof comm - 1);
+    close(fd);
+    if (len <= 0)
+      continue;
+    comm[len] = '\0';
+    comm[strcspn(comm, "\n")] = '\0';
+    // The kernel cuts comm to 15 characters
+    if (strcmp(comm, name) == 0 ||
+        (len == 16 && strlen(name) > 15 && strncmp(comm, name, 15) == 0))
+      pids[n++] = pid;
+  }
+  closedir(d);
+  return n;
+}
+
+void proc_target_init(struct proc_target *t, const char *name, int sig) {
+  memset(t, 0, sizeof *t);
+  t->name = xstrdup(name);
+  t->sig = sig;
+}
+
+int proc_target_parse(struct proc_target *t, const char *spec) {
+  const char *colon = strrchr(spec, ':');
+  if (!colon || colon == spec)
+    return -1;
+  int sig = proc_parse_signal(colon + 1);
+  if (sig < 0)
+    return -1;
+  size_t len = (size_t)(colon - spec);
+  char *name = xrealloc(NULL, len + 1);
+  memcpy(name, spec, len);
+  name[len] = '\0';
+  proc_target_init(t, name, sig);
+  free(name);
+  return 0;
+}
+
+static int pidfd_open_(pid_t pid) {
+#ifdef SYS_pidfd_open
+  return (int)syscall(SYS_pidfd_open, pid, 0);
+#else
+  (void)pid;
+  errno = ENOSYS;
+  return -1;
+#endif
+}
+
+static int send_one(pid_t pid, int fd, int sig) {
+#ifdef SYS_pidfd_send_signal
+  if (fd >= 0)
+    return (int)syscall(SYS_pidfd_send_signal, fd, sig, NULL, 0);
+#endif
+  return kill(pid, sig);
+}
+
+static void forget(struct proc_target *t) {
+  for (size_t i = 0; i < t->n; i++)
+    if (t->fds[i] >= 0)
+      close(t->fds[i]);
+  t->n = 0;
+}
+
+// Returns 0 without scanning while the last scan that came back empty is
+// recent: a --signal target that is not running must not cost a walk over
+// /proc for every batch of events
+static int resolve(struct proc_target *t) {
+  uint64_t now = monotonic_ns();
+  if (now < t->rescan_ns)
+    return 0;
+  pid_t pids[PROC_TARGET_MAX];
+  size_t n = proc_find(t->name, pids, PROC_TARGET_MAX);
+  t->n = 0;
+  for (size_t i = 0; i < n; i++) {
+    // pidfds are close-on-exec, so hooks never inherit them
+    int fd = pidfd_open_(pids[i]);
+    if (fd < 0 && errno == ESRCH)
+      continue;
+    t->pids[t->n] = pids[i];
+    t->fds[t->n++] = fd;
+  }
+  t->rescan_ns = t->n ? 0 : now + (uint64_t)PROC_RESCAN_MS * 1000000;
+  return 1;
+}
+
+size_t proc_target_signal(struct proc_target *t) {
+  for (int pass = 0; pass < 2; pass++) {
+    int fresh = t->n == 0;
+    if (fresh && !resolve(t))
+      return 0;
+    size_t sent = 0;
+    for (size_t i = 0; i < t->n;) {
+      if (send_one(t->pids[i], t->fds[i], t->sig) == 0) {
+        sent++;
+        i++;
+        continue;
+      }
+      // Exited: drop it, keeping the rest in order
+      if (t->fds[i] >= 0)
+        close(t->fds[i]);
+      t->n--;
+      memmove(&t->pids[i], &t->pids[i + 1], (t->n - i) * sizeof t->pids[0]);
+      memmove(&t->fds[i], &t->fds[i + 1], (t->n - i) * sizeof t->fds[0]);
+    }
+    if (sent || fresh)
+      return sent;
+    // Every cached process is gone; it may have been restarted
+  }
+  return 0;
+}
+
+void proc_target_close(struct proc_target *t) {
+  forget(t);
+  free(t->name);
+  t->name = NULL;
+}
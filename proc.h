@@ -0,0 +1,41 @@
+#ifndef PROC_H
+#define PROC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+// Parses "USR1", "SIGUSR1", "RTMIN+1", "SIGRTMAX-2" or a number. Returns the
+// signal number, or -1.
+int proc_parse_signal(const char *s);
+// Fills pids with up to max processes whose name (/proc/PID/comm) is name,
+// skipping ourselves. Returns how many were found.
+size_t proc_find(const char *name, pid_t *pids, size_t max);
+
+// A signal sent to every process with a given name, like pkill. The
+// processes are looked up on first use and kept as pidfds, so later sends
+// are one syscall each and cannot hit a recycled pid. While none is
+// running, /proc is scanned again at most every PROC_RESCAN_MS rather than
+// on every send. A zeroed target is empty.
+#define PROC_TARGET_MAX 8
+#define PROC_RESCAN_MS 1000
+
+struct proc_target {
+  char *name; // owned
+  int sig;
+  size_t n;                    // resolved processes
+  pid_t pids[PROC_TARGET_MAX];
+  int fds[PROC_TARGET_MAX];    // pidfds, -1 where the kernel has none
+  uint64_t rescan_ns;          // no empty-handed scan again before this
+};
+
+void proc_target_init(struct proc_target *t, const char *name, int sig);
+// Parses NAME:SIG. Returns -1 if either part is missing or invalid.
+int proc_target_parse(struct proc_target *t, const char *spec);
+// Sends the signal, looking the processes up again once every cached one
+// has exited (e.g. the bar was restarted), unless the last lookup found
+// nothing less than PROC_RESCAN_MS ago. Returns how many were signalled.
+size_t proc_target_signal(struct proc_target *t);
+void proc_target_close(struct proc_target *t);
+
+#endif // PROC_H
@@ -0,0 +1,263 @@
+#define _GNU_SOURCE
+#include "rules.h"
+#include "exec.h"
+#include "filter.h"
+#include "proc.h"
+#include "types.h"
+#include "util.h"
+#include "workspace.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static const struct {
+  const char *name;
+  enum rule_action action;
+} action_names[] = {
+    {"exec", RULE_EXEC},
+    {"signal", RULE_SIGNAL},
+    {"fifo", RULE_FIFO},
+    {"activate", RULE_ACTIVATE},
+};
+
+static const char blanks[] = " \t";
+
+// Splits off the next blank-separated word of *p in place
+static char *next_word(char **p) {
+  char *s = *p + strspn(*p, blanks);
+  if (!*s)
+    return NULL;
+  char *end = s + strcspn(s, blanks);
+  *p = *end ? end + 1 : end;
+  *end = '\0';
+  return s;
+}
+
+static int parse_rule(struct rule *r, char *line, char *err, size_t errlen) {
+  r->line = line;
+  r->fifo_fd = -1;
+  char *p = line;
+  char *word;
+  while ((word = next_word(&p)) && strchr(word, '=')) {
+    int bad = strncmp(word, "type=", 5) == 0
+                  ? filter_parse_events(&r->match, word + 5)
+                  : filter_parse_match(&r->match, word);
+    if (bad) {
+      snprintf(err, errlen, "bad predicate '%s'", word);
+      return -1;
+    }
+  }
+  if (!word) {
+    snprintf(err, errlen, "missing action");
+    return -1;
+  }
+  size_t i = 0;
+  while (i < sizeof action_names / sizeof action_names[0] &&
+         strcmp(action_names[i].name, word) != 0)
+    i++;
+  if (i == sizeof action_names / sizeof action_names[0]) {
+    snprintf(err, errlen, "unknown action '%s'", word);
+    return -1;
+  }
+  r->action = action_names[i].action;
+
+  if (r->action == RULE_SIGNAL) {
+    r->arg = next_word(&p);
+    char *signame = next_word(&p);
+    int sig = signame ? proc_parse_signal(signame) : -1;
+    if (!r->arg || sig < 0 || next_word(&p)) {
+      snprintf(err, errlen, "signal expects a process name and a signal");
+      return -1;
+    }
+    proc_target_init(&r->target, r->arg, sig);
+    return 0;
+  }
+  // exec takes the rest of the line; the others one word
+  p += strspn(p, blanks);
+  if (r->action == RULE_EXEC) {
+    r->arg = *p ? p : NULL;
+  } else {
+    r->arg = next_word(&p);
+    if (next_word(&p))
+      r->arg = NULL;
+  }
+  if (!r->arg) {
+    snprintf(err, errlen, "%s expects %s", word,
+             r->action == RULE_EXEC ? "a command" : "one argument");
+    return -1;
+  }
+  return 0;
+}
+
+static void build_dispatch(struct rule_set *rs) {
+  for (int t = 0; t < EVENT_TYPE_COUNT; t++) {
+    for (size_t i = 0; i < rs->n; i++) {
+      struct rule *r = &rs->rules[i];
+      if (r->match.types && !(r->match.types & (1u << t)))
+        continue;
+      rs->by_type[t] = xrealloc(rs->by_type[t],
+                                (rs->nby_type[t] + 1) * sizeof *rs->by_type[t]);
+      rs->by_type[t][rs->nby_type[t]++] = r;
+    }
+  }
+}
+
+struct rule_set *rules_parse(const char *text, char *err, size_t errlen) {
+  struct rule_set *rs = calloc(1, sizeof *rs);
+  if (!rs)
+    die("Out of memory.\n");
+  int lineno = 0;
+  for (const char *p = text; *p;) {
+    size_t len = strcspn(p, "\n");
+    lineno++;
+    char *line = xrealloc(NULL, len + 1);
+    memcpy(line, p, len);
+    line[len] = '\0';
+    p += len + (p[len] == '\n');
+
+    char first = line[strspn(line, blanks)];
+    if (!first || first == '#') {
+      free(line);
+      continue;
+    }
+    rs->rules = xrealloc(rs->rules, (rs->n + 1) * sizeof *rs->rules);
+    struct rule *r = &rs->rules[rs->n];
+    memset(r, 0, sizeof *r);
+    char why[128];
+    if (parse_rule(r, line, why, sizeof why) != 0) {
+      snprintf(err, errlen, "line %d: %s", lineno, why);
+      free(line);
+      rules_free(rs);
+      return NULL;
+    }
+    rs->n++;
+  }
+  build_dispatch(rs);
+  return rs;
+}
+
+struct rule_set *rules_load(const char *path, char *err, size_t errlen) {
+  FILE *f = fopen(path, "r");
+  if (!f) {
+    snprintf(err, errlen, "%s: %s", path, strerror(errno));
+    return NULL;
+  }
+  char *text = NULL;
+  size_t len = 0;
+  char buf[4096];
+  for (size_t n; (n = fread(buf, 1, sizeof buf, f)) > 0; len += n) {
+    text = xrealloc(text, len + n + 1);
+    memcpy(text + len, buf, n);
+  }
+  fclose(f);
+  if (!text)
+    text = xstrdup("");
+  text[len] = '\0';
+  struct rule_set *rs = rules_parse(text, err, errlen);
+  free(text);
+  return rs;
+}
+
+void rules_free(struct rule_set *rs) {
+  if (!rs)
+    return;
+  for (size_t i = 0; i < rs->n; i++) {
+    if (rs->rules[i].fifo_fd >= 0)
+      close(rs->rules[i].fifo_fd);
+    proc_target_close(&rs->rules[i].target);
+    free(rs->rules[i].line);
+  }
+  for (int t = 0; t < EVENT_TYPE_COUNT; t++)
+    free(rs->by_type[t]);
+  free(rs->rules);
+  free(rs);
+}
+
+// Writes the event as a JSON line. The FIFO is opened without blocking and
+// kept open; with no reader the event is simply dropped.
+static void write_fifo(struct rule *r, const struct tpl_record *ev) {
+  if (r->fifo_fd < 0)
+    r->fifo_fd = open(r->arg, O_WRONLY | O_NONBLOCK | O_CLOEXEC);
+  if (r->fifo_fd < 0)
+    return;
+  struct outbuf b = {0};
+  outbuf_lit(&b, "{\"type\":");
+  outbuf_put_json_string(&b, ev->type);
+  outbuf_lit(&b, ",\"workspace\":{\"name\":");
+  outbuf_put_json_string(&b, ev->name);
+  outbuf_lit(&b, ",\"index\":");
+  outbuf_put_int(&b, ev->index);
+  outbuf_lit(&b, ",\"output\":");
+  outbuf_put_json_string(&b, ev->output);
+  outbuf_lit(&b, ",\"active\":");
+  outbuf_put_bool(&b, ev->active);
+  outbuf_lit(&b, ",\"urgent\":");
+  outbuf_put_bool(&b, ev->urgent);
+  outbuf_lit(&b, ",\"hidden\":");
+  outbuf_put_bool(&b, ev->hidden);
+  outbuf_lit(&b, "}}\n");
+  // A FIFO reader going away must not kill us, but SIGPIPE stays as it is
+  // for stdout: a closed pipe there still ends watch mode. The write's own
+  // SIGPIPE is blocked and taken back off this thread if it was raised.
+  sigset_t pipe_set, old;
+  sigemptyset(&pipe_set);
+  sigaddset(&pipe_set, SIGPIPE);
+  pthread_sigmask(SIG_BLOCK, &pipe_set, &old);
+  if (outbuf_flush(&b, r->fifo_fd) != 0 && errno == EPIPE) {
+    const struct timespec now = {0};
+    sigtimedwait(&pipe_set, NULL, &now);
+    // Reader went away; reopen on the next event
+    close(r->fifo_fd);
+    r->fifo_fd = -1;
+  }
+  pthread_sigmask(SIG_SETMASK, &old, NULL);
+  outbuf_free(&b);
+}
+
+static void activate(struct wayws_state *state, const char *what) {
+  struct ws *w = NULL;
+  if (isnum(what)) {
+    size_t idx = (size_t)atoi(what);
+    if (idx >= 1 && idx <= state->vlen)
+      w = state->vec[idx - 1];
+  } else {
+    w = ws_by_name(state, what);
+  }
+  if (!w || !state->mgr)
+    return;
+  ext_workspace_handle_v1_activate(w->h);
+  ext_workspace_manager_v1_commit(state->mgr);
+}
+
+void rules_dispatch(struct wayws_state *state, wayws_event_type_t type,
+                    const struct tpl_record *ev) {
+  struct rule_set *rs = state->rules;
+  for (size_t i = 0; i < rs->nby_type[type]; i++) {
+    struct rule *r = rs->by_type[type][i];
+    if (!filter_accepts(&r->match, type, ev->name, ev->output, ev->active,
+                        ev->urgent, ev->hidden))
+      continue;
+    switch (r->action) {
+    case RULE_EXEC: {
+      struct exec_job job = {.cmd = r->arg, .ev = ev, .key = r};
+      exec_request(&state->exec, &job);
+      break;
+    }
+    case RULE_SIGNAL:
+      proc_target_signal(&r->target);
+      break;
+    case RULE_FIFO:
+      write_fifo(r, ev);
+      break;
+    case RULE_ACTIVATE:
+      activate(state, r->arg);
+      break;
+    }
+  }
+}
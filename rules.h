@@ -0,0 +1,52 @@
+#ifndef RULES_H
+#define RULES_H
+
+#include "proc.h"
+#include "template.h"
+#include "types.h"
+#include <stddef.h>
+
+// --rules FILE: event predicates mapped to built-in actions. One rule per
+// line, lines starting with '#' are comments:
+//
+//   type=state active=true output=DP-1  signal waybar RTMIN+1
+//   urgent=true                         exec notify-send "$WAYWS_NAME"
+//   type=created,destroyed              fifo /run/user/1000/wayws.fifo
+//   type=state active=true name=web     activate 2
+//
+// Predicates use the --events / --match vocabulary (type= takes the
+// --events list). The first word that is not KEY=VALUE names the action.
+enum rule_action { RULE_EXEC, RULE_SIGNAL, RULE_FIFO, RULE_ACTIVATE };
+
+struct rule {
+  struct event_filter match; // strings point into line
+  enum rule_action action;
+  const char *arg; // command, process name, FIFO path or workspace
+  struct proc_target target; // RULE_SIGNAL
+  int fifo_fd;               // RULE_FIFO, -1 while closed
+  char *line;      // owned, split in place
+};
+
+// Rules are compiled into one list per event type, so dispatch only looks at
+// rules that can match.
+struct rule_set {
+  struct rule *rules;
+  size_t n;
+  struct rule **by_type[EVENT_TYPE_COUNT];
+  size_t nby_type[EVENT_TYPE_COUNT];
+};
+
+// Both return NULL and describe the problem in err on failure
+struct rule_set *rules_parse(const char *text, char *err, size_t errlen);
+struct rule_set *rules_load(const char *path, char *err, size_t errlen);
+void rules_free(struct rule_set *rs);
+
+static inline int rules_want(const struct rule_set *rs,
+                             wayws_event_type_t type) {
+  return rs && rs->nby_type[type];
+}
+// Runs the action of every rule matching ev
+void rules_dispatch(struct wayws_state *state, wayws_event_type_t type,
+                    const struct tpl_record *ev);
+
+#endif // RULES_H
@@ -0,0 +1,559 @@
+#define _GNU_SOURCE
+
+#include "serve.h"
+#include "daemon.h"
+#include "event.h"
+#include "filter.h"
+#include "loop.h"
+#include "outbuf.h"
+#include "types.h"
+#include "util.h"
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Wire format (subscriber -> server): struct hello, then the output= and
+// name= filter strings without terminators (length -1 when unset).
+// Reply: one int32_t status, then JSON lines until either side closes.
+struct hello {
+  uint32_t types, state_mask, state_want;
+  int32_t output_len, name_len;
+};
+#define SERVE_MAX_STR 256
+
+// A ring record: this header, the name and output (NUL-terminated, for
+// filtering), then the JSON line. Sizes are multiples of 16 so a header
+// always fits before the end of the ring; a REC_PAD record fills the gap
+// when the next record does not.
+struct rec {
+  uint32_t size;
+  uint32_t json_len;
+  uint16_t name_len, output_len;
+  uint8_t type;
+  uint8_t bits; // FILTER_* state
+  uint8_t unused[2];
+};
+#define REC_PAD 0xff
+#define REC_ALIGN 16
+// Lines per writev()
+#define SERVE_IOV 64
+
+void serve_init(struct serve *s, size_t cap) {
+  memset(s, 0, sizeof *s);
+  s->cap = cap;
+  s->ring = xrealloc(NULL, cap);
+}
+
+void serve_free(struct serve *s) {
+  for (size_t i = 0; i < s->nsubs; i++)
+    s->subs[i].dead = 1;
+  serve_sweep(s);
+  outbuf_free(&s->line);
+  free(s->ring);
+  s->ring = NULL;
+}
+
+static struct rec *rec_at(const struct serve *s, uint64_t pos) {
+  return (struct rec *)(s->ring + pos % s->cap);
+}
+
+static const char *rec_name(const struct rec *r) {
+  return (const char *)(r + 1);
+}
+
+static const char *rec_output(const struct rec *r) {
+  return rec_name(r) + r->name_len + 1;
+}
+
+static const char *rec_json(const struct rec *r) {
+  return rec_output(r) + r->output_len + 1;
+}
+
+// Drops the oldest records until n more bytes fit
+static void make_room(struct serve *s, size_t n) {
+  while (s->head + n - s->tail > s->cap)
+    s->tail += rec_at(s, s->tail)->size;
+}
+
+void serve_append(struct serve *s, const wayws_event_t *ev) {
+  s->line.len = 0;
+  serialize_event(&s->line, ev);
+  size_t nl = strlen(ev->workspace_name), ol = strlen(ev->output_name);
+  size_t size = sizeof(struct rec) + nl + 1 + ol + 1 + s->line.len;
+  size = (size + REC_ALIGN - 1) & ~(size_t)(REC_ALIGN - 1);
+  // Names are short; this only guards against a hostile compositor
+  if (size > s->cap / 4 || nl > UINT16_MAX || ol > UINT16_MAX)
+    return;
+
+  size_t pos = s->head % s->cap;
+  if (s->cap - pos < size) {
+    make_room(s, s->cap - pos);
+    struct rec *pad = rec_at(s, s->head);
+    pad->size = (uint32_t)(s->cap - pos);
+    pad->type = REC_PAD;
+    s->head += s->cap - pos;
+  }
+  make_room(s, size);
+  struct rec *r = rec_at(s, s->head);
+  *r = (struct rec){
+      .size = (uint32_t)size,
+      .json_len = (uint32_t)s->line.len,
+      .name_len = (uint16_t)nl,
+      .output_len = (uint16_t)ol,
+      .type = (uint8_t)ev->type,
+      .bits = (uint8_t)((ev->active ? FILTER_ACTIVE : 0) |
+                        (ev->urgent ? FILTER_URGENT : 0) |
+                        (ev->hidden ? FILTER_HIDDEN : 0)),
+  };
+  memcpy((char *)rec_name(r), ev->workspace_name, nl + 1);
+  memcpy((char *)rec_output(r), ev->output_name, ol + 1);
+  memcpy((char *)rec_json(r), s->line.buf, s->line.len);
+  s->head += size;
+}
+
+void serve_commit(struct serve *s) {
+  s->committed = s->head;
+  for (size_t i = 0; i < s->nsubs; i++) {
+    struct serve_sub *sub = &s->subs[i];
+    if (sub->dead)
+      continue;
+    if (!sub->blocked) {
+      serve_pump(s, sub);
+    } else if (sub->cursor < s->tail) {
+      // Still not reading, and now a whole ring behind
+      s->dropped++;
+      sub->dead = 1;
+    }
+  }
+}
+
+static int wants(const struct serve_sub *sub, const struct rec *r) {
+  return r->type != REC_PAD &&
+         filter_accepts(&sub->filter, (wayws_event_type_t)r->type,
+                        rec_name(r), rec_output(r), r->bits & FILTER_ACTIVE,
+                        r->bits & FILTER_URGENT, r->bits & FILTER_HIDDEN);
+}
+
+// Sends as much as fits without blocking. Returns the bytes sent, 0 when
+// the socket is full, or -1 when the subscriber is gone.
+static ssize_t send_some(struct serve_sub *sub, struct iovec *iov, size_t n) {
+  struct msghdr msg = {.msg_iov = iov, .msg_iovlen = n};
+  for (;;) {
+    ssize_t w = sendmsg(sub->fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (w >= 0)
+      return w;
+    if (errno == EINTR)
+      continue;
+    if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      sub->blocked = 1;
+      return 0;
+    }
+    return -1;
+  }
+}
+
+void serve_pump(struct serve *s, struct serve_sub *sub) {
+  if (sub->dead)
+    return;
+  sub->blocked = 0;
+  while (sub->snap_off < sub->snap.len) {
+    struct iovec iov = {sub->snap.buf + sub->snap_off,
+                        sub->snap.len - sub->snap_off};
+    ssize_t w = send_some(sub, &iov, 1);
+    if (w < 0)
+      goto dead;
+    if (w == 0)
+      return;
+    sub->snap_off += (size_t)w;
+  }
+  if (sub->snap.buf) {
+    outbuf_free(&sub->snap);
+    sub->snap_off = 0;
+  }
+
+  for (;;) {
+    if (sub->cursor < s->tail) {
+      // Overwritten before it could be sent
+      s->dropped++;
+      goto dead;
+    }
+    struct iovec iov[SERVE_IOV];
+    uint64_t start[SERVE_IOV];
+    size_t skip[SERVE_IOV], n = 0;
+    uint64_t pos = sub->cursor;
+    size_t part = sub->part;
+    while (pos < s->committed && n < SERVE_IOV) {
+      const struct rec *r = rec_at(s, pos);
+      if (wants(sub, r)) {
+        iov[n].iov_base = (char *)rec_json(r) + part;
+        iov[n].iov_len = r->json_len - part;
+        start[n] = pos;
+        skip[n++] = part;
+      }
+      part = 0;
+      pos += r->size;
+    }
+    if (!n) {
+      sub->cursor = pos;
+      sub->part = 0;
+      return;
+    }
+    ssize_t w = send_some(sub, iov, n);
+    if (w < 0)
+      goto dead;
+    size_t left = (size_t)w;
+    for (size_t i = 0; i < n; i++) {
+      if (left < iov[i].iov_len) {
+        // Stopped inside this line; the socket is full
+        sub->cursor = start[i];
+        sub->part = skip[i] + left;
+        sub->blocked = 1;
+        return;
+      }
+      left -= iov[i].iov_len;
+    }
+    sub->cursor = pos;
+    sub->part = 0;
+  }
+
+dead:
+  sub->dead = 1;
+}
+
+struct serve_sub *serve_add(struct serve *s, int fd,
+                            const struct event_filter *f) {
+  if (s->nsubs == SERVE_MAX_SUBS)
+    return NULL;
+  struct serve_sub *sub = &s->subs[s->nsubs++];
+  size_t ol = f->output ? strlen(f->output) + 1 : 0;
+  size_t nl = f->name ? strlen(f->name) + 1 : 0;
+  *sub = (struct serve_sub){.fd = fd, .filter = *f, .cursor = s->committed};
+  sub->strs = xrealloc(NULL, ol + nl + 1);
+  if (f->output) {
+    memcpy(sub->strs, f->output, ol);
+    sub->filter.output = sub->strs;
+  }
+  if (f->name) {
+    memcpy(sub->strs + ol, f->name, nl);
+    sub->filter.name = sub->strs + ol;
+  }
+  return sub;
+}
+
+void serve_sweep(struct serve *s) {
+  for (size_t i = s->nsubs; i-- > 0;) {
+    struct serve_sub *sub = &s->subs[i];
+    if (!sub->dead)
+      continue;
+    close(sub->fd);
+    free(sub->strs);
+    outbuf_free(&sub->snap);
+    *sub = s->subs[--s->nsubs];
+  }
+}
+
+void serve_snapshot(struct wayws_state *state, const struct event_filter *f,
+                    struct outbuf *b) {
+  uint64_t now = monotonic_ns();
+  for (size_t i = 0; i < state->vlen; i++) {
+    const struct ws *w = state->vec[i];
+    wayws_event_t ev = {
+        .type = EVENT_WORKSPACE_STATE,
+        .workspace_name = w->name ? w->name : "",
+        .output_name = get_output_name_for_workspace((struct ws *)w),
+        .workspace_index = (int)w->index + 1,
+        .x = w->x,
+        .y = w->y,
+        .active = w->active,
+        .urgent = w->urgent,
+        .hidden = w->hidden,
+        .timestamp = now,
+    };
+    if (filter_accepts(f, ev.type, ev.workspace_name, ev.output_name,
+                       ev.active, ev.urgent, ev.hidden))
+      serialize_event(b, &ev);
+  }
+}
+
+// --- sockets -----------------------------------------------------------------
+
+int serve_socket_path(char *buf, size_t len) {
+  char path[sizeof(((struct sockaddr_un *)0)->sun_path)];
+  if (daemon_socket_path(path, sizeof path) != 0)
+    return -1;
+  // wayws-DISPLAY.sock -> wayws-DISPLAY.events.sock
+  path[strlen(path) - strlen(".sock")] = '\0';
+  int n = snprintf(buf, len, "%s.events.sock", path);
+  return (n < 0 || (size_t)n >= len) ? -1 : 0;
+}
+
+static int socket_addr(struct sockaddr_un *addr) {
+  memset(addr, 0, sizeof *addr);
+  addr->sun_family = AF_UNIX;
+  return serve_socket_path(addr->sun_path, sizeof addr->sun_path);
+}
+
+static int connect_server(void) {
+  struct sockaddr_un addr;
+  if (socket_addr(&addr) != 0)
+    return -1;
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0)
+    return -1;
+  if (connect(fd, (struct sockaddr *)&addr, sizeof addr) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+static int listen_server(void) {
+  struct sockaddr_un addr;
+  if (socket_addr(&addr) != 0)
+    die("XDG_RUNTIME_DIR is not set; cannot create the event socket.\n");
+
+  int probe = connect_server();
+  if (probe >= 0) {
+    close(probe);
+    die("Another wayws event server is already running.\n");
+  }
+  unlink(addr.sun_path);
+
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+  if (fd < 0)
+    die("Failed to create the event socket.\n");
+  mode_t old_mask = umask(0077);
+  int ret = bind(fd, (struct sockaddr *)&addr, sizeof addr);
+  umask(old_mask);
+  if (ret != 0 || listen(fd, 16) != 0)
+    die("Failed to bind the event socket.\n");
+  return fd;
+}
+
+static int recv_str(int fd, int32_t len, char *buf) {
+  if (len < 0)
+    return 0;
+  if (len >= SERVE_MAX_STR ||
+      (len && recv(fd, buf, (size_t)len, MSG_WAITALL) != len))
+    return -1;
+  buf[len] = '\0';
+  return 1;
+}
+
+// Reads a subscriber's filter and, if there is room, starts streaming to it
+// with a snapshot of the current state.
+static void accept_subscriber(struct wayws_state *state, struct serve *s,
+                              int cfd) {
+  // A stuck client must not wedge the server.
+  struct timeval tv = {.tv_sec = 1};
+  setsockopt(cfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof tv);
+
+  struct hello h;
+  char output[SERVE_MAX_STR], name[SERVE_MAX_STR];
+  int32_t status = 1;
+  struct event_filter f = {0};
+  if (recv(cfd, &h, sizeof h, MSG_WAITALL) == (ssize_t)sizeof h) {
+    int has_output = recv_str(cfd, h.output_len, output);
+    int has_name = has_output >= 0 ? recv_str(cfd, h.name_len, name) : -1;
+    if (has_name >= 0 && s->nsubs < SERVE_MAX_SUBS) {
+      f = (struct event_filter){
+          .types = h.types,
+          .state_mask = h.state_mask,
+          .state_want = h.state_want,
+          .output = has_output ? output : NULL,
+          .name = has_name ? name : NULL,
+      };
+      status = 0;
+    }
+  }
+  if (send(cfd, &status, sizeof status, MSG_NOSIGNAL) != sizeof status ||
+      status != 0) {
+    close(cfd);
+    return;
+  }
+  struct serve_sub *sub = serve_add(s, cfd, &f);
+  serve_snapshot(state, &sub->filter, &sub->snap);
+  serve_pump(s, sub);
+}
+
+int serve_run(struct wayws_state *state, volatile sig_atomic_t *stop) {
+  char path[sizeof(((struct sockaddr_un *)0)->sun_path)];
+  int lfd = listen_server();
+  serve_socket_path(path, sizeof path);
+  // Subscribers that exit must not kill us.
+  signal(SIGPIPE, SIG_IGN);
+
+  static struct serve s;
+  serve_init(&s, SERVE_RING_SIZE);
+  state->serve = &s;
+  state->event_enabled = 1;
+
+  int ret = 0;
+  while (!*stop) {
+    while (wl_display_prepare_read(state->dpy) != 0)
+      wl_display_dispatch_pending(state->dpy);
+    wl_display_flush(state->dpy);
+
+    struct pollfd pfd[2 + SERVE_MAX_SUBS] = {
+        {.fd = wl_display_get_fd(state->dpy), .events = POLLIN},
+        {.fd = lfd, .events = POLLIN},
+    };
+    size_t npolled = s.nsubs;
+    for (size_t i = 0; i < npolled; i++) {
+      pfd[2 + i].fd = s.subs[i].fd;
+      pfd[2 + i].events = POLLIN | (s.subs[i].blocked ? POLLOUT : 0);
+    }
+    if (poll(pfd, 2 + npolled, -1) < 0) {
+      wl_display_cancel_read(state->dpy);
+      if (errno == EINTR)
+        continue;
+      ret = 1;
+      break;
+    }
+
+    if (pfd[0].revents) {
+      if (wl_display_read_events(state->dpy) != 0) {
+        fputs("Lost connection to the Wayland compositor.\n", stderr);
+        ret = 1;
+        break;
+      }
+    } else {
+      wl_display_cancel_read(state->dpy);
+    }
+    // Batches end in here, and are pumped to every subscriber
+    wl_display_dispatch_pending(state->dpy);
+
+    for (size_t i = 0; i < npolled; i++) {
+      struct serve_sub *sub = &s.subs[i];
+      // Subscribers never send anything after the hello; input means
+      // they hung up
+      if (pfd[2 + i].revents & (POLLIN | POLLHUP | POLLERR)) {
+        char buf[64];
+        if (recv(sub->fd, buf, sizeof buf, MSG_DONTWAIT) <= 0)
+          sub->dead = 1;
+      }
+      if (pfd[2 + i].revents & POLLOUT)
+        serve_pump(&s, sub);
+    }
+    serve_sweep(&s);
+
+    if (pfd[1].revents & POLLIN) {
+      int cfd = accept4(lfd, NULL, NULL, SOCK_CLOEXEC);
+      if (cfd >= 0)
+        accept_subscriber(state, &s, cfd);
+    }
+  }
+
+  state->serve = NULL;
+  serve_free(&s);
+  close(lfd);
+  unlink(path);
+  return ret;
+}
+
+static int send_str(int fd, const char *str) {
+  return !str || send(fd, str, strlen(str), MSG_NOSIGNAL) ==
+                     (ssize_t)strlen(str)
+             ? 0
+             : -1;
+}
+
+static int write_all(int fd, const char *buf, size_t n) {
+  while (n) {
+    ssize_t w = write(fd, buf, n);
+    if (w < 0 && errno == EINTR)
+      continue;
+    if (w <= 0)
+      return -1;
+    buf += w;
+    n -= (size_t)w;
+  }
+  return 0;
+}
+
+static void on_readable(struct loop_source *src, uint32_t events) {
+  (void)events;
+  *(int *)src->data = 1;
+}
+
+static void on_stop_signal(struct loop_source *src, uint32_t events) {
+  (void)events;
+  while (loop_signal(src) > 0)
+    *(volatile sig_atomic_t *)src->data = 1;
+}
+
+int serve_subscribe(const struct event_filter *f, volatile sig_atomic_t *stop) {
+  if ((f->output && strlen(f->output) >= SERVE_MAX_STR) ||
+      (f->name && strlen(f->name) >= SERVE_MAX_STR))
+    return -1;
+  int fd = connect_server();
+  if (fd < 0)
+    return -1;
+  struct hello h = {
+      .types = f->types,
+      .state_mask = f->state_mask,
+      .state_want = f->state_want,
+      .output_len = f->output ? (int32_t)strlen(f->output) : -1,
+      .name_len = f->name ? (int32_t)strlen(f->name) : -1,
+  };
+  int32_t status;
+  if (send(fd, &h, sizeof h, MSG_NOSIGNAL) != (ssize_t)sizeof h ||
+      send_str(fd, f->output) != 0 || send_str(fd, f->name) != 0 ||
+      recv(fd, &status, sizeof status, MSG_WAITALL) != (ssize_t)sizeof status ||
+      status != 0) {
+    // Full or going away; watching directly still works
+    close(fd);
+    return -1;
+  }
+
+  // Signals come through the loop, so waiting needs no timeout to notice
+  // them
+  int readable = 0;
+  struct loop loop;
+  struct loop_source conn = {.fd = fd, .fn = on_readable, .data = &readable};
+  struct loop_source sig = {.fn = on_stop_signal, .data = (void *)stop};
+  sigset_t set;
+  sigemptyset(&set);
+  sigaddset(&set, SIGINT);
+  sigaddset(&set, SIGTERM);
+  if (loop_init(&loop) != 0 || loop_add(&loop, &conn, EPOLLIN) != 0 ||
+      loop_add_signals(&loop, &sig, &set) != 0) {
+    loop_destroy(&loop);
+    close(fd);
+    return -1;
+  }
+
+  int ret = 0;
+  char buf[65536];
+  while (!*stop) {
+    readable = 0;
+    if (loop_dispatch(&loop, -1) < 0) {
+      ret = 1;
+      break;
+    }
+    if (!readable)
+      continue;
+    ssize_t n = recv(fd, buf, sizeof buf, 0);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0) {
+      fputs("wayws: the event server went away.\n", stderr);
+      ret = 1;
+      break;
+    }
+    if (write_all(STDOUT_FILENO, buf, (size_t)n) != 0)
+      break;
+  }
+  loop_remove(&loop, &conn);
+  loop_destroy(&loop);
+  close(fd);
+  return ret;
+}
@@ -0,0 +1,66 @@
+#ifndef SERVE_H
+#define SERVE_H
+
+#include "outbuf.h"
+#include "types.h"
+#include <signal.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// --serve: one Wayland connection shared by every `wayws -w` on the
+// display. Each event is serialized once into a ring of records; every
+// subscriber has its own read cursor into the ring and its own filter, and
+// is written to at the end of each compositor batch. A subscriber that
+// falls a whole ring behind is dropped rather than slowing the others down.
+#define SERVE_RING_SIZE (1u << 20)
+#define SERVE_MAX_SUBS 64
+
+struct serve_sub {
+  int fd;
+  struct event_filter filter; // output and name point into strs
+  char *strs;
+  uint64_t cursor;    // ring offset of the next record to look at
+  size_t part;        // bytes of that record's line already written
+  struct outbuf snap; // the state at subscription, sent before the ring
+  size_t snap_off;
+  int blocked; // the socket is full; resume on POLLOUT
+  int dead;    // gone or too slow; removed by serve_sweep()
+};
+
+struct serve {
+  char *ring;
+  size_t cap;
+  uint64_t head;      // bytes appended so far
+  uint64_t committed; // end of the last complete batch
+  uint64_t tail;      // oldest record still in the ring
+  struct outbuf line; // scratch for serializing one event
+  struct serve_sub subs[SERVE_MAX_SUBS];
+  size_t nsubs;
+  unsigned long dropped; // subscribers that fell a whole ring behind
+};
+
+// cap must be a multiple of 16
+void serve_init(struct serve *s, size_t cap);
+void serve_free(struct serve *s);
+void serve_append(struct serve *s, const wayws_event_t *ev);
+// Ends a batch: everything appended so far becomes visible to subscribers
+void serve_commit(struct serve *s);
+// Takes ownership of fd (a connected stream socket). Returns NULL when the
+// server is full.
+struct serve_sub *serve_add(struct serve *s, int fd,
+                            const struct event_filter *f);
+// Writes what sub can take without blocking; marks it dead on error
+void serve_pump(struct serve *s, struct serve_sub *sub);
+void serve_sweep(struct serve *s);
+// The current model as one workspace_state event per workspace
+void serve_snapshot(struct wayws_state *state, const struct event_filter *f,
+                    struct outbuf *b);
+
+int serve_socket_path(char *buf, size_t len);
+int serve_run(struct wayws_state *state, volatile sig_atomic_t *stop);
+// Streams a running server's events, filtered by f, to stdout. Returns the
+// exit status, or -1 when there is no server and the caller should watch
+// on its own connection.
+int serve_subscribe(const struct event_filter *f, volatile sig_atomic_t *stop);
+
+#endif // SERVE_H
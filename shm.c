@@ -0,0 +1,290 @@
+#define _GNU_SOURCE
+
+#include "shm.h"
+#include "daemon.h"
+#include "output.h"
+#include "outbuf.h"
+#include "template.h"
+#include "types.h"
+#include "util.h"
+#include <fcntl.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Attempts before a reader gives up on a publisher that is always mid-write
+#define SHM_READ_TRIES 1000
+
+int shm_path(char *buf, size_t len) {
+  char path[256];
+  if (daemon_socket_path(path, sizeof path) != 0)
+    return -1;
+  // wayws-DISPLAY.sock -> wayws-DISPLAY.state
+  path[strlen(path) - strlen(".sock")] = '\0';
+  int n = snprintf(buf, len, "%s.state", path);
+  return (n < 0 || (size_t)n >= len) ? -1 : 0;
+}
+
+// --- publisher ---------------------------------------------------------------
+
+struct shm_publisher *shm_publisher_open(const char *path) {
+  int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+  if (fd < 0)
+    return NULL;
+  // Never truncate before holding the lock: the file may be another
+  // publisher's
+  if (flock(fd, LOCK_EX | LOCK_NB) != 0 ||
+      ftruncate(fd, sizeof(struct shm_snapshot)) != 0) {
+    close(fd);
+    return NULL;
+  }
+  struct shm_snapshot *map = mmap(NULL, sizeof *map, PROT_READ | PROT_WRITE,
+                                  MAP_SHARED, fd, 0);
+  if (map == MAP_FAILED) {
+    close(fd);
+    return NULL;
+  }
+  // Whatever a previous publisher left is not ours; odd until the first
+  // shm_publish()
+  atomic_store_explicit(
+      &map->seq, atomic_load_explicit(&map->seq, memory_order_relaxed) | 1,
+      memory_order_relaxed);
+  map->magic = SHM_MAGIC;
+  map->version = SHM_VERSION;
+
+  struct shm_publisher *p = xrealloc(NULL, sizeof *p);
+  p->fd = fd;
+  p->map = map;
+  p->path = xstrdup(path);
+  return p;
+}
+
+// Offset of s in m->strs; offset 0 is the empty string
+static uint32_t put_str(struct shm_snapshot *m, uint32_t *len, const char *s,
+                        int *full) {
+  if (!s || !*s)
+    return 0;
+  size_t n = strlen(s) + 1;
+  if (n > SHM_STR_SIZE - *len) {
+    *full = 1;
+    return 0;
+  }
+  uint32_t off = *len;
+  memcpy(m->strs + off, s, n);
+  *len += (uint32_t)n;
+  return off;
+}
+
+void shm_publish(struct shm_publisher *p, const struct wayws_state *state) {
+  struct shm_snapshot *m = p->map;
+  uint64_t seq = atomic_load_explicit(&m->seq, memory_order_relaxed) | 1;
+  atomic_store_explicit(&m->seq, seq, memory_order_relaxed);
+  // Keeps the table writes below after the odd generation
+  atomic_thread_fence(memory_order_release);
+
+  int full = state->vlen > SHM_MAX_WS ||
+             state->output_names.len > SHM_MAX_OUTPUTS;
+  uint32_t len = 1;
+  m->strs[0] = '\0';
+  uint32_t nout = full ? 0 : state->output_names.len;
+  for (uint32_t i = 0; i < nout; i++)
+    m->outputs[i] = put_str(m, &len, state->output_names.strs[i], &full);
+  size_t n = full ? 0 : state->vlen;
+  for (size_t i = 0; i < n; i++) {
+    const struct ws *w = state->vec[i];
+    uint32_t out = 0;
+    if (w->group && w->group->outputs && w->group->outputs->output)
+      out = w->group->outputs->output->name_id;
+    m->ws[i] = (struct shm_ws){
+        .group = (uintptr_t)w->group,
+        .index = (uint32_t)w->index,
+        .flags = (w->active ? FILTER_ACTIVE : 0) |
+                 (w->urgent ? FILTER_URGENT : 0) |
+                 (w->hidden ? FILTER_HIDDEN : 0),
+        .output = out,
+        .name_off = put_str(m, &len, w->name, &full),
+        .id_off = put_str(m, &len, w->id, &full),
+        .x = w->x,
+        .y = w->y,
+    };
+  }
+  m->nws = full ? 0 : (uint32_t)n;
+  m->noutputs = full ? 0 : nout;
+  m->strs_len = len;
+  m->truncated = full;
+
+  atomic_store_explicit(&m->seq, seq + 1, memory_order_release);
+}
+
+void shm_publisher_close(struct shm_publisher *p) {
+  if (!p)
+    return;
+  // Unlinked before the lock goes, so no reader trusts a file we left
+  unlink(p->path);
+  munmap(p->map, sizeof *p->map);
+  close(p->fd);
+  free(p->path);
+  free(p);
+}
+
+// --- reader ------------------------------------------------------------------
+
+enum shm_read_result shm_read(const struct shm_snapshot *map,
+                              struct shm_snapshot *out) {
+  if (map->magic != SHM_MAGIC || map->version != SHM_VERSION)
+    return SHM_NONE;
+  for (int tries = 0; tries < SHM_READ_TRIES; tries++) {
+    if (tries)
+      sched_yield();
+    uint64_t seq = atomic_load_explicit(&map->seq, memory_order_acquire);
+    if (seq & 1)
+      continue;
+    // The counts may be torn too; only trust them once the generation
+    // checks out, but never copy past the table
+    uint32_t nws = map->nws, nout = map->noutputs, len = map->strs_len;
+    uint32_t truncated = map->truncated;
+    if (nws > SHM_MAX_WS || nout > SHM_MAX_OUTPUTS || len > SHM_STR_SIZE ||
+        len == 0)
+      continue;
+    memcpy(out->ws, map->ws, nws * sizeof *out->ws);
+    memcpy(out->outputs, map->outputs, nout * sizeof *out->outputs);
+    memcpy(out->strs, map->strs, len);
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&map->seq, memory_order_relaxed) != seq)
+      continue;
+    out->nws = nws;
+    out->noutputs = nout;
+    out->strs_len = len;
+    out->truncated = truncated;
+    out->strs[len - 1] = '\0';
+    return truncated ? SHM_TRUNCATED : SHM_OK;
+  }
+  return SHM_BUSY;
+}
+
+static const char *str_at(const struct shm_snapshot *s, uint32_t off) {
+  return off < s->strs_len ? s->strs + off : "";
+}
+
+static void snapshot_record(const struct shm_snapshot *s,
+                            const struct shm_ws *w, struct tpl_record *r) {
+  const char *mon = "(unknown)";
+  if (w->output && w->output <= s->noutputs)
+    mon = str_at(s, s->outputs[w->output - 1]);
+  *r = (struct tpl_record){
+      .name = str_at(s, w->name_off),
+      .id = str_at(s, w->id_off),
+      .output = mon,
+      .index = (long)w->index + 1,
+      .x = w->x,
+      .y = w->y,
+      .active = !!(w->flags & FILTER_ACTIVE),
+      .urgent = !!(w->flags & FILTER_URGENT),
+      .hidden = !!(w->flags & FILTER_HIDDEN),
+  };
+}
+
+static void print_formatted(const struct template *t,
+                            const struct shm_snapshot *s) {
+  struct outbuf b = {0};
+  struct tpl_record r;
+  for (uint32_t i = 0; i < s->nws; i++) {
+    snapshot_record(s, &s->ws[i], &r);
+    template_render(t, &b, &r);
+  }
+  fflush(stdout);
+  outbuf_flush(&b, STDOUT_FILENO);
+  outbuf_free(&b);
+}
+
+// Same output as run_command() for -l, --json and --format
+static void print_snapshot(struct wayws_state *state,
+                           const struct shm_snapshot *s) {
+  struct tpl_record r;
+  if (state->flag_list) {
+    if (state->opt_format) {
+      print_formatted(&state->format, s);
+    } else {
+      for (uint32_t i = 0; i < s->nws; i++) {
+        snapshot_record(s, &s->ws[i], &r);
+        print_list_record(&r);
+      }
+    }
+  }
+  if (state->flag_json) {
+    if (state->opt_format) {
+      if (!state->flag_list)
+        print_formatted(&state->format, s);
+      return;
+    }
+    struct outbuf b = {0};
+    outbuf_putc(&b, '[');
+    for (uint32_t i = 0; i < s->nws; i++) {
+      if (i)
+        outbuf_putc(&b, ',');
+      snapshot_record(s, &s->ws[i], &r);
+      json_put_workspace(&b, &r, (uintptr_t)s->ws[i].group);
+    }
+    outbuf_lit(&b, "]\n");
+    fflush(stdout);
+    outbuf_flush(&b, STDOUT_FILENO);
+    outbuf_free(&b);
+  }
+}
+
+static int no_snapshot(void) {
+  fputs("No workspace snapshot: run wayws --watch, --daemon or --serve "
+        "first.\n",
+        stderr);
+  return 1;
+}
+
+int shm_print(struct wayws_state *state, const char *path) {
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  struct stat st;
+  // The publisher holds an exclusive lock for as long as it runs; getting
+  // a shared one means the file is stale
+  if (fd >= 0 && flock(fd, LOCK_SH | LOCK_NB) == 0) {
+    close(fd);
+    fd = -1;
+  }
+  if (fd < 0 || fstat(fd, &st) != 0 ||
+      (size_t)st.st_size < sizeof(struct shm_snapshot)) {
+    if (fd >= 0)
+      close(fd);
+    return no_snapshot();
+  }
+  const struct shm_snapshot *map =
+      mmap(NULL, sizeof *map, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    fputs("Failed to map the workspace snapshot.\n", stderr);
+    return 1;
+  }
+
+  struct shm_snapshot *snap = xrealloc(NULL, sizeof *snap);
+  enum shm_read_result res = shm_read(map, snap);
+  munmap((void *)map, sizeof *map);
+  int ret = 1;
+  if (res == SHM_NONE)
+    no_snapshot();
+  else if (res == SHM_BUSY)
+    fputs("The workspace snapshot kept changing; try again.\n", stderr);
+  else if (res == SHM_TRUNCATED)
+    fputs("Too many workspaces or outputs for the snapshot.\n", stderr);
+  else if (snap->nws == 0)
+    fputs(state->flag_list ? "No workspaces found to list.\n"
+                           : "No workspaces found for JSON output.\n",
+          stderr);
+  else {
+    print_snapshot(state, snap);
+    ret = 0;
+  }
+  free(snap);
+  return ret;
+}
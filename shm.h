@@ -0,0 +1,71 @@
+#ifndef SHM_H
+#define SHM_H
+
+#include "types.h"
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// The model as a fixed-layout table in $XDG_RUNTIME_DIR (a tmpfs), kept up
+// to date by a running --watch, --daemon or --serve at the end of every
+// compositor batch. Readers (--from-shm) map it and copy it out under a
+// seqlock: no socket, no Wayland connection and no syscalls per read.
+//
+// The first publisher on a display takes an exclusive flock() on the file
+// and holds it for its lifetime; others do not publish. A file nobody holds
+// a lock on is stale.
+#define SHM_MAGIC 0x53535757u // "WWSS"
+#define SHM_VERSION 1
+#define SHM_MAX_WS 4096
+#define SHM_MAX_OUTPUTS 64
+#define SHM_STR_SIZE (256u << 10)
+
+struct shm_ws {
+  uint64_t group; // the publisher's group handle, 0 when unassigned
+  uint32_t index; // 0-based, as in wayws_state.vec
+  uint32_t flags; // FILTER_* state
+  uint32_t output; // interned output id (outputs[output - 1]), 0 = unknown
+  uint32_t name_off, id_off; // into strs, NUL-terminated
+  int32_t x, y;
+  uint32_t unused;
+};
+
+struct shm_snapshot {
+  uint32_t magic, version;
+  // Odd while the publisher is writing; readers retry until they see the
+  // same even value before and after their copy
+  _Atomic uint64_t seq;
+  uint32_t nws, noutputs, strs_len;
+  uint32_t truncated; // the model did not fit; readers refuse it
+  struct shm_ws ws[SHM_MAX_WS];
+  uint32_t outputs[SHM_MAX_OUTPUTS]; // name offsets by interned id - 1
+  char strs[SHM_STR_SIZE];
+};
+
+struct shm_publisher {
+  int fd;
+  struct shm_snapshot *map;
+  char *path;
+};
+
+int shm_path(char *buf, size_t len);
+// Returns NULL when there is nowhere to publish or another process already
+// does
+struct shm_publisher *shm_publisher_open(const char *path);
+void shm_publish(struct shm_publisher *p, const struct wayws_state *state);
+void shm_publisher_close(struct shm_publisher *p);
+
+enum shm_read_result {
+  SHM_OK,
+  SHM_NONE,      // no file, or nobody publishing to it
+  SHM_BUSY,      // never saw a stable generation
+  SHM_TRUNCATED, // the publisher's model did not fit
+};
+// Copies a consistent snapshot from map into out
+enum shm_read_result shm_read(const struct shm_snapshot *map,
+                              struct shm_snapshot *out);
+// --from-shm: prints -l, --json and --format from path's snapshot.
+// Returns the exit status.
+int shm_print(struct wayws_state *state, const char *path);
+
+#endif // SHM_H
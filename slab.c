@@ -0,0 +1,99 @@
+#include "slab.h"
+#include "util.h"
+#include <stdalign.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SLAB_CHUNK_SLOTS 64
+
+struct slab_slot {
+  uint32_t gen;
+  uint32_t next_free; // slot index + 1
+  uint32_t index;
+  uint32_t live;
+  alignas(max_align_t) unsigned char obj[];
+};
+
+static struct slab_slot *slot_at(const struct slab *s, uint32_t index) {
+  char *chunk = s->chunks[index / SLAB_CHUNK_SLOTS];
+  return (struct slab_slot *)(chunk + (index % SLAB_CHUNK_SLOTS) * s->slot_size);
+}
+
+static struct slab_slot *slot_of(const void *obj) {
+  return (struct slab_slot *)((char *)obj - offsetof(struct slab_slot, obj));
+}
+
+void slab_init(struct slab *s, size_t obj_size) {
+  memset(s, 0, sizeof *s);
+  s->obj_size = obj_size;
+  size_t align = alignof(max_align_t);
+  s->slot_size = sizeof(struct slab_slot) + (obj_size + align - 1) / align * align;
+}
+
+void *slab_alloc(struct slab *s) {
+  struct slab_slot *slot;
+  if (s->free_head) {
+    slot = slot_at(s, s->free_head - 1);
+    s->free_head = slot->next_free;
+  } else {
+    if (s->nslots == s->nchunks * SLAB_CHUNK_SLOTS) {
+      s->chunks = xrealloc(s->chunks, (s->nchunks + 1) * sizeof *s->chunks);
+      s->chunks[s->nchunks++] = xrealloc(NULL, SLAB_CHUNK_SLOTS * s->slot_size);
+    }
+    slot = slot_at(s, s->nslots);
+    slot->index = s->nslots++;
+    slot->gen = 1;
+  }
+  slot->live = 1;
+  slot->next_free = 0;
+  memset(slot->obj, 0, s->obj_size);
+  s->live++;
+  return slot->obj;
+}
+
+void slab_release(struct slab *s, void *obj) {
+  if (!obj)
+    return;
+  struct slab_slot *slot = slot_of(obj);
+  if (!slot->live)
+    return;
+  slot->live = 0;
+  if (++slot->gen == 0)
+    slot->gen = 1;
+  slot->next_free = s->free_head;
+  s->free_head = slot->index + 1;
+  s->live--;
+}
+
+slab_handle_t slab_handle(const struct slab *s, const void *obj) {
+  (void)s;
+  if (!obj)
+    return SLAB_NULL;
+  const struct slab_slot *slot = slot_of(obj);
+  return (slab_handle_t)slot->gen << 32 | slot->index;
+}
+
+void *slab_get(const struct slab *s, slab_handle_t h) {
+  uint32_t index = (uint32_t)h;
+  uint32_t gen = (uint32_t)(h >> 32);
+  if (h == SLAB_NULL || index >= s->nslots)
+    return NULL;
+  struct slab_slot *slot = slot_at(s, index);
+  return slot->live && slot->gen == gen ? slot->obj : NULL;
+}
+
+void slab_foreach(struct slab *s, void (*fn)(void *obj, void *data),
+                  void *data) {
+  for (uint32_t i = 0; i < s->nslots; i++) {
+    struct slab_slot *slot = slot_at(s, i);
+    if (slot->live)
+      fn(slot->obj, data);
+  }
+}
+
+void slab_destroy(struct slab *s) {
+  for (size_t i = 0; i < s->nchunks; i++)
+    free(s->chunks[i]);
+  free(s->chunks);
+  slab_init(s, s->obj_size);
+}
@@ -0,0 +1,34 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Fixed-size object allocator. Objects live in chunks that never move, freed
+// slots are recycled through a free list, and the whole slab is released in
+// one pass. Every slot carries a generation that is bumped on free, so a
+// handle (generation << 32 | slot index) taken earlier can tell whether it
+// still refers to the same object.
+typedef uint64_t slab_handle_t;
+#define SLAB_NULL ((slab_handle_t)0)
+
+struct slab {
+  size_t obj_size;
+  size_t slot_size;
+  void **chunks;
+  size_t nchunks;
+  uint32_t nslots;    // slots carved out of the chunks so far
+  uint32_t free_head; // slot index + 1, 0 when the free list is empty
+  size_t live;
+};
+
+void slab_init(struct slab *s, size_t obj_size);
+void *slab_alloc(struct slab *s);
+void slab_release(struct slab *s, void *obj);
+slab_handle_t slab_handle(const struct slab *s, const void *obj);
+void *slab_get(const struct slab *s, slab_handle_t h);
+void slab_foreach(struct slab *s, void (*fn)(void *obj, void *data),
+                  void *data);
+void slab_destroy(struct slab *s);
+
+#endif // SLAB_H
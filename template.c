@@ -0,0 +1,146 @@
+#include "template.h"
+#include "outbuf.h"
+#include "util.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const struct {
+  const char *name;
+  enum tpl_field field;
+} field_names[] = {
+    {"name", TPL_NAME},
+    {"id", TPL_ID},
+    {"index", TPL_INDEX},
+    {"output", TPL_OUTPUT},
+    {"x", TPL_X},
+    {"y", TPL_Y},
+    {"active", TPL_ACTIVE},
+    {"urgent", TPL_URGENT},
+    {"hidden", TPL_HIDDEN},
+    {"type", TPL_TYPE},
+    {"timestamp", TPL_TIMESTAMP},
+};
+
+static void push_op(struct template *t, enum tpl_field field, size_t off,
+                    size_t len) {
+  // Neighbouring literals become one span
+  if (field == TPL_LITERAL && t->nops &&
+      t->ops[t->nops - 1].field == TPL_LITERAL &&
+      t->ops[t->nops - 1].off + t->ops[t->nops - 1].len == off) {
+    t->ops[t->nops - 1].len += len;
+    return;
+  }
+  t->ops = xrealloc(t->ops, (t->nops + 1) * sizeof *t->ops);
+  t->ops[t->nops++] = (struct tpl_op){field, off, len};
+}
+
+int template_compile(struct template *t, const char *src) {
+  memset(t, 0, sizeof *t);
+  // Literal text never grows: escapes only shrink it
+  t->lits = xrealloc(NULL, strlen(src) + 1);
+  size_t nlits = 0;
+  for (const char *p = src; *p;) {
+    char c = *p;
+    if (c == '{' && p[1] != '{') {
+      const char *end = strchr(p + 1, '}');
+      if (!end)
+        goto fail;
+      size_t n = (size_t)(end - p - 1);
+      size_t i = 0;
+      while (i < sizeof field_names / sizeof field_names[0] &&
+             !(strlen(field_names[i].name) == n &&
+               strncmp(field_names[i].name, p + 1, n) == 0))
+        i++;
+      if (i == sizeof field_names / sizeof field_names[0])
+        goto fail;
+      push_op(t, field_names[i].field, 0, 0);
+      p = end + 1;
+      continue;
+    }
+    if (c == '}' && p[1] != '}')
+      goto fail;
+    if (c == '{' || c == '}') {
+      p += 2; // "{{" and "}}" stand for one brace
+    } else if (c == '\\' && p[1]) {
+      switch (p[1]) {
+      case 't':
+        c = '\t';
+        break;
+      case 'n':
+        c = '\n';
+        break;
+      case '\\':
+        c = '\\';
+        break;
+      default:
+        c = p[1];
+      }
+      p += 2;
+    } else {
+      p++;
+    }
+    t->lits[nlits] = c;
+    push_op(t, TPL_LITERAL, nlits++, 1);
+  }
+  return 0;
+fail:
+  template_free(t);
+  return -1;
+}
+
+static void put_str(struct outbuf *b, const char *s) {
+  if (s)
+    outbuf_puts(b, s);
+}
+
+void template_render(const struct template *t, struct outbuf *b,
+                     const struct tpl_record *r) {
+  for (size_t i = 0; i < t->nops; i++) {
+    const struct tpl_op *op = &t->ops[i];
+    switch (op->field) {
+    case TPL_LITERAL:
+      outbuf_put(b, t->lits + op->off, op->len);
+      break;
+    case TPL_NAME:
+      put_str(b, r->name);
+      break;
+    case TPL_ID:
+      put_str(b, r->id);
+      break;
+    case TPL_INDEX:
+      outbuf_put_int(b, r->index);
+      break;
+    case TPL_OUTPUT:
+      put_str(b, r->output);
+      break;
+    case TPL_X:
+      outbuf_put_int(b, r->x);
+      break;
+    case TPL_Y:
+      outbuf_put_int(b, r->y);
+      break;
+    case TPL_ACTIVE:
+      outbuf_put_bool(b, r->active);
+      break;
+    case TPL_URGENT:
+      outbuf_put_bool(b, r->urgent);
+      break;
+    case TPL_HIDDEN:
+      outbuf_put_bool(b, r->hidden);
+      break;
+    case TPL_TYPE:
+      put_str(b, r->type);
+      break;
+    case TPL_TIMESTAMP:
+      outbuf_put_uint(b, r->timestamp);
+      break;
+    }
+  }
+  outbuf_putc(b, '\n');
+}
+
+void template_free(struct template *t) {
+  free(t->ops);
+  free(t->lits);
+  memset(t, 0, sizeof *t);
+}
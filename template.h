@@ -0,0 +1,53 @@
+#ifndef TEMPLATE_H
+#define TEMPLATE_H
+
+#include "outbuf.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// --format templates: "{name}\t{output}" etc. A template is compiled once
+// into a list of literal spans and field references; rendering a record is
+// then a straight walk over that list.
+enum tpl_field {
+  TPL_NAME,
+  TPL_ID,
+  TPL_INDEX,
+  TPL_OUTPUT,
+  TPL_X,
+  TPL_Y,
+  TPL_ACTIVE,
+  TPL_URGENT,
+  TPL_HIDDEN,
+  TPL_TYPE,      // events only, "" for listings
+  TPL_TIMESTAMP, // events only, 0 for listings
+  TPL_LITERAL,   // not a field: copy lits[off, off + len)
+};
+
+struct tpl_op {
+  enum tpl_field field;
+  size_t off, len;
+};
+
+struct template {
+  struct tpl_op *ops;
+  size_t nops;
+  char *lits; // all literal text, back to back
+};
+
+// One workspace or event as seen by a template; NULL strings render as ""
+struct tpl_record {
+  const char *name, *id, *output, *type;
+  long index; // 1-based
+  int x, y;
+  int active, urgent, hidden;
+  uint64_t timestamp; // CLOCK_MONOTONIC, ns
+};
+
+// Returns 0, or -1 for an unknown field or an unbalanced brace
+int template_compile(struct template *t, const char *src);
+// Appends the rendered record followed by a newline
+void template_render(const struct template *t, struct outbuf *b,
+                     const struct tpl_record *r);
+void template_free(struct template *t);
+
+#endif // TEMPLATE_H
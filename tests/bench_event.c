@@ -0,0 +1,60 @@
+// Event serialization throughput.
+//
+// Feeds a synthetic event storm through emit_event() and reports events per
+// second, with names that need no escaping and names that do.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "../event.h"
+#include "../types.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#define NEVENTS 1000000
+
+static double now_s(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double bench(const char *name, const char *output) {
+  struct wayws_state s = {.event_enabled = 1};
+  double t = now_s();
+  for (int i = 0; i < NEVENTS; i++) {
+    emit_event(&s, EVENT_WORKSPACE_STATE, name, output, i % 10 + 1, i, 0,
+               i & 1, 0, 0, DIR_NONE, NULL);
+    // One batch per ten events, like a busy compositor
+    if (i % 10 == 9)
+      end_event_batch(&s);
+  }
+  end_event_batch(&s);
+  t = now_s() - t;
+  outbuf_free(&s.event_out);
+  return NEVENTS / t;
+}
+
+int main(void) {
+  // Measure serialization, not the terminal
+  fflush(stdout);
+  int saved = dup(STDOUT_FILENO);
+  int null = open("/dev/null", O_WRONLY);
+  if (saved < 0 || null < 0) {
+    perror("bench_event");
+    return 1;
+  }
+  dup2(null, STDOUT_FILENO);
+  double plain = bench("workspace-number-10", "DP-1");
+  double escaped = bench("say \"hi\"\tto\\me", "HDMI-A-1");
+  dup2(saved, STDOUT_FILENO);
+  close(null);
+  close(saved);
+
+  printf("%-24s %14s\n", "event names", "events/s");
+  printf("%-24s %14.0f\n", "plain", plain);
+  printf("%-24s %14.0f\n", "needs escaping", escaped);
+  return 0;
+}
@@ -0,0 +1,287 @@
+// Microbenchmarks for the workspace model hot paths.
+//
+// Builds synthetic wayws_state models of increasing size, spread over many
+// groups and outputs, and reports the cost per call. The rows are compared
+// against a stored baseline by how each function grows with the workspace
+// count rather than by absolute time, so a complexity regression shows up
+// on any machine:
+//
+//   bench_runner_model                    print the table
+//   bench_runner_model --save FILE        ... and store it as the baseline
+//   bench_runner_model --baseline FILE    ... and fail on a regression
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "../output.h"
+#include "../types.h"
+#include "../util.h"
+#include "../workspace.h"
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_OUTPUTS 8
+#define MAX_GROUPS 256
+// Growth beyond this factor over the baseline's is a regression
+#define GROWTH_SLACK 4.0
+
+static const size_t sizes[] = {10, 100, 1000, 10000, 100000};
+#define NSIZES (sizeof sizes / sizeof sizes[0])
+
+struct model {
+  struct wayws_state s;
+  struct ws *ws;
+  struct output outputs[MAX_OUTPUTS];
+  struct workspace_group groups[MAX_GROUPS];
+  size_t n, noutputs, ngroups;
+};
+
+// A group per 64 workspaces, spread round robin over up to 8 outputs; the
+// workspaces go round robin over the groups
+static void build_model(struct model *m, size_t n) {
+  memset(m, 0, sizeof *m);
+  model_init(&m->s);
+  m->n = n;
+  m->ngroups = n / 64 + 1 < MAX_GROUPS ? n / 64 + 1 : MAX_GROUPS;
+  m->noutputs = m->ngroups < MAX_OUTPUTS ? m->ngroups : MAX_OUTPUTS;
+  for (size_t o = 0; o < m->noutputs; o++) {
+    char name[16];
+    snprintf(name, sizeof name, "OUT-%zu", o + 1);
+    output_set_name(&m->s, &m->outputs[o], name);
+    m->outputs[o].next = o + 1 < m->noutputs ? &m->outputs[o + 1] : NULL;
+  }
+  m->s.all_outputs = &m->outputs[0];
+  for (size_t g = 0; g < m->ngroups; g++)
+    group_output_link(&m->s, &m->groups[g], &m->outputs[g % m->noutputs]);
+
+  m->ws = calloc(n, sizeof *m->ws);
+  m->s.vec = calloc(n, sizeof *m->s.vec);
+  m->s.vcap = n;
+  m->s.grid_cols = 3;
+  m->s.glyph_active = "●";
+  m->s.glyph_empty = "○";
+  for (size_t i = 0; i < n; i++) {
+    struct ws *w = &m->ws[i];
+    char name[32];
+    w->group = &m->groups[i % m->ngroups];
+    list_ws(&m->s, w);
+    group_add_ws(w->group, w);
+    snprintf(name, sizeof name, "ws-%zu", i + 1);
+    ws_set_name(&m->s, w, name);
+    snprintf(name, sizeof name, "id-%zu", i + 1);
+    ws_set_id(&m->s, w, name);
+  }
+  // One active workspace per group, the first one most recently activated
+  for (size_t g = 0; g < m->ngroups && g < n; g++) {
+    m->ws[g].active = 1;
+    m->ws[g].last_active_seq = m->ngroups - g;
+  }
+}
+
+static void free_model(struct model *m) {
+  // vec, the indexes, interned names and link nodes; the indexes go before
+  // the names they point to
+  model_destroy(&m->s);
+  for (size_t i = 0; i < m->n; i++) {
+    free(m->ws[i].name);
+    free(m->ws[i].id);
+  }
+  for (size_t g = 0; g < m->ngroups; g++)
+    free(m->groups[g].members);
+  for (size_t o = 0; o < m->noutputs; o++) {
+    free(m->outputs[o].name);
+    free(m->outputs[o].groups);
+  }
+  free(m->ws);
+}
+
+static double now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static volatile size_t sink;
+
+static void call_group_size(struct model *m, size_t i) {
+  sink += group_size(&m->s, &m->groups[i % m->ngroups]);
+}
+
+static void call_current_ws(struct model *m, size_t i) {
+  (void)i;
+  sink += (size_t)current_ws(&m->s, NULL);
+}
+
+// current_ws() restricted to one output, as with --output
+static void call_current_ws_output(struct model *m, size_t i) {
+  m->s.opt_output_name = m->outputs[i % m->noutputs].name;
+  sink += (size_t)current_ws(&m->s, NULL);
+  m->s.opt_output_name = NULL;
+}
+
+static void call_neighbor(struct model *m, size_t i) {
+  sink += (size_t)neighbor(&m->s, i & 1 ? DIR_RIGHT : DIR_DOWN);
+}
+
+// By name, the most common switch command
+static void call_find_target(struct model *m, size_t i) {
+  m->s.want_name = m->ws[i % m->s.vlen].name;
+  sink += (size_t)find_target_workspace(&m->s);
+  m->s.want_name = NULL;
+}
+
+static void call_waybar(struct model *m, size_t i) {
+  m->s.opt_output_name = m->outputs[i % m->noutputs].name;
+  sink += (size_t)print_waybar_output(&m->s);
+  m->s.opt_output_name = NULL;
+}
+
+static void call_json(struct model *m, size_t i) {
+  (void)i;
+  print_json_output(&m->s);
+}
+
+static const struct {
+  const char *name;
+  void (*fn)(struct model *m, size_t i);
+} benches[] = {
+    {"group_size", call_group_size},
+    {"current_ws", call_current_ws},
+    {"current_ws_out", call_current_ws_output},
+    {"neighbor", call_neighbor},
+    {"find_target", call_find_target},
+    {"waybar", call_waybar},
+    {"json", call_json},
+};
+#define NBENCHES (sizeof benches / sizeof benches[0])
+
+// ns per call, running batches of doubling size for at least 20 ms
+static double bench(struct model *m, size_t b) {
+  size_t iters = 0;
+  double t = now_ns(), elapsed;
+  for (size_t batch = 1;; batch *= 2) {
+    for (size_t i = 0; i < batch; i++)
+      benches[b].fn(m, iters + i);
+    iters += batch;
+    elapsed = now_ns() - t;
+    if (elapsed >= 20e6)
+      break;
+  }
+  return elapsed / iters;
+}
+
+// Baseline file: one "function workspaces ns" line per cell, # comments
+static int load_baseline(const char *path, double base[NBENCHES][NSIZES]) {
+  FILE *f = fopen(path, "r");
+  if (!f)
+    return -1;
+  char line[256], name[64];
+  size_t n;
+  double ns;
+  while (fgets(line, sizeof line, f)) {
+    if (line[0] == '#' || sscanf(line, "%63s %zu %lf", name, &n, &ns) != 3)
+      continue;
+    for (size_t b = 0; b < NBENCHES; b++)
+      for (size_t k = 0; k < NSIZES; k++)
+        if (strcmp(name, benches[b].name) == 0 && sizes[k] == n)
+          base[b][k] = ns;
+  }
+  fclose(f);
+  return 0;
+}
+
+static int save_baseline(const char *path, double res[NBENCHES][NSIZES]) {
+  FILE *f = fopen(path, "w");
+  if (!f)
+    return -1;
+  fputs("# bench_runner_model baseline: function workspaces ns/call\n"
+        "# Regenerate with: make bench-baseline\n",
+        f);
+  for (size_t b = 0; b < NBENCHES; b++)
+    for (size_t k = 0; k < NSIZES; k++)
+      fprintf(f, "%s %zu %.1f\n", benches[b].name, sizes[k], res[b][k]);
+  return fclose(f);
+}
+
+// Slope of log(time) over log(workspaces) between the smallest and largest
+// model: ~0 for constant time, ~1 for linear, ~2 for quadratic
+static double exponent(const double row[NSIZES]) {
+  return log(row[NSIZES - 1] / row[0]) /
+         log((double)sizes[NSIZES - 1] / (double)sizes[0]);
+}
+
+int main(int argc, char **argv) {
+  const char *save = NULL, *baseline = NULL;
+  if (argc == 3 && strcmp(argv[1], "--save") == 0)
+    save = argv[2];
+  else if (argc == 3 && strcmp(argv[1], "--baseline") == 0)
+    baseline = argv[2];
+  else if (argc != 1) {
+    fprintf(stderr, "Usage: %s [--save FILE | --baseline FILE]\n", argv[0]);
+    return 1;
+  }
+
+  // The output functions print; keep their text out of the report
+  FILE *out = fdopen(dup(STDOUT_FILENO), "w");
+  int devnull = open("/dev/null", O_WRONLY);
+  if (!out || devnull < 0 || dup2(devnull, STDOUT_FILENO) < 0) {
+    perror("bench_runner_model");
+    return 1;
+  }
+  close(devnull);
+
+  static double res[NBENCHES][NSIZES], base[NBENCHES][NSIZES];
+  fprintf(out, "%-10s", "workspaces");
+  for (size_t b = 0; b < NBENCHES; b++)
+    fprintf(out, " %14s", benches[b].name);
+  fprintf(out, "   (ns/call)\n");
+  for (size_t k = 0; k < NSIZES; k++) {
+    struct model m;
+    build_model(&m, sizes[k]);
+    fprintf(out, "%-10zu", sizes[k]);
+    for (size_t b = 0; b < NBENCHES; b++) {
+      res[b][k] = bench(&m, b);
+      fprintf(out, " %14.1f", res[b][k]);
+      fflush(out);
+    }
+    fprintf(out, "\n");
+    free_model(&m);
+  }
+
+  int ret = 0;
+  if (baseline && load_baseline(baseline, base) != 0) {
+    fprintf(stderr, "bench_runner_model: cannot read %s\n", baseline);
+    ret = 1;
+  }
+  fprintf(out, "\n%-16s %10s %10s\n", "growth", "exponent", "baseline");
+  for (size_t b = 0; b < NBENCHES; b++) {
+    fprintf(out, "%-16s %10.2f", benches[b].name, exponent(res[b]));
+    if (!baseline || base[b][0] <= 0 || base[b][NSIZES - 1] <= 0) {
+      fprintf(out, "\n");
+      continue;
+    }
+    fprintf(out, " %10.2f", exponent(base[b]));
+    // Compare each size's cost relative to the smallest model
+    for (size_t k = 1; k < NSIZES; k++) {
+      double growth = res[b][k] / res[b][0];
+      double was = base[b][k] / base[b][0];
+      if (growth > GROWTH_SLACK * was) {
+        fprintf(out, "  REGRESSION at %zu: x%.0f vs x%.0f", sizes[k], growth,
+                was);
+        ret = 1;
+        break;
+      }
+    }
+    fprintf(out, "\n");
+  }
+  if (save && save_baseline(save, res) != 0) {
+    fprintf(stderr, "bench_runner_model: cannot write %s\n", save);
+    ret = 1;
+  }
+  fclose(out);
+  return ret;
+}
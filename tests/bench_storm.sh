@@ -0,0 +1,156 @@
+#!/bin/bash
+
+# Event-storm throughput of the watch loop
+# Runs `wayws -w --latency --stats` against tests/mock_compositor.c while the mock
+# churns workspaces (create, state, name, coordinates, remove) at increasing
+# rates, once per kind of stdout reader:
+#   fast     reads as fast as it can
+#   slow     takes about 1 ms per line
+#   blocked  reads nothing until the storm is over
+# and reports per run:
+#   sent      changes the mock made (each one is one event in wayws)
+#   printed   storm events wayws wrote, and per second of storm
+#   cpu/ev    wayws user+system CPU time per printed event
+#   rss       peak RSS of wayws
+#   stall     longest gap between two dispatched storm events, i.e. the
+#             longest time the watch loop was not dispatching
+#   hold      largest latency_ns: read from the socket to queued for stdout,
+#             including any time held back while the queue was backed up
+#   queue     high-water mark of the output queue (--stats), in kB
+#   dropped   lines the output queue had no room for (--stats)
+#   merged    events replaced by a newer one while the queue was backed up
+#             (--stats), which is why printed can fall short of sent
+#   lost      clients the mock dropped because their buffer overflowed
+# STORM_RATES, STORM_MS and STORM_CONSUMERS override the defaults.
+
+GREEN='\033[0;32m'
+RED='\033[0;31m'
+NC='\033[0m' # No Color
+
+RATES="${STORM_RATES:-1000 10000 50000 200000}"
+STORM_MS="${STORM_MS:-2000}"
+CONSUMERS="${STORM_CONSUMERS:-fast slow blocked}"
+
+for bin in ./wayws ./mock_compositor; do
+    if [ ! -x "$bin" ]; then
+        echo -e "${RED}Error: $bin not found. Run 'make wayws mock_compositor' first.${NC}"
+        exit 1
+    fi
+done
+
+BENCH_RUNTIME=$(mktemp -d)
+export XDG_RUNTIME_DIR="$BENCH_RUNTIME"
+export WAYLAND_DISPLAY=wayws-bench
+CLK_TCK=$(getconf CLK_TCK)
+MOCK_PID=
+
+cleanup() {
+    [ -n "$MOCK_PID" ] && kill "$MOCK_PID" 2>/dev/null
+    rm -rf "$BENCH_RUNTIME"
+}
+trap cleanup EXIT
+
+# tally: reads wayws JSON events, prints "printed max_gap_ns max_latency_ns"
+# for the storm's events (the initial state is not counted)
+tally() {
+    awk '
+        !/"name":"storm-/ { next }
+        {
+            n++
+            if (match($0, /"timestamp":[0-9]+/)) {
+                t = substr($0, RSTART + 12, RLENGTH - 12) + 0
+                if (prev && t - prev > gap) gap = t - prev
+                prev = t
+            }
+            if (match($0, /"latency_ns":[0-9]+/)) {
+                l = substr($0, RSTART + 13, RLENGTH - 13) + 0
+                if (l > hold) hold = l
+            }
+        }
+        END { printf "%d %d %d\n", n, gap, hold }'
+}
+
+# consume KIND: one of the stdout readers, tallying what it read
+consume() {
+    case "$1" in
+    fast)
+        tally
+        ;;
+    slow)
+        # read -t on a pipe nobody writes is a sleep without a fork
+        local tick
+        exec {tick}<> <(:)
+        while IFS= read -r line; do
+            printf '%s\n' "$line"
+            read -t 0.001 -u "$tick"
+        done | tally
+        ;;
+    blocked)
+        sleep "$(awk -v ms="$STORM_MS" 'BEGIN { print ms / 1000 + 0.5 }')"
+        tally
+        ;;
+    esac
+}
+
+# run KIND RATE: one storm, prints a result row
+run() {
+    local kind="$1" rate="$2"
+    local fifo="$BENCH_RUNTIME/out" result="$BENCH_RUNTIME/result"
+    local mock_out="$BENCH_RUNTIME/mock"
+    printf 'wait-client\nsleep 100\nstorm %s %s\nsleep 300\nquit\n' \
+        "$rate" "$STORM_MS" >"$BENCH_RUNTIME/script"
+    ./mock_compositor --socket "$WAYLAND_DISPLAY" --script "$BENCH_RUNTIME/script" \
+        >"$mock_out" &
+    MOCK_PID=$!
+    for ((i = 0; i < 100; i++)); do
+        [ -S "$XDG_RUNTIME_DIR/$WAYLAND_DISPLAY" ] && break
+        sleep 0.02
+    done
+
+    rm -f "$fifo"
+    mkfifo "$fifo"
+    consume "$kind" <"$fifo" >"$result" &
+    local consumer=$!
+    ./wayws -w --latency --stats >"$fifo" 2>"$BENCH_RUNTIME/stats" &
+    local pid=$!
+
+    # Sample CPU time and peak RSS until wayws exits (or is a zombie)
+    local ticks=0 rss=0 stat
+    while read -r -a stat 2>/dev/null <"/proc/$pid/stat" && [ "${stat[2]}" != Z ]; do
+        ticks=$((stat[13] + stat[14]))
+        rss=$(awk '/^VmHWM/ { print $2 }' "/proc/$pid/status" 2>/dev/null || echo "$rss")
+        sleep 0.05
+    done
+    wait "$pid" "$consumer" "$MOCK_PID" 2>/dev/null
+    MOCK_PID=
+
+    local sent lost printed gap hold hwm dropped merged
+    read -r sent lost < <(awk '/^storm/ { print $5, $11 }' "$mock_out")
+    read -r printed gap hold <"$result"
+    # "wayws: output queue C bytes, depth D, high-water H, dropped N lines,
+    #  coalesced M events"
+    read -r hwm dropped merged < <(awk '/output queue/ { print $9 + 0, $11 + 0, $14 + 0 }' \
+        "$BENCH_RUNTIME/stats")
+    awk -v kind="$kind" -v rate="$rate" -v sent="${sent:-0}" -v lost="${lost:-?}" \
+        -v printed="${printed:-0}" -v gap="${gap:-0}" -v hold="${hold:-0}" \
+        -v ticks="$ticks" -v tck="$CLK_TCK" -v rss="${rss:-0}" -v ms="$STORM_MS" \
+        -v hwm="${hwm:-0}" -v dropped="${dropped:-0}" -v merged="${merged:-0}" '
+        BEGIN {
+            cpu = printed ? ticks / tck * 1e6 / printed : 0
+            printf "%-8s %8d %8d %8d %9.0f %9.2f %7d %9.1f %9.1f %8d %8d %8d %5s\n",
+                kind, rate, sent, printed, printed / (ms / 1000), cpu, rss,
+                gap / 1e6, hold / 1e6, hwm / 1024, dropped, merged, lost
+        }'
+}
+
+echo "Event storm: ${STORM_MS} ms per run, workspace churn against the mock compositor"
+echo "=================================="
+printf "%-8s %8s %8s %8s %9s %9s %7s %9s %9s %8s %8s %8s %5s\n" \
+    consumer rate/s sent printed printed/s "cpu us/ev" "rss kB" "stall ms" "hold ms" \
+    "queue kB" dropped merged lost
+for kind in $CONSUMERS; do
+    for rate in $RATES; do
+        run "$kind" "$rate"
+    done
+done
+echo -e "${GREEN}Event storm benchmark done.${NC}"
@@ -0,0 +1,908 @@
+// A minimal ext-workspace-v1 compositor for headless tests and benchmarks.
+//
+// It serves wl_output and ext_workspace_manager_v1 on a Wayland socket with
+// a fixed topology: N outputs, each with one workspace group holding M
+// workspaces (named "1", "2", ... in creation order; the first of each group
+// starts active). Client activations are applied on commit, optionally after
+// --delay MS. A line-based script (--script FILE, or - for stdin) drives
+// compositor-side changes:
+//
+//   wait-client          pause until a client has bound the manager
+//   sleep MS             pause the script
+//   activate I           activate workspace I (1-based, creation order)
+//   urgent I 0|1         set or clear the urgent / hidden state
+//   hidden I 0|1
+//   rename I NAME
+//   add O NAME           create a workspace in output O's group
+//   remove I
+//   unplug O             take output O away
+//   unplug-late O        the same, but output_leave follows global_remove
+//   burst N [PER_DONE]   N activations round robin, a done every PER_DONE
+//   storm RATE MS        workspace churn at RATE changes per second for MS
+//   quit
+//
+// Every change is followed by a manager done event unless noted. A storm
+// cycles one workspace at a time through create, state, name, coordinates
+// and remove, with a done every millisecond tick, and prints a summary line
+// on stdout when it ends. The socket name is printed on stdout once the
+// compositor is listening.
+
+#define _GNU_SOURCE
+
+#include "ext_workspace_server.h"
+#include <getopt.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <wayland-server.h>
+
+struct mock_output {
+  struct wl_global *global;
+  char name[16];
+  uint32_t ncols; // next free column of the group
+  struct wl_list resources; // bound wl_output resources
+};
+
+struct mock_ws {
+  char name[64];
+  char id[16];
+  int group;      // == output index, -1 once removed
+  uint32_t state; // EXT_WORKSPACE_HANDLE_V1_STATE_* bits
+  uint32_t col;   // coordinates within the group, as a single row
+};
+
+// One client's manager object, and the group and workspace resources
+// created for it. Slots are NULL until announced or after the client
+// destroyed them.
+struct binding {
+  struct wl_resource *mgr;
+  struct wl_resource **groups; // per output
+  struct wl_resource **ws;     // per workspace
+  size_t nws;
+  int *pending; // workspaces activated since the last commit
+  size_t npending;
+  struct wl_list link;
+};
+
+// User data of group and workspace resources. Cleared when the binding goes
+// away first, which happens when a client disconnects.
+struct ref {
+  struct binding *b;
+  size_t idx;
+};
+
+struct commit {
+  int *ws;
+  size_t n;
+  struct wl_event_source *timer;
+  struct wl_list link;
+};
+
+static struct {
+  struct wl_display *dpy;
+  struct wl_event_loop *loop;
+  struct mock_output *outputs;
+  int noutputs;
+  struct mock_ws *ws;
+  size_t nws, wscap;
+  struct wl_list bindings;
+  struct wl_list commits; // waiting for --delay
+  int delay_ms;
+  size_t burst_next;
+
+  // Running storm: changes owed are rate * elapsed - sent
+  struct {
+    struct wl_event_source *timer;
+    long rate;
+    uint64_t start_ns, end_ns;
+    unsigned long sent;
+    unsigned long lost; // clients disconnected while it ran
+    size_t cur;         // workspace being cycled
+    int step;
+  } storm;
+
+  // Script input not run yet, and why it is paused
+  char *script;
+  size_t slen, scap;
+  int script_eof;
+  int paused;
+  int wait_client;
+  struct wl_event_source *script_timer;
+  struct wl_event_source *stdin_src;
+} m;
+
+static void *xalloc(void *p, size_t n) {
+  p = realloc(p, n);
+  if (!p) {
+    perror("mock_compositor");
+    exit(1);
+  }
+  return p;
+}
+
+static void done_all(void) {
+  struct binding *b;
+  wl_list_for_each(b, &m.bindings, link) ext_workspace_manager_v1_send_done(b->mgr);
+  // Flushed per batch, so long bursts never pile up in one client buffer
+  wl_display_flush_clients(m.dpy);
+}
+
+static void send_state(size_t i) {
+  struct binding *b;
+  wl_list_for_each(b, &m.bindings, link) {
+    if (i < b->nws && b->ws[i])
+      ext_workspace_handle_v1_send_state(b->ws[i], m.ws[i].state);
+  }
+}
+
+static void send_coords(struct wl_resource *r, const struct mock_ws *w) {
+  struct wl_array coords;
+  wl_array_init(&coords);
+  uint32_t *xy = wl_array_add(&coords, 2 * sizeof *xy);
+  if (xy) {
+    xy[0] = w->col;
+    xy[1] = 0;
+    ext_workspace_handle_v1_send_coordinates(r, &coords);
+  }
+  wl_array_release(&coords);
+}
+
+static struct ref *new_ref(struct binding *b, size_t idx) {
+  struct ref *ref = xalloc(NULL, sizeof *ref);
+  ref->b = b;
+  ref->idx = idx;
+  return ref;
+}
+
+static void detach(struct wl_resource *r) {
+  free(wl_resource_get_user_data(r));
+  wl_resource_set_user_data(r, NULL);
+}
+
+// --- workspace handles -----------------------------------------------------
+
+static void ws_resource_destroy(struct wl_resource *r) {
+  struct ref *ref = wl_resource_get_user_data(r);
+  if (!ref)
+    return;
+  ref->b->ws[ref->idx] = NULL;
+  free(ref);
+}
+
+static void ws_destroy(struct wl_client *c, struct wl_resource *r) {
+  (void)c;
+  wl_resource_destroy(r);
+}
+
+static void ws_activate(struct wl_client *c, struct wl_resource *r) {
+  (void)c;
+  struct ref *ref = wl_resource_get_user_data(r);
+  if (!ref)
+    return;
+  struct binding *b = ref->b;
+  b->pending = xalloc(b->pending, (b->npending + 1) * sizeof *b->pending);
+  b->pending[b->npending++] = (int)ref->idx;
+}
+
+static void ws_ignore(struct wl_client *c, struct wl_resource *r) {
+  (void)c;
+  (void)r;
+}
+
+static void ws_assign(struct wl_client *c, struct wl_resource *r,
+                      struct wl_resource *group) {
+  (void)c;
+  (void)r;
+  (void)group;
+}
+
+static void remove_ws(size_t i);
+
+static void ws_remove(struct wl_client *c, struct wl_resource *r) {
+  (void)c;
+  struct ref *ref = wl_resource_get_user_data(r);
+  if (ref && m.ws[ref->idx].group >= 0) {
+    remove_ws(ref->idx);
+    done_all();
+  }
+}
+
+static const struct ext_workspace_handle_v1_interface ws_impl = {
+    .destroy = ws_destroy,
+    .activate = ws_activate,
+    .deactivate = ws_ignore,
+    .assign = ws_assign,
+    .remove = ws_remove,
+};
+
+static void announce_ws(struct binding *b, size_t i) {
+  struct wl_client *c = wl_resource_get_client(b->mgr);
+  struct wl_resource *r =
+      wl_resource_create(c, &ext_workspace_handle_v1_interface,
+                         wl_resource_get_version(b->mgr), 0);
+  if (!r) {
+    wl_client_post_no_memory(c);
+    return;
+  }
+  wl_resource_set_implementation(r, &ws_impl, new_ref(b, i), ws_resource_destroy);
+  if (i >= b->nws) {
+    b->ws = xalloc(b->ws, (i + 1) * sizeof *b->ws);
+    memset(b->ws + b->nws, 0, (i + 1 - b->nws) * sizeof *b->ws);
+    b->nws = i + 1;
+  }
+  b->ws[i] = r;
+
+  const struct mock_ws *w = &m.ws[i];
+  ext_workspace_manager_v1_send_workspace(b->mgr, r);
+  ext_workspace_handle_v1_send_id(r, w->id);
+  ext_workspace_handle_v1_send_name(r, w->name);
+  send_coords(r, w);
+  ext_workspace_handle_v1_send_capabilities(
+      r, EXT_WORKSPACE_HANDLE_V1_WORKSPACE_CAPABILITIES_ACTIVATE |
+             EXT_WORKSPACE_HANDLE_V1_WORKSPACE_CAPABILITIES_REMOVE);
+  ext_workspace_handle_v1_send_state(r, w->state);
+  if (b->groups[w->group])
+    ext_workspace_group_handle_v1_send_workspace_enter(b->groups[w->group], r);
+}
+
+// --- workspace groups ------------------------------------------------------
+
+static void group_resource_destroy(struct wl_resource *r) {
+  struct ref *ref = wl_resource_get_user_data(r);
+  if (!ref)
+    return;
+  ref->b->groups[ref->idx] = NULL;
+  free(ref);
+}
+
+static size_t add_ws(int group, const char *name);
+
+static void group_create_workspace(struct wl_client *c, struct wl_resource *r,
+                                   const char *name) {
+  (void)c;
+  struct ref *ref = wl_resource_get_user_data(r);
+  if (!ref)
+    return;
+  add_ws((int)ref->idx, name);
+  done_all();
+}
+
+static void group_destroy(struct wl_client *c, struct wl_resource *r) {
+  (void)c;
+  wl_resource_destroy(r);
+}
+
+static const struct ext_workspace_group_handle_v1_interface group_impl = {
+    .create_workspace = group_create_workspace,
+    .destroy = group_destroy,
+};
+
+static void group_output_enter(struct wl_resource *group, int o) {
+  struct wl_client *c = wl_resource_get_client(group);
+  struct wl_resource *out;
+  wl_resource_for_each(out, &m.outputs[o].resources) {
+    if (wl_resource_get_client(out) == c)
+      ext_workspace_group_handle_v1_send_output_enter(group, out);
+  }
+}
+
+static void announce_group(struct binding *b, int o) {
+  struct wl_client *c = wl_resource_get_client(b->mgr);
+  struct wl_resource *r =
+      wl_resource_create(c, &ext_workspace_group_handle_v1_interface,
+                         wl_resource_get_version(b->mgr), 0);
+  if (!r) {
+    wl_client_post_no_memory(c);
+    return;
+  }
+  wl_resource_set_implementation(r, &group_impl, new_ref(b, (size_t)o),
+                                 group_resource_destroy);
+  b->groups[o] = r;
+  ext_workspace_manager_v1_send_workspace_group(b->mgr, r);
+  ext_workspace_group_handle_v1_send_capabilities(
+      r, EXT_WORKSPACE_GROUP_HANDLE_V1_GROUP_CAPABILITIES_CREATE_WORKSPACE);
+  group_output_enter(r, o);
+}
+
+// --- manager ---------------------------------------------------------------
+
+static void apply_activation(size_t i) {
+  if (i >= m.nws || m.ws[i].group < 0 ||
+      (m.ws[i].state & EXT_WORKSPACE_HANDLE_V1_STATE_ACTIVE))
+    return;
+  // One active workspace per group
+  for (size_t k = 0; k < m.nws; k++) {
+    if (m.ws[k].group == m.ws[i].group &&
+        (m.ws[k].state & EXT_WORKSPACE_HANDLE_V1_STATE_ACTIVE)) {
+      m.ws[k].state &= ~(uint32_t)EXT_WORKSPACE_HANDLE_V1_STATE_ACTIVE;
+      send_state(k);
+    }
+  }
+  m.ws[i].state |= EXT_WORKSPACE_HANDLE_V1_STATE_ACTIVE;
+  send_state(i);
+}
+
+static int commit_fire(void *data) {
+  struct commit *c = data;
+  for (size_t i = 0; i < c->n; i++)
+    apply_activation((size_t)c->ws[i]);
+  done_all();
+  wl_event_source_remove(c->timer);
+  wl_list_remove(&c->link);
+  free(c->ws);
+  free(c);
+  return 0;
+}
+
+static void mgr_commit(struct wl_client *client, struct wl_resource *r) {
+  (void)client;
+  struct binding *b = wl_resource_get_user_data(r);
+  if (!b->npending)
+    return;
+  if (!m.delay_ms) {
+    for (size_t i = 0; i < b->npending; i++)
+      apply_activation((size_t)b->pending[i]);
+    b->npending = 0;
+    done_all();
+    return;
+  }
+  // Held back like a compositor busy with an animation
+  struct commit *c = xalloc(NULL, sizeof *c);
+  c->ws = b->pending;
+  c->n = b->npending;
+  b->pending = NULL;
+  b->npending = 0;
+  c->timer = wl_event_loop_add_timer(m.loop, commit_fire, c);
+  wl_event_source_timer_update(c->timer, m.delay_ms);
+  wl_list_insert(m.commits.prev, &c->link);
+}
+
+static void mgr_stop(struct wl_client *client, struct wl_resource *r) {
+  (void)client;
+  ext_workspace_manager_v1_send_finished(r);
+  wl_resource_destroy(r);
+}
+
+static const struct ext_workspace_manager_v1_interface mgr_impl = {
+    .commit = mgr_commit,
+    .stop = mgr_stop,
+};
+
+static void run_script(void);
+
+static void resume_script(void *data) {
+  (void)data;
+  m.paused = 0;
+  run_script();
+}
+
+static void mgr_resource_destroy(struct wl_resource *r) {
+  struct binding *b = wl_resource_get_user_data(r);
+  // Usually a client too slow to keep up: libwayland-server drops clients
+  // whose buffer overflows
+  if (m.storm.rate)
+    m.storm.lost++;
+  for (int o = 0; o < m.noutputs; o++)
+    if (b->groups[o])
+      detach(b->groups[o]);
+  for (size_t i = 0; i < b->nws; i++)
+    if (b->ws[i])
+      detach(b->ws[i]);
+  wl_list_remove(&b->link);
+  free(b->groups);
+  free(b->ws);
+  free(b->pending);
+  free(b);
+}
+
+static void mgr_bind(struct wl_client *c, void *data, uint32_t version,
+                     uint32_t id) {
+  (void)data;
+  struct wl_resource *r =
+      wl_resource_create(c, &ext_workspace_manager_v1_interface, (int)version, id);
+  if (!r) {
+    wl_client_post_no_memory(c);
+    return;
+  }
+  struct binding *b = xalloc(NULL, sizeof *b);
+  memset(b, 0, sizeof *b);
+  b->mgr = r;
+  b->groups = xalloc(NULL, (size_t)m.noutputs * sizeof *b->groups);
+  memset(b->groups, 0, (size_t)m.noutputs * sizeof *b->groups);
+  wl_resource_set_implementation(r, &mgr_impl, b, mgr_resource_destroy);
+  wl_list_insert(m.bindings.prev, &b->link);
+
+  for (int o = 0; o < m.noutputs; o++)
+    if (m.outputs[o].global)
+      announce_group(b, o);
+  for (size_t i = 0; i < m.nws; i++)
+    if (m.ws[i].group >= 0)
+      announce_ws(b, i);
+  ext_workspace_manager_v1_send_done(r);
+
+  if (m.wait_client) {
+    m.wait_client = 0;
+    wl_event_loop_add_idle(m.loop, resume_script, NULL);
+  }
+}
+
+// --- outputs ---------------------------------------------------------------
+
+static void output_release(struct wl_client *c, struct wl_resource *r) {
+  (void)c;
+  wl_resource_destroy(r);
+}
+
+static const struct wl_output_interface output_impl = {
+    .release = output_release,
+};
+
+static void output_resource_destroy(struct wl_resource *r) {
+  wl_list_remove(wl_resource_get_link(r));
+}
+
+static void output_bind(struct wl_client *c, void *data, uint32_t version,
+                        uint32_t id) {
+  struct mock_output *out = data;
+  int o = (int)(out - m.outputs);
+  struct wl_resource *r =
+      wl_resource_create(c, &wl_output_interface, (int)version, id);
+  if (!r) {
+    wl_client_post_no_memory(c);
+    return;
+  }
+  wl_resource_set_implementation(r, &output_impl, out, output_resource_destroy);
+  wl_list_insert(&out->resources, wl_resource_get_link(r));
+
+  wl_output_send_geometry(r, o * 1920, 0, 600, 340, WL_OUTPUT_SUBPIXEL_UNKNOWN,
+                          "wayws", "mock", WL_OUTPUT_TRANSFORM_NORMAL);
+  wl_output_send_mode(r, WL_OUTPUT_MODE_CURRENT, 1920, 1080, 60000);
+  if (version >= WL_OUTPUT_NAME_SINCE_VERSION)
+    wl_output_send_name(r, out->name);
+  if (version >= WL_OUTPUT_DONE_SINCE_VERSION)
+    wl_output_send_done(r);
+
+  // Groups this client already knows about sit on the new output
+  struct binding *b;
+  wl_list_for_each(b, &m.bindings, link) {
+    if (wl_resource_get_client(b->mgr) == c && b->groups[o]) {
+      ext_workspace_group_handle_v1_send_output_enter(b->groups[o], r);
+      ext_workspace_manager_v1_send_done(b->mgr);
+    }
+  }
+}
+
+// late: the global goes first, so clients get output_leave for a wl_output
+// they have already destroyed
+static void unplug(int o, int late) {
+  if (!m.outputs[o].global)
+    return;
+  if (late) {
+    wl_global_destroy(m.outputs[o].global);
+    m.outputs[o].global = NULL;
+  }
+  struct binding *b;
+  wl_list_for_each(b, &m.bindings, link) {
+    struct wl_resource *g = b->groups[o], *out;
+    if (!g)
+      continue;
+    wl_resource_for_each(out, &m.outputs[o].resources) {
+      if (wl_resource_get_client(out) == wl_resource_get_client(g))
+        ext_workspace_group_handle_v1_send_output_leave(g, out);
+    }
+  }
+  done_all();
+  if (!late) {
+    wl_global_destroy(m.outputs[o].global);
+    m.outputs[o].global = NULL;
+  }
+}
+
+// --- model changes -----------------------------------------------------------
+
+static size_t add_ws(int group, const char *name) {
+  if (m.nws == m.wscap) {
+    m.wscap = m.wscap ? 2 * m.wscap : 16;
+    m.ws = xalloc(m.ws, m.wscap * sizeof *m.ws);
+  }
+  size_t i = m.nws++;
+  struct mock_ws *w = &m.ws[i];
+  memset(w, 0, sizeof *w);
+  snprintf(w->name, sizeof w->name, "%s", name);
+  snprintf(w->id, sizeof w->id, "mock-%zu", i + 1);
+  w->group = group;
+  w->col = m.outputs[group].ncols++;
+  struct binding *b;
+  wl_list_for_each(b, &m.bindings, link) announce_ws(b, i);
+  return i;
+}
+
+static void remove_ws(size_t i) {
+  int g = m.ws[i].group;
+  struct binding *b;
+  wl_list_for_each(b, &m.bindings, link) {
+    if (i >= b->nws || !b->ws[i])
+      continue;
+    if (b->groups[g])
+      ext_workspace_group_handle_v1_send_workspace_leave(b->groups[g], b->ws[i]);
+    ext_workspace_handle_v1_send_removed(b->ws[i]);
+  }
+  int was_active = !!(m.ws[i].state & EXT_WORKSPACE_HANDLE_V1_STATE_ACTIVE);
+  m.ws[i].group = -1;
+  m.ws[i].state = 0;
+  // Like a real compositor, fall back to another workspace of the group
+  for (size_t k = 0; was_active && k < m.nws; k++) {
+    if (m.ws[k].group == g) {
+      apply_activation(k);
+      break;
+    }
+  }
+}
+
+static void set_flag(size_t i, uint32_t bit, int on) {
+  if (on)
+    m.ws[i].state |= bit;
+  else
+    m.ws[i].state &= ~bit;
+  send_state(i);
+}
+
+static void rename_ws(size_t i, const char *name) {
+  snprintf(m.ws[i].name, sizeof m.ws[i].name, "%s", name);
+  struct binding *b;
+  wl_list_for_each(b, &m.bindings, link) {
+    if (i < b->nws && b->ws[i])
+      ext_workspace_handle_v1_send_name(b->ws[i], m.ws[i].name);
+  }
+}
+
+// Activates n inactive workspaces in turn, ending a batch every per_done
+static void burst(long n, long per_done) {
+  for (long k = 0; k < n; k++) {
+    for (size_t tries = 0; tries < m.nws; tries++) {
+      size_t i = m.burst_next++ % m.nws;
+      if (m.ws[i].group >= 0 &&
+          !(m.ws[i].state & EXT_WORKSPACE_HANDLE_V1_STATE_ACTIVE)) {
+        apply_activation(i);
+        break;
+      }
+    }
+    if ((k + 1) % per_done == 0 || k + 1 == n)
+      done_all();
+  }
+}
+
+static void move_ws(size_t i) {
+  m.ws[i].col = m.outputs[m.ws[i].group].ncols++;
+  struct binding *b;
+  wl_list_for_each(b, &m.bindings, link) {
+    if (i < b->nws && b->ws[i])
+      send_coords(b->ws[i], &m.ws[i]);
+  }
+}
+
+// --- storm ---------------------------------------------------------------------
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// One change of the churn cycle
+static void storm_step(void) {
+  size_t i = m.storm.cur;
+  char name[64];
+  switch (m.storm.step) {
+  case 0: {
+    // Round robin over the outputs still plugged in
+    int o = (int)(m.storm.sent / 5 % (unsigned long)m.noutputs);
+    for (int k = 0; k < m.noutputs && !m.outputs[o].global; k++)
+      o = (o + 1) % m.noutputs;
+    snprintf(name, sizeof name, "storm-%lu", m.storm.sent / 5);
+    m.storm.cur = add_ws(o, name);
+    break;
+  }
+  case 1:
+    set_flag(i, EXT_WORKSPACE_HANDLE_V1_STATE_URGENT, 1);
+    break;
+  case 2:
+    snprintf(name, sizeof name, "storm-%lu'", m.storm.sent / 5);
+    rename_ws(i, name);
+    break;
+  case 3:
+    move_ws(i);
+    break;
+  default:
+    remove_ws(i);
+    break;
+  }
+  m.storm.step = (m.storm.step + 1) % 5;
+  m.storm.sent++;
+}
+
+static int storm_tick(void *data) {
+  (void)data;
+  uint64_t now = now_ns();
+  if (now > m.storm.end_ns)
+    now = m.storm.end_ns;
+  unsigned long due = (unsigned long)((double)m.storm.rate *
+                                      (double)(now - m.storm.start_ns) / 1e9);
+  if (due > m.storm.sent) {
+    while (m.storm.sent < due)
+      storm_step();
+    done_all();
+  }
+  if (now < m.storm.end_ns) {
+    wl_event_source_timer_update(m.storm.timer, 1);
+    return 0;
+  }
+  // Finish the cycle so the model is back where it started
+  while (m.storm.step)
+    storm_step();
+  done_all();
+  double secs = (double)(now_ns() - m.storm.start_ns) / 1e9;
+  printf("storm rate %ld sent %lu secs %.3f rate_out %.0f lost %lu\n",
+         m.storm.rate, m.storm.sent, secs, (double)m.storm.sent / secs,
+         m.storm.lost);
+  fflush(stdout);
+  m.storm.rate = 0;
+  resume_script(NULL);
+  return 0;
+}
+
+static void storm(long rate, long ms) {
+  m.storm.rate = rate;
+  m.storm.sent = m.storm.lost = 0;
+  m.storm.step = 0;
+  m.storm.start_ns = now_ns();
+  m.storm.end_ns = m.storm.start_ns + (uint64_t)ms * 1000000u;
+  m.paused = 1;
+  wl_event_source_timer_update(m.storm.timer, 1);
+}
+
+// --- script --------------------------------------------------------------------
+
+static int script_timer_fire(void *data) {
+  resume_script(data);
+  return 0;
+}
+
+// A 1-based workspace argument, or -1
+static long ws_arg(const char *s) {
+  long i = s ? strtol(s, NULL, 10) : 0;
+  return i >= 1 && (size_t)i <= m.nws && m.ws[i - 1].group >= 0 ? i - 1 : -1;
+}
+
+static void run_line(char *line) {
+  char *save = NULL;
+  char *cmd = strtok_r(line, " \t", &save);
+  if (!cmd || *cmd == '#')
+    return;
+  char *a = strtok_r(NULL, " \t", &save);
+  char *b = strtok_r(NULL, " \t", &save);
+  long i = ws_arg(a);
+  long o = a ? strtol(a, NULL, 10) - 1 : -1;
+
+  if (strcmp(cmd, "quit") == 0) {
+    wl_display_terminate(m.dpy);
+    m.paused = 1;
+  } else if (strcmp(cmd, "sleep") == 0) {
+    int ms = a ? atoi(a) : 0;
+    m.paused = 1;
+    wl_event_source_timer_update(m.script_timer, ms > 0 ? ms : 1);
+  } else if (strcmp(cmd, "wait-client") == 0) {
+    if (wl_list_empty(&m.bindings))
+      m.paused = m.wait_client = 1;
+  } else if (strcmp(cmd, "burst") == 0 && a) {
+    long per = b ? strtol(b, NULL, 10) : 1;
+    burst(strtol(a, NULL, 10), per > 0 ? per : 1);
+  } else if (strcmp(cmd, "storm") == 0 && a && b && atol(a) > 0 &&
+             atol(b) > 0) {
+    storm(atol(a), atol(b));
+  } else if (strcmp(cmd, "activate") == 0 && i >= 0) {
+    apply_activation((size_t)i);
+    done_all();
+  } else if ((strcmp(cmd, "urgent") == 0 || strcmp(cmd, "hidden") == 0) &&
+             i >= 0 && b) {
+    set_flag((size_t)i,
+             *cmd == 'u' ? EXT_WORKSPACE_HANDLE_V1_STATE_URGENT
+                         : EXT_WORKSPACE_HANDLE_V1_STATE_HIDDEN,
+             atoi(b));
+    done_all();
+  } else if (strcmp(cmd, "rename") == 0 && i >= 0 && b) {
+    rename_ws((size_t)i, b);
+    done_all();
+  } else if (strcmp(cmd, "add") == 0 && o >= 0 && o < m.noutputs && b &&
+             m.outputs[o].global) {
+    add_ws((int)o, b);
+    done_all();
+  } else if (strcmp(cmd, "remove") == 0 && i >= 0) {
+    remove_ws((size_t)i);
+    done_all();
+  } else if ((strcmp(cmd, "unplug") == 0 ||
+              strcmp(cmd, "unplug-late") == 0) &&
+             o >= 0 && o < m.noutputs) {
+    unplug((int)o, cmd[6] == '-');
+  } else {
+    fprintf(stderr, "mock_compositor: bad script line: %s%s%s\n", cmd,
+            a ? " " : "", a ? a : "");
+  }
+}
+
+static void run_script(void) {
+  while (!m.paused) {
+    char *nl = memchr(m.script, '\n', m.slen);
+    if (!nl) {
+      if (!m.script_eof || !m.slen)
+        return;
+      // Last line without a newline
+      m.script = xalloc(m.script, m.slen + 1);
+      nl = m.script + m.slen++;
+    }
+    *nl = '\0';
+    size_t len = (size_t)(nl - m.script) + 1;
+    char line[512];
+    snprintf(line, sizeof line, "%s", m.script);
+    memmove(m.script, m.script + len, m.slen - len);
+    m.slen -= len;
+    run_line(line);
+  }
+}
+
+static void script_append(const char *buf, size_t n) {
+  if (m.slen + n > m.scap) {
+    m.scap = (m.slen + n) * 2;
+    m.script = xalloc(m.script, m.scap);
+  }
+  memcpy(m.script + m.slen, buf, n);
+  m.slen += n;
+}
+
+static int stdin_readable(int fd, uint32_t mask, void *data) {
+  (void)mask;
+  (void)data;
+  char buf[4096];
+  ssize_t n = read(fd, buf, sizeof buf);
+  if (n > 0) {
+    script_append(buf, (size_t)n);
+  } else {
+    m.script_eof = 1;
+    wl_event_source_remove(m.stdin_src);
+    m.stdin_src = NULL;
+  }
+  run_script();
+  return 0;
+}
+
+static int load_script(const char *path) {
+  if (strcmp(path, "-") == 0) {
+    m.stdin_src = wl_event_loop_add_fd(m.loop, STDIN_FILENO, WL_EVENT_READABLE,
+                                       stdin_readable, NULL);
+    return m.stdin_src ? 0 : -1;
+  }
+  FILE *f = fopen(path, "r");
+  if (!f)
+    return -1;
+  char buf[4096];
+  for (size_t n; (n = fread(buf, 1, sizeof buf, f)) > 0;)
+    script_append(buf, n);
+  fclose(f);
+  m.script_eof = 1;
+  return 0;
+}
+
+static int on_signal(int sig, void *data) {
+  (void)sig;
+  (void)data;
+  wl_display_terminate(m.dpy);
+  return 0;
+}
+
+static void usage(const char *prg) {
+  fprintf(stderr,
+          "Usage: %s [options]\n"
+          "  --outputs N      Outputs, one workspace group each (default: 2)\n"
+          "  --workspaces M   Workspaces per output (default: 3)\n"
+          "  --delay MS       Apply client activations MS after commit\n"
+          "  --socket NAME    Listen on $XDG_RUNTIME_DIR/NAME\n"
+          "  --script FILE    Run script commands from FILE (- for stdin)\n",
+          prg);
+  exit(1);
+}
+
+int main(int argc, char **argv) {
+  static const struct option longopts[] = {{"outputs", 1, 0, 'o'},
+                                           {"workspaces", 1, 0, 'w'},
+                                           {"delay", 1, 0, 'd'},
+                                           {"socket", 1, 0, 's'},
+                                           {"script", 1, 0, 'S'},
+                                           {0, 0, 0, 0}};
+  int noutputs = 2, per_output = 3;
+  const char *socket = NULL, *script = NULL;
+  for (int ch; (ch = getopt_long(argc, argv, "", longopts, NULL)) != -1;) {
+    switch (ch) {
+    case 'o':
+      noutputs = atoi(optarg);
+      break;
+    case 'w':
+      per_output = atoi(optarg);
+      break;
+    case 'd':
+      m.delay_ms = atoi(optarg);
+      break;
+    case 's':
+      socket = optarg;
+      break;
+    case 'S':
+      script = optarg;
+      break;
+    default:
+      usage(argv[0]);
+    }
+  }
+  if (optind != argc || noutputs <= 0 || per_output <= 0 || m.delay_ms < 0)
+    usage(argv[0]);
+
+  m.dpy = wl_display_create();
+  if (!m.dpy) {
+    fputs("mock_compositor: cannot create display\n", stderr);
+    return 1;
+  }
+  m.loop = wl_display_get_event_loop(m.dpy);
+  wl_list_init(&m.bindings);
+  wl_list_init(&m.commits);
+
+  m.noutputs = noutputs;
+  m.outputs = xalloc(NULL, (size_t)noutputs * sizeof *m.outputs);
+  for (int o = 0; o < noutputs; o++) {
+    struct mock_output *out = &m.outputs[o];
+    snprintf(out->name, sizeof out->name, "MOCK-%d", o + 1);
+    wl_list_init(&out->resources);
+    out->global = wl_global_create(m.dpy, &wl_output_interface, 4, out, output_bind);
+    for (int k = 0; k < per_output; k++) {
+      char name[16];
+      snprintf(name, sizeof name, "%zu", m.nws + 1);
+      size_t i = add_ws(o, name);
+      if (k == 0)
+        m.ws[i].state = EXT_WORKSPACE_HANDLE_V1_STATE_ACTIVE;
+    }
+  }
+  wl_global_create(m.dpy, &ext_workspace_manager_v1_interface, 1, NULL, mgr_bind);
+
+  if (socket ? wl_display_add_socket(m.dpy, socket) != 0
+             : !(socket = wl_display_add_socket_auto(m.dpy))) {
+    fputs("mock_compositor: cannot add socket (is XDG_RUNTIME_DIR set?)\n",
+          stderr);
+    return 1;
+  }
+  m.script_timer = wl_event_loop_add_timer(m.loop, script_timer_fire, NULL);
+  m.storm.timer = wl_event_loop_add_timer(m.loop, storm_tick, NULL);
+  if (script && load_script(script) != 0) {
+    fprintf(stderr, "mock_compositor: cannot read script %s\n", script);
+    return 1;
+  }
+  wl_event_loop_add_signal(m.loop, SIGTERM, on_signal, NULL);
+  wl_event_loop_add_signal(m.loop, SIGINT, on_signal, NULL);
+  printf("%s\n", socket);
+  fflush(stdout);
+
+  wl_event_loop_add_idle(m.loop, resume_script, NULL);
+  wl_display_run(m.dpy);
+
+  wl_display_destroy_clients(m.dpy);
+  struct commit *c, *tmp;
+  wl_list_for_each_safe(c, tmp, &m.commits, link) {
+    wl_event_source_remove(c->timer);
+    free(c->ws);
+    free(c);
+  }
+  wl_display_destroy(m.dpy);
+  free(m.outputs);
+  free(m.ws);
+  free(m.script);
+  return 0;
+}
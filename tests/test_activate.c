@@ -0,0 +1,91 @@
+#define _GNU_SOURCE
+
+#include "../activate.h"
+#include "../types.h"
+#include "../workspace.h"
+#include <setjmp.h>
+#include <stdarg.h>
+#include <cmocka.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void test_activate_wait_already_active(void **state) {
+  (void)state;
+  struct wayws_state s = {0};
+  model_init(&s);
+  struct ws *w = slab_alloc(&s.ws_slab);
+  w->active = 1;
+  // Confirmed without touching the (absent) connection
+  assert_int_equal(activate_wait(&s, slab_handle(&s.ws_slab, w), 100), 0);
+  model_destroy(&s);
+}
+
+static void test_activate_wait_stale_handle(void **state) {
+  (void)state;
+  struct wayws_state s = {0};
+  model_init(&s);
+  struct ws *w = slab_alloc(&s.ws_slab);
+  slab_handle_t h = slab_handle(&s.ws_slab, w);
+  slab_release(&s.ws_slab, w);
+  // Even if the slot is reused, the old handle no longer resolves
+  struct ws *again = slab_alloc(&s.ws_slab);
+  again->active = 1;
+  assert_int_equal(activate_wait(&s, h, 100), -1);
+  model_destroy(&s);
+}
+
+static char *report(uint64_t *samples, size_t n) {
+  char *buf = NULL;
+  size_t len = 0;
+  FILE *f = open_memstream(&buf, &len);
+  assert_non_null(f);
+  activate_report(f, samples, n);
+  fclose(f);
+  return buf;
+}
+
+static void test_activate_report_quantiles(void **state) {
+  (void)state;
+  // 1..100 ms, shuffled
+  uint64_t samples[100];
+  for (int i = 0; i < 100; i++)
+    samples[i] = (uint64_t)((i * 37) % 100 + 1) * 1000000u;
+  char *out = report(samples, 100);
+  assert_non_null(strstr(out, "activations 100\n"));
+  assert_non_null(strstr(out, "min          1.000 ms\n"));
+  assert_non_null(strstr(out, "median      50.000 ms\n"));
+  assert_non_null(strstr(out, "p99         99.000 ms\n"));
+  assert_non_null(strstr(out, "max        100.000 ms\n"));
+  // Sorted in place
+  assert_int_equal(samples[0], 1000000u);
+  assert_int_equal(samples[99], 100000000u);
+  free(out);
+}
+
+static void test_activate_report_histogram(void **state) {
+  (void)state;
+  // Three samples in [512, 1024) us, one in [2048, 4096) us
+  uint64_t samples[] = {600000, 700000, 800000, 3000000};
+  char *out = report(samples, 4);
+  assert_non_null(strstr(out, "<     1024 us |"
+                              "########################################"
+                              " 3\n"));
+  assert_non_null(strstr(out, "<     2048 us |"
+                              "                                         0\n"));
+  assert_non_null(strstr(out, "<     4096 us |##############"
+                              "                           1\n"));
+  assert_null(strstr(out, "<      512 us"));
+  free(out);
+}
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+      cmocka_unit_test(test_activate_wait_already_active),
+      cmocka_unit_test(test_activate_wait_stale_handle),
+      cmocka_unit_test(test_activate_report_quantiles),
+      cmocka_unit_test(test_activate_report_histogram),
+  };
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
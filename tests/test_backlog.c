@@ -0,0 +1,118 @@
+#include "../backlog.h"
+#include <setjmp.h>
+#include <stdarg.h>
+#include <cmocka.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void add(struct backlog *b, unsigned long *slot, const char *line) {
+  struct backlog_entry *e = backlog_add(b, slot);
+  assert_non_null(e);
+  outbuf_puts(&e->line, line);
+}
+
+static const char *take(struct backlog *b, struct outbuf *out) {
+  out->len = 0;
+  backlog_take(b, out, 0);
+  outbuf_putc(out, '\0');
+  return out->buf;
+}
+
+static void test_backlog_latest_wins_in_place(void **state) {
+  (void)state;
+  struct backlog b = {0};
+  struct outbuf out = {0};
+  unsigned long a_state = 0, b_state = 0;
+  add(&b, NULL, "created a\n");
+  add(&b, &a_state, "a inactive\n");
+  add(&b, &b_state, "b active\n");
+  add(&b, &a_state, "a active\n");
+  add(&b, &b_state, "b inactive\n");
+  add(&b, NULL, "destroyed c\n");
+  assert_int_equal(b.coalesced, 2);
+  assert_string_equal(take(&b, &out),
+                      "created a\na active\nb inactive\ndestroyed c\n");
+  assert_int_equal(b.len, 0);
+  outbuf_free(&out);
+  backlog_free(&b);
+}
+
+static void test_backlog_slots_expire_when_taken(void **state) {
+  (void)state;
+  struct backlog b = {0};
+  struct outbuf out = {0};
+  unsigned long slot = 0;
+  add(&b, &slot, "one\n");
+  take(&b, &out);
+  // Gone to the writer: the next one is queued afresh, not written into
+  // an entry of the new round that happens to sit at the same index
+  unsigned long other = 0;
+  add(&b, &other, "other\n");
+  add(&b, &slot, "two\n");
+  assert_int_equal(b.coalesced, 0);
+  assert_string_equal(take(&b, &out), "other\ntwo\n");
+  outbuf_free(&out);
+  backlog_free(&b);
+}
+
+static void test_backlog_forgotten_slot_starts_afresh(void **state) {
+  (void)state;
+  struct backlog b = {0};
+  struct outbuf out = {0};
+  unsigned long slot = 0;
+  add(&b, &slot, "x=1\n");
+  add(&b, NULL, "leave\n");
+  slot = 0; // what the caller does across a barrier
+  add(&b, &slot, "x=2\n");
+  assert_string_equal(take(&b, &out), "x=1\nleave\nx=2\n");
+  outbuf_free(&out);
+  backlog_free(&b);
+}
+
+static void test_backlog_full_drops_but_still_coalesces(void **state) {
+  (void)state;
+  struct backlog b = {0};
+  struct outbuf out = {0};
+  unsigned long slot = 0;
+  add(&b, &slot, "first\n");
+  for (int i = 1; i < BACKLOG_MAX; i++)
+    add(&b, NULL, "x\n");
+  assert_null(backlog_add(&b, NULL));
+  assert_int_equal(b.dropped, 1);
+  add(&b, &slot, "latest\n");
+  assert_int_equal(b.coalesced, 1);
+  assert_int_equal(b.len, BACKLOG_MAX);
+  assert_memory_equal(take(&b, &out), "latest\nx\n", 9);
+  outbuf_free(&out);
+  backlog_free(&b);
+}
+
+static void test_backlog_latency_measured_on_take(void **state) {
+  (void)state;
+  struct backlog b = {0};
+  struct outbuf out = {0};
+  struct backlog_entry *e = backlog_add(&b, NULL);
+  outbuf_puts(&e->line, "{\"latency_ns\":");
+  e->lat_off = e->line.len;
+  e->read_ns = 1000;
+  outbuf_puts(&e->line, "}\n");
+  add(&b, NULL, "plain\n");
+  backlog_take(&b, &out, 1500);
+  outbuf_putc(&out, '\0');
+  assert_string_equal(out.buf, "{\"latency_ns\":500}\nplain\n");
+  outbuf_free(&out);
+  backlog_free(&b);
+}
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+      cmocka_unit_test(test_backlog_latest_wins_in_place),
+      cmocka_unit_test(test_backlog_slots_expire_when_taken),
+      cmocka_unit_test(test_backlog_forgotten_slot_starts_afresh),
+      cmocka_unit_test(test_backlog_full_drops_but_still_coalesces),
+      cmocka_unit_test(test_backlog_latency_measured_on_take),
+  };
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,186 @@
+#define _GNU_SOURCE
+
+#include "../cli.h"
+#include "../daemon.h"
+#include <setjmp.h>
+#include <stdarg.h>
+#include <cmocka.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static char runtime_dir[64];
+
+static int setup(void **state) {
+  (void)state;
+  strcpy(runtime_dir, "/tmp/wayws-test-XXXXXX");
+  if (!mkdtemp(runtime_dir))
+    return -1;
+  setenv("XDG_RUNTIME_DIR", runtime_dir, 1);
+  setenv("WAYLAND_DISPLAY", "wayland-test", 1);
+  return 0;
+}
+
+static int teardown(void **state) {
+  (void)state;
+  char path[128];
+  snprintf(path, sizeof path, "%s/wayws-wayland-test.sock", runtime_dir);
+  unlink(path);
+  rmdir(runtime_dir);
+  return 0;
+}
+
+static void test_socket_path_uses_display(void **state) {
+  (void)state;
+  char path[128], expected[128];
+  assert_int_equal(daemon_socket_path(path, sizeof path), 0);
+  snprintf(expected, sizeof expected, "%s/wayws-wayland-test.sock",
+           runtime_dir);
+  assert_string_equal(path, expected);
+}
+
+static void test_socket_path_absolute_display(void **state) {
+  (void)state;
+  char path[128], expected[128];
+  setenv("WAYLAND_DISPLAY", "/run/user/1000/wayland-9", 1);
+  assert_int_equal(daemon_socket_path(path, sizeof path), 0);
+  snprintf(expected, sizeof expected, "%s/wayws-wayland-9.sock", runtime_dir);
+  assert_string_equal(path, expected);
+}
+
+static void test_socket_path_requires_runtime_dir(void **state) {
+  (void)state;
+  char path[128];
+  unsetenv("XDG_RUNTIME_DIR");
+  assert_int_equal(daemon_socket_path(path, sizeof path), -1);
+}
+
+static void test_forward_without_daemon_falls_back(void **state) {
+  (void)state;
+  char *argv[] = {"wayws", "3", NULL};
+  int status = 42;
+  assert_int_equal(daemon_forward(2, argv, &status), -1);
+  assert_int_equal(status, 42);
+}
+
+// A minimal stand-in daemon: checks the forwarded argv and replies with 7.
+static void fake_daemon(int lfd) {
+  int cfd = accept(lfd, NULL, NULL);
+  uint32_t len;
+  char payload[256];
+  int32_t status = 7;
+  if (recv(cfd, &len, sizeof len, MSG_WAITALL) != sizeof len ||
+      len > sizeof payload ||
+      recv(cfd, payload, len, MSG_WAITALL) != (ssize_t)len ||
+      len != sizeof "wayws\0--right" ||
+      memcmp(payload, "wayws\0--right", len) != 0)
+    status = 99;
+  send(cfd, &status, sizeof status, 0);
+  close(cfd);
+  _exit(0);
+}
+
+static void test_forward_round_trip(void **state) {
+  (void)state;
+  struct sockaddr_un addr = {.sun_family = AF_UNIX};
+  assert_int_equal(daemon_socket_path(addr.sun_path, sizeof addr.sun_path),
+                   0);
+  int lfd = socket(AF_UNIX, SOCK_STREAM, 0);
+  assert_true(lfd >= 0);
+  assert_int_equal(bind(lfd, (struct sockaddr *)&addr, sizeof addr), 0);
+  assert_int_equal(listen(lfd, 1), 0);
+
+  pid_t pid = fork();
+  assert_true(pid >= 0);
+  if (pid == 0)
+    fake_daemon(lfd);
+  close(lfd);
+
+  char *argv[] = {"wayws", "--right", NULL};
+  int status = 0;
+  assert_int_equal(daemon_forward(2, argv, &status), 0);
+  assert_int_equal(status, 7);
+  waitpid(pid, NULL, 0);
+}
+
+// What the daemon does with a forwarded command line before running it
+static int parse_forwarded(struct wayws_state *st, int argc, char **argv) {
+  set_cli_defaults(st);
+  optind = 0;
+  return parse_cli(st, argc, argv, 1);
+}
+
+static int forward(char **argv) {
+  int argc = 0, status = -1;
+  while (argv[argc])
+    argc++;
+  return daemon_forward(argc, argv, &status) == 0 ? status : -1;
+}
+
+static void test_bad_forward_keeps_daemon_alive(void **state) {
+  (void)state;
+  struct sockaddr_un addr = {.sun_family = AF_UNIX};
+  assert_int_equal(daemon_socket_path(addr.sun_path, sizeof addr.sun_path),
+                   0);
+  int lfd = socket(AF_UNIX, SOCK_STREAM, 0);
+  assert_true(lfd >= 0);
+  assert_int_equal(bind(lfd, (struct sockaddr *)&addr, sizeof addr), 0);
+  assert_int_equal(listen(lfd, 3), 0);
+
+  pid_t pid = fork();
+  assert_true(pid >= 0);
+  if (pid == 0) {
+    // The complaints land in the client's stderr (and the help in its
+    // stdout); keep them out of the test output
+    freopen("/dev/null", "w", stdout);
+    freopen("/dev/null", "w", stderr);
+    char *usage[] = {"wayws", "--grid", "0", NULL};
+    char *bad[] = {"wayws", "-w", "--events", "bogus", NULL};
+    char *good[] = {"wayws", "-l", NULL};
+    _exit(forward(usage) == 1 && forward(bad) == 1 && forward(good) == 0
+              ? 0
+              : 1);
+  }
+
+  // Served in this process: a parse error that exited would end the test
+  struct wayws_state st = {0};
+  set_cli_defaults(&st);
+  for (int i = 0; i < 3; i++) {
+    int cfd = accept(lfd, NULL, NULL);
+    assert_true(cfd >= 0);
+    daemon_serve_client(&st, parse_forwarded, cfd);
+    close(cfd);
+  }
+  close(lfd);
+  assert_int_equal(st.flag_list, 1);
+
+  int wstatus;
+  assert_int_equal(waitpid(pid, &wstatus, 0), pid);
+  assert_true(WIFEXITED(wstatus));
+  assert_int_equal(WEXITSTATUS(wstatus), 0);
+  set_cli_defaults(&st);
+}
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+      cmocka_unit_test_setup_teardown(test_socket_path_uses_display, setup,
+                                      teardown),
+      cmocka_unit_test_setup_teardown(test_socket_path_absolute_display, setup,
+                                      teardown),
+      cmocka_unit_test_setup_teardown(test_socket_path_requires_runtime_dir,
+                                      setup, teardown),
+      cmocka_unit_test_setup_teardown(test_forward_without_daemon_falls_back,
+                                      setup, teardown),
+      cmocka_unit_test_setup_teardown(test_forward_round_trip, setup,
+                                      teardown),
+      cmocka_unit_test_setup_teardown(test_bad_forward_keeps_daemon_alive,
+                                      setup, teardown),
+  };
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
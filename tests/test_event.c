@@ -1,31 +1,32 @@
 #include "../event.h"
 #include "../types.h"
+#include "../util.h"
+#include "../writer.h"
+#include <poll.h>
+#include <fcntl.h>
 #include <setjmp.h>
 #include <stdarg.h>
 #include <cmocka.h>
 #include <stddef.h>
+#include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
-// Mock output for testing
-static char test_output[1024];
-static size_t test_output_pos = 0;
+// Events are queued in state->event_out; copy them out as a C string
+static char test_output[4096];
 
-// Mock printf to capture output
-int printf(const char *format, ...) {
-    va_list args;
-    va_start(args, format);
-    int result = vsnprintf(test_output + test_output_pos, 
-                          sizeof(test_output) - test_output_pos, 
-                          format, args);
-    test_output_pos += result;
-    va_end(args);
-    return result;
+static const char *captured(struct wayws_state *s) {
+    size_t n = s->event_out.len < sizeof(test_output) - 1 ? s->event_out.len
+                                                          : sizeof(test_output) - 1;
+    memcpy(test_output, s->event_out.buf, n);
+    test_output[n] = '\0';
+    return test_output;
 }
 
 // Test setup and teardown
 static int setup(void **state) {
-    test_output_pos = 0;
     memset(test_output, 0, sizeof(test_output));
     return 0;
 }
@@ -39,24 +40,28 @@ static void test_emit_event_workspace_created(void **state) {
     struct wayws_state s = {.event_enabled = 1};
     
     emit_event(&s, EVENT_WORKSPACE_CREATED, "test-ws", "DP-1", 1, 0, 0, 1, 0, 0, DIR_NONE, NULL);
+    captured(&s);
     
     assert_true(strstr(test_output, "\"type\":\"workspace_created\"") != NULL);
     assert_true(strstr(test_output, "\"name\":\"test-ws\"") != NULL);
     assert_true(strstr(test_output, "\"output\":\"DP-1\"") != NULL);
     assert_true(strstr(test_output, "\"active\":true") != NULL);
     assert_true(strstr(test_output, "\"timestamp\":") != NULL);
+    outbuf_free(&s.event_out);
 }
 
 static void test_emit_event_workspace_state(void **state) {
     struct wayws_state s = {.event_enabled = 1};
     
     emit_event(&s, EVENT_WORKSPACE_STATE, "test-ws", "DP-1", 1, 10, 20, 1, 1, 0, DIR_NONE, NULL);
+    captured(&s);
     
     assert_true(strstr(test_output, "\"type\":\"workspace_state\"") != NULL);
     assert_true(strstr(test_output, "\"x\":10") != NULL);
     assert_true(strstr(test_output, "\"y\":20") != NULL);
     assert_true(strstr(test_output, "\"urgent\":true") != NULL);
     assert_true(strstr(test_output, "\"hidden\":false") != NULL);
+    outbuf_free(&s.event_out);
 }
 
 
@@ -66,16 +71,18 @@ static void test_emit_event_disabled(void **state) {
     
     emit_event(&s, EVENT_WORKSPACE_CREATED, "test-ws", "DP-1", 1, 0, 0, 1, 0, 0, DIR_NONE, NULL);
     
-    assert_int_equal(test_output_pos, 0); // No output when disabled
+    assert_int_equal(s.event_out.len, 0); // No output when disabled
 }
 
 static void test_emit_event_null_names(void **state) {
     struct wayws_state s = {.event_enabled = 1};
     
     emit_event(&s, EVENT_WORKSPACE_CREATED, NULL, NULL, 1, 0, 0, 1, 0, 0, DIR_NONE, NULL);
+    captured(&s);
     
     assert_true(strstr(test_output, "\"name\":\"\"") != NULL);
     assert_true(strstr(test_output, "\"output\":\"\"") != NULL);
+    outbuf_free(&s.event_out);
 }
 
 static void test_emit_event_exec_command(void **state) {
@@ -84,8 +91,348 @@ static void test_emit_event_exec_command(void **state) {
     // This test verifies the exec command is called
     // In a real test, we'd mock system() to verify it's called
     emit_event(&s, EVENT_WORKSPACE_CREATED, "test-ws", "DP-1", 1, 0, 0, 1, 0, 0, DIR_NONE, NULL);
+    captured(&s);
     
     assert_true(strstr(test_output, "\"type\":\"workspace_created\"") != NULL);
+    outbuf_free(&s.event_out);
+}
+
+static void test_end_event_batch_counts_batches(void **state) {
+    struct wayws_state s = {.event_enabled = 1};
+    
+    end_event_batch(&s);
+    end_event_batch(&s);
+    
+    assert_int_equal(s.batch_seq, 2);
+    assert_int_equal(s.event_out.len, 0); // Batch end emits nothing by itself
+}
+
+static void test_emit_event_escapes_names(void **state) {
+    struct wayws_state s = {.event_enabled = 1};
+    
+    emit_event(&s, EVENT_WORKSPACE_NAME, "say \"hi\"\\", "DP-1\n", 1, 0, 0, 0, 0, 0,
+               DIR_NONE, NULL);
+    captured(&s);
+    
+    assert_non_null(strstr(test_output, "\"name\":\"say \\\"hi\\\"\\\\\""));
+    assert_non_null(strstr(test_output, "\"output\":\"DP-1\\n\""));
+    // Exactly one line per event
+    assert_ptr_equal(strchr(test_output, '\n'), test_output + strlen(test_output) - 1);
+    outbuf_free(&s.event_out);
+}
+
+static void test_emit_event_format_template(void **state) {
+    struct wayws_state s = {.event_enabled = 1, .opt_format = "{type} {name}@{output}"};
+    assert_int_equal(template_compile(&s.format, s.opt_format), 0);
+    
+    emit_event(&s, EVENT_WORKSPACE_STATE, "code", "DP-1", 1, 0, 0, 1, 0, 0, DIR_NONE, NULL);
+    
+    assert_string_equal(captured(&s), "workspace_state code@DP-1\n");
+    template_free(&s.format);
+    outbuf_free(&s.event_out);
+}
+
+static void test_emit_event_format_template_id(void **state) {
+    struct wayws_state s = {.event_enabled = 1, .opt_format = "{name} {id}"};
+    assert_int_equal(template_compile(&s.format, s.opt_format), 0);
+    struct ws w = {.name = "code", .id = "ws-3"};
+    
+    emit_event(&s, EVENT_WORKSPACE_STATE, "code", "DP-1", 1, 0, 0, 1, 0, 0, DIR_NONE, &w);
+    // Events that are not about a workspace have no id
+    emit_event(&s, EVENT_OUTPUT_ENTER, NULL, "DP-1", 0, 0, 0, 0, 0, 0, DIR_NONE, NULL);
+    
+    assert_string_equal(captured(&s), "code ws-3\n \n");
+    template_free(&s.format);
+    outbuf_free(&s.event_out);
+}
+
+static void test_end_event_batch_writes_queue(void **state) {
+    struct wayws_state s = {.event_enabled = 1};
+    int fds[2];
+    assert_int_equal(pipe(fds), 0);
+    fflush(stdout);
+    int saved = dup(STDOUT_FILENO);
+    dup2(fds[1], STDOUT_FILENO);
+    
+    emit_event(&s, EVENT_WORKSPACE_CREATED, "a", "DP-1", 1, 0, 0, 0, 0, 0, DIR_NONE, NULL);
+    emit_event(&s, EVENT_WORKSPACE_CREATED, "b", "DP-1", 2, 0, 0, 0, 0, 0, DIR_NONE, NULL);
+    size_t queued = s.event_out.len;
+    end_event_batch(&s);
+    
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
+    close(fds[1]);
+    ssize_t n = read(fds[0], test_output, sizeof(test_output) - 1);
+    close(fds[0]);
+    assert_int_equal(n, (ssize_t)queued);
+    test_output[n] = '\0';
+    assert_int_equal(s.event_out.len, 0);
+    char *a = strstr(test_output, "\"name\":\"a\"");
+    char *b = strstr(test_output, "\"name\":\"b\"");
+    assert_non_null(a);
+    assert_non_null(b);
+    assert_true(a < b);
+    outbuf_free(&s.event_out);
+}
+
+static void test_emit_event_monotonic_timestamp(void **state) {
+    struct wayws_state s = {.event_enabled = 1};
+    uint64_t before = monotonic_ns();
+    emit_event(&s, EVENT_WORKSPACE_STATE, "a", "DP-1", 1, 0, 0, 1, 0, 0, DIR_NONE, NULL);
+    uint64_t after = monotonic_ns();
+    
+    const char *ts = strstr(captured(&s), "\"timestamp\":");
+    assert_non_null(ts);
+    unsigned long long t = strtoull(ts + strlen("\"timestamp\":"), NULL, 10);
+    assert_true(t >= before && t <= after);
+    outbuf_free(&s.event_out);
+}
+
+// Reads the batch written by end_event_batch through a pipe
+static const char *write_batch(struct wayws_state *s) {
+    int fds[2];
+    assert_int_equal(pipe(fds), 0);
+    fflush(stdout);
+    int saved = dup(STDOUT_FILENO);
+    dup2(fds[1], STDOUT_FILENO);
+    end_event_batch(s);
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
+    close(fds[1]);
+    ssize_t n = read(fds[0], test_output, sizeof(test_output) - 1);
+    close(fds[0]);
+    assert_true(n >= 0);
+    test_output[n] = '\0';
+    return test_output;
+}
+
+static void test_latency_filled_in_on_write(void **state) {
+    struct wayws_state s = {.event_enabled = 1, .flag_latency = 1};
+    // Before the first read (the initial state) there is nothing to measure
+    emit_event(&s, EVENT_WORKSPACE_CREATED, "a", "DP-1", 1, 0, 0, 0, 0, 0, DIR_NONE, NULL);
+    s.read_ns = monotonic_ns();
+    emit_event(&s, EVENT_WORKSPACE_CREATED, "b", "DP-1", 2, 0, 0, 0, 0, 0, DIR_NONE, NULL);
+    emit_event(&s, EVENT_WORKSPACE_STATE, "b", "DP-1", 2, 0, 0, 1, 0, 0, DIR_NONE, NULL);
+    usleep(1000);
+    const char *out = write_batch(&s);
+    uint64_t bound = monotonic_ns() - s.read_ns;
+    
+    // The first line predates the read and has no latency_ns
+    const char *nl = strchr(out, '\n');
+    assert_non_null(nl);
+    const char *lat = strstr(out, "\"latency_ns\":");
+    assert_true(lat > nl);
+    int lines = 1;
+    for (const char *line = nl + 1; *line; line = strchr(line, '\n') + 1, lines++) {
+        lat = strstr(line, "\"latency_ns\":");
+        assert_non_null(lat);
+        char *end;
+        unsigned long long ns = strtoull(lat + strlen("\"latency_ns\":"), &end, 10);
+        // Measured when written, so it covers the sleep above
+        assert_true(ns >= 1000000 && ns <= bound);
+        assert_memory_equal(end, "}\n", 2);
+    }
+    assert_int_equal(lines, 3);
+    assert_int_equal(s.nlat, 0);
+    outbuf_free(&s.event_out);
+    outbuf_free(&s.lat_out);
+    free(s.lat_marks);
+}
+
+// Reads exactly n bytes
+static void read_n(int fd, char *buf, size_t n) {
+    for (size_t got = 0; got < n;) {
+        ssize_t r = read(fd, buf + got, n - got);
+        assert_true(r > 0);
+        got += (size_t)r;
+    }
+}
+
+// Behind a reader that has stopped, a workspace's state and coordinates
+// collapse to their latest values while its creation still comes through
+static void test_backed_up_output_coalesces(void **state) {
+    int fds[2];
+    assert_int_equal(pipe(fds), 0);
+    struct wayws_state s = {.event_enabled = 1};
+    s.writer = writer_start(fds[1], WRITER_RING_SIZE);
+    assert_non_null(s.writer);
+
+    // More than the pipe and the threshold together, with nobody reading
+    static char filler[4 * WRITER_BACKED_UP_AT];
+    memset(filler, '.', sizeof(filler) - 1);
+    filler[sizeof(filler) - 1] = '\n';
+    writer_push(s.writer, filler, sizeof(filler));
+    end_event_batch(&s);
+    assert_true(s.backlogging);
+
+    struct ws w = {0};
+    emit_event(&s, EVENT_WORKSPACE_CREATED, "a", "DP-1", 1, 0, 0, 0, 0, 0, DIR_NONE, &w);
+    emit_event(&s, EVENT_WORKSPACE_STATE, "a", "DP-1", 1, 0, 0, 1, 0, 0, DIR_NONE, &w);
+    end_event_batch(&s);
+    emit_event(&s, EVENT_WORKSPACE_STATE, "a", "DP-1", 1, 0, 0, 0, 0, 0, DIR_NONE, &w);
+    emit_event(&s, EVENT_WORKSPACE_COORDINATES, "a", "DP-1", 1, 3, 0, 0, 0, 0, DIR_NONE, &w);
+    end_event_batch(&s);
+    emit_event(&s, EVENT_WORKSPACE_STATE, "a", "DP-1", 1, 0, 0, 0, 1, 0, DIR_NONE, &w);
+    emit_event(&s, EVENT_WORKSPACE_COORDINATES, "a", "DP-1", 1, 4, 0, 0, 0, 0, DIR_NONE, &w);
+    end_event_batch(&s);
+    assert_int_equal(s.backlog.len, 3);
+    assert_int_equal(s.backlog.coalesced, 3);
+
+    // The reader catches up and the writer says so
+    static char buf[sizeof(filler)];
+    read_n(fds[0], buf, sizeof(filler));
+    struct pollfd pfd = {.fd = writer_room_fd(s.writer), .events = POLLIN};
+    assert_int_equal(poll(&pfd, 1, 5000), 1);
+    drain_backlog(&s);
+    assert_int_equal(s.backlog.len, 0);
+    assert_false(s.backlogging);
+
+    writer_stop(s.writer, NULL);
+    close(fds[1]);
+    ssize_t n = read(fds[0], test_output, sizeof(test_output) - 1);
+    assert_true(n > 0);
+    test_output[n] = '\0';
+    const char *created = strstr(test_output, "\"workspace_created\"");
+    const char *st = strstr(test_output, "\"workspace_state\"");
+    const char *coords = strstr(test_output, "\"workspace_coordinates\"");
+    assert_non_null(created);
+    assert_true(st > created);
+    assert_true(coords > st);
+    assert_null(strstr(st + 1, "\"workspace_state\""));
+    assert_non_null(strstr(st, "\"active\":false,\"urgent\":true"));
+    assert_non_null(strstr(coords, "\"x\":4"));
+    close(fds[0]);
+    backlog_free(&s.backlog);
+    outbuf_free(&s.event_out);
+}
+
+static void test_end_event_batch_runs_exec_once(void **state) {
+    struct wayws_state s = {.event_enabled = 1, .opt_exec = "sleep 0.1"};
+    fflush(stdout);
+    int saved = dup(STDOUT_FILENO);
+    int null = open("/dev/null", O_WRONLY);
+    dup2(null, STDOUT_FILENO);
+    
+    // A batch with nothing printed does not run the hook
+    end_event_batch(&s);
+    assert_int_equal(s.exec.running, 0);
+    
+    emit_event(&s, EVENT_WORKSPACE_STATE, "a", "DP-1", 1, 0, 0, 1, 0, 0, DIR_NONE, NULL);
+    emit_event(&s, EVENT_WORKSPACE_STATE, "b", "DP-1", 2, 0, 0, 0, 0, 0, DIR_NONE, NULL);
+    end_event_batch(&s);
+    
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
+    close(null);
+    assert_int_equal(s.exec.running, 1);
+    assert_null(s.exec.queued);
+    assert_int_equal(s.batch_events, 0);
+    exec_destroy(&s.exec);
+    outbuf_free(&s.event_out);
+}
+
+// Watch-mode hooks see the workspace's protocol id, not just its name
+static void test_exec_hook_gets_workspace_id(void **state) {
+    char path[] = "/tmp/wayws-exec-id-XXXXXX";
+    int fd = mkstemp(path);
+    assert_true(fd >= 0);
+    close(fd);
+    char cmd[128];
+    snprintf(cmd, sizeof(cmd), "printf '%%s|%%s' \"$WAYWS_NAME\" \"$WAYWS_ID\" >%s", path);
+    struct wayws_state s = {.event_enabled = 1, .opt_exec = cmd};
+    struct ws w = {.name = "web", .id = "ws-7"};
+    fflush(stdout);
+    int saved = dup(STDOUT_FILENO);
+    int null = open("/dev/null", O_WRONLY);
+    dup2(null, STDOUT_FILENO);
+
+    emit_event(&s, EVENT_WORKSPACE_STATE, "web", "DP-1", 1, 0, 0, 1, 0, 0, DIR_NONE, &w);
+    end_event_batch(&s);
+
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
+    close(null);
+    assert_int_equal(s.exec.running, 1);
+    assert_int_equal(waitpid(s.exec.pids[0], NULL, 0), s.exec.pids[0]);
+    FILE *f = fopen(path, "r");
+    assert_non_null(f);
+    char got[64] = {0};
+    assert_non_null(fgets(got, sizeof(got), f));
+    fclose(f);
+    unlink(path);
+    assert_string_equal(got, "web|ws-7");
+    exec_destroy(&s.exec);
+    outbuf_free(&s.event_out);
+}
+
+static void test_event_type_name(void **state) {
+    assert_string_equal(event_type_name(EVENT_WORKSPACE_CREATED), "workspace_created");
+    assert_string_equal(event_type_name(EVENT_OUTPUT_LEAVE), "output_leave");
+    assert_string_equal(event_type_name((wayws_event_type_t)999), "unknown");
+}
+
+static size_t pool_free_count(struct wayws_state *s) {
+    size_t n = 0;
+    for (struct pending_event *p = s->pending_pool.free; p; p = p->next)
+        n++;
+    return n;
+}
+
+static void test_pending_events_fifo_order(void **state) {
+    struct wayws_state s = {.event_enabled = 1};
+    struct output out = {.name = "DP-1"};
+    struct group_output go = {.output = &out};
+    struct workspace_group g = {.outputs = NULL};
+    struct ws w = {.name = "ws", .group = &g};
+    
+    add_pending_event(&s, EVENT_WORKSPACE_CREATED, &w, 0, 0, 0, 0, 0, DIR_NONE);
+    add_pending_event(&s, EVENT_WORKSPACE_NAME, &w, 0, 0, 0, 0, 0, DIR_NONE);
+    add_pending_event(&s, EVENT_WORKSPACE_STATE, &w, 0, 0, 1, 0, 0, DIR_NONE);
+    
+    // Nothing goes out while the output is unknown
+    emit_pending_events_for_workspace(&s, &w);
+    assert_int_equal(s.event_out.len, 0);
+    
+    g.outputs = &go;
+    emit_pending_events_for_workspace(&s, &w);
+    captured(&s);
+    char *created = strstr(test_output, "workspace_created");
+    char *name = strstr(test_output, "workspace_name");
+    char *st = strstr(test_output, "workspace_state");
+    assert_non_null(created);
+    assert_non_null(name);
+    assert_non_null(st);
+    assert_true(created < name && name < st);
+    assert_null(w.pending_head);
+    assert_null(w.pending_tail);
+    
+    cleanup_all_pending_events(&s);
+    outbuf_free(&s.event_out);
+}
+
+static void test_pending_pool_recycles_nodes(void **state) {
+    struct wayws_state s = {.event_enabled = 0};
+    struct ws w = {.name = "ws"};
+    
+    for (int i = 0; i < PENDING_CHUNK_SIZE; i++)
+        add_pending_event(&s, EVENT_WORKSPACE_STATE, &w, 0, 0, 0, 0, 0, DIR_NONE);
+    struct pending_chunk *chunk = s.pending_pool.chunks;
+    assert_non_null(chunk);
+    assert_null(chunk->next);
+    assert_int_equal(pool_free_count(&s), 0);
+    
+    cleanup_pending_events_for_workspace(&s, &w);
+    assert_null(w.pending_head);
+    assert_int_equal(pool_free_count(&s), PENDING_CHUNK_SIZE);
+    
+    // Refilling reuses the same chunk instead of allocating
+    for (int i = 0; i < PENDING_CHUNK_SIZE; i++)
+        add_pending_event(&s, EVENT_WORKSPACE_STATE, &w, 0, 0, 0, 0, 0, DIR_NONE);
+    assert_ptr_equal(s.pending_pool.chunks, chunk);
+    assert_null(chunk->next);
+    
+    cleanup_all_pending_events(&s);
+    assert_null(s.pending_pool.chunks);
 }
 
 // Test get_output_name_for_workspace helper
@@ -136,6 +483,19 @@ int main(void) {
         cmocka_unit_test_setup_teardown(test_emit_event_disabled, setup, teardown),
         cmocka_unit_test_setup_teardown(test_emit_event_null_names, setup, teardown),
         cmocka_unit_test_setup_teardown(test_emit_event_exec_command, setup, teardown),
+        cmocka_unit_test_setup_teardown(test_end_event_batch_counts_batches, setup, teardown),
+        cmocka_unit_test_setup_teardown(test_emit_event_escapes_names, setup, teardown),
+        cmocka_unit_test_setup_teardown(test_end_event_batch_writes_queue, setup, teardown),
+        cmocka_unit_test_setup_teardown(test_emit_event_format_template, setup, teardown),
+        cmocka_unit_test_setup_teardown(test_emit_event_format_template_id, setup, teardown),
+        cmocka_unit_test_setup_teardown(test_emit_event_monotonic_timestamp, setup, teardown),
+        cmocka_unit_test_setup_teardown(test_latency_filled_in_on_write, setup, teardown),
+        cmocka_unit_test_setup_teardown(test_backed_up_output_coalesces, setup, teardown),
+        cmocka_unit_test_setup_teardown(test_end_event_batch_runs_exec_once, setup, teardown),
+        cmocka_unit_test_setup_teardown(test_exec_hook_gets_workspace_id, setup, teardown),
+        cmocka_unit_test(test_event_type_name),
+        cmocka_unit_test_setup_teardown(test_pending_events_fifo_order, setup, teardown),
+        cmocka_unit_test_setup_teardown(test_pending_pool_recycles_nodes, setup, teardown),
         cmocka_unit_test(test_get_output_name_for_workspace_valid),
         cmocka_unit_test(test_get_output_name_for_workspace_null_output),
         cmocka_unit_test(test_get_output_name_for_workspace_null_workspace),
@@ -0,0 +1,230 @@
+#include "../exec.h"
+#include <setjmp.h>
+#include <stdarg.h>
+#include <cmocka.h>
+#include <poll.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static char tmpdir[] = "/tmp/wayws-exec-XXXXXX";
+
+static int setup(void **state) {
+  (void)state;
+  return mkdtemp(tmpdir) ? 0 : -1;
+}
+
+static int teardown(void **state) {
+  (void)state;
+  char cmd[64];
+  snprintf(cmd, sizeof cmd, "rm -rf %s", tmpdir);
+  return system(cmd) == 0 ? 0 : -1;
+}
+
+static int request(struct exec_runner *r, const char *cmd) {
+  struct exec_job job = {.cmd = cmd};
+  return exec_request(r, &job);
+}
+
+// Drives the runner the way the main loop does until every hook is done
+static void wait_idle(struct exec_runner *r) {
+  for (int i = 0; i < 100 && (r->running || r->queued); i++) {
+    struct pollfd pfd = {.fd = exec_fd(r), .events = POLLIN};
+    poll(&pfd, 1, 50);
+    exec_reap(r);
+  }
+  assert_int_equal(r->running, 0);
+  assert_null(r->queued);
+}
+
+static int count_lines(const char *path) {
+  FILE *f = fopen(path, "r");
+  if (!f)
+    return 0;
+  int n = 0;
+  for (int c; (c = fgetc(f)) != EOF;)
+    n += c == '\n';
+  fclose(f);
+  return n;
+}
+
+static void test_exec_zeroed_runner(void **state) {
+  (void)state;
+  struct exec_runner r = {0};
+  assert_int_equal(exec_fd(&r), -1);
+  exec_reap(&r);
+  exec_destroy(&r);
+}
+
+static void test_exec_runs_in_background(void **state) {
+  (void)state;
+  struct exec_runner r = {0};
+  char path[64], cmd[128];
+  snprintf(path, sizeof path, "%s/ran", tmpdir);
+  snprintf(cmd, sizeof cmd, "sleep 0.2; echo x >> %s", path);
+
+  assert_int_equal(request(&r, cmd), 0);
+  // The request returns while the hook is still sleeping
+  assert_int_equal(r.running, 1);
+  assert_int_equal(count_lines(path), 0);
+  assert_true(exec_fd(&r) >= 0);
+
+  wait_idle(&r);
+  assert_int_equal(count_lines(path), 1);
+  exec_destroy(&r);
+}
+
+static void test_exec_coalesces_follow_ups(void **state) {
+  (void)state;
+  struct exec_runner r = {.limit = 1};
+  char path[64], cmd[128];
+  snprintf(path, sizeof path, "%s/coalesced", tmpdir);
+  snprintf(cmd, sizeof cmd, "sleep 0.1; echo x >> %s", path);
+
+  for (int i = 0; i < 5; i++)
+    assert_int_equal(request(&r, cmd), 0);
+  assert_int_equal(r.running, 1);
+  assert_non_null(r.queued);
+
+  // One run now plus a single follow-up for the four that piled up
+  wait_idle(&r);
+  assert_int_equal(count_lines(path), 2);
+  exec_destroy(&r);
+}
+
+static void test_exec_coalesces_per_key(void **state) {
+  (void)state;
+  struct exec_runner r = {.limit = 1};
+  char path[64], cmd[128];
+  snprintf(path, sizeof path, "%s/keyed", tmpdir);
+  snprintf(cmd, sizeof cmd, "sleep 0.05; echo x >> %s", path);
+  int a, b;
+  struct exec_job ja = {.cmd = cmd, .key = &a}, jb = {.cmd = cmd, .key = &b};
+
+  assert_int_equal(exec_request(&r, &ja), 0);
+  // Busy: each key keeps its own follow-up
+  for (int i = 0; i < 3; i++) {
+    assert_int_equal(exec_request(&r, &ja), 0);
+    assert_int_equal(exec_request(&r, &jb), 0);
+  }
+  assert_int_equal(r.running, 1);
+
+  // The first run plus one follow-up for each key
+  wait_idle(&r);
+  assert_int_equal(count_lines(path), 3);
+  exec_destroy(&r);
+}
+
+static void test_exec_concurrency_limit(void **state) {
+  (void)state;
+  struct exec_runner r = {.limit = 2};
+  assert_int_equal(request(&r, "sleep 0.1"), 0);
+  assert_int_equal(request(&r, "sleep 0.1"), 0);
+  assert_int_equal(r.running, 2);
+  assert_null(r.queued);
+  assert_int_equal(request(&r, "sleep 0.1"), 0);
+  assert_int_equal(r.running, 2);
+  assert_non_null(r.queued);
+  wait_idle(&r);
+  exec_destroy(&r);
+}
+
+static void test_exec_split(void **state) {
+  (void)state;
+  char **argv = exec_split("  notify-send\t-u  low ");
+  assert_non_null(argv);
+  assert_string_equal(argv[0], "notify-send");
+  assert_string_equal(argv[1], "-u");
+  assert_string_equal(argv[2], "low");
+  assert_null(argv[3]);
+  exec_free_argv(argv);
+  assert_null(exec_split(" \t "));
+}
+
+static void test_exec_direct_with_event_env(void **state) {
+  (void)state;
+  struct exec_runner r = {0};
+  char path[64], script[160];
+  snprintf(path, sizeof path, "%s/env", tmpdir);
+  snprintf(script, sizeof script,
+           "echo \"$WAYWS_EVENT|$WAYWS_NAME|$WAYWS_OUTPUT|$WAYWS_INDEX|"
+           "$WAYWS_ACTIVE|$WAYWS_URGENT\" > %s",
+           path);
+  // Looked up in PATH and started without an outer shell
+  char *argv[] = {"sh", "-c", script, NULL};
+  // An inherited value must not leak through
+  setenv("WAYWS_NAME", "outer", 1);
+  struct tpl_record ev = {
+      .type = "workspace_state",
+      .name = "code",
+      .output = "DP-1",
+      .index = 3,
+      .active = 1,
+  };
+  exec_note(&r, &ev);
+  struct exec_job job = {.argv = argv, .ev = &r.last};
+  assert_int_equal(exec_request(&r, &job), 0);
+  wait_idle(&r);
+  unsetenv("WAYWS_NAME");
+
+  FILE *f = fopen(path, "r");
+  assert_non_null(f);
+  char line[128] = "";
+  assert_non_null(fgets(line, sizeof line, f));
+  fclose(f);
+  assert_string_equal(line, "workspace_state|code|DP-1|3|1|0\n");
+  exec_destroy(&r);
+}
+
+static void test_exec_direct_missing_program(void **state) {
+  (void)state;
+  struct exec_runner r = {0};
+  char *argv[] = {"wayws-no-such-hook", NULL};
+  struct exec_job job = {.argv = argv};
+  assert_int_equal(exec_request(&r, &job), -1);
+  assert_int_equal(r.running, 0);
+  exec_destroy(&r);
+}
+
+static void test_exec_note_reuses_its_buffer(void **state) {
+  (void)state;
+  struct exec_runner r = {0};
+  char name[] = "code";
+  struct tpl_record ev = {.type = "workspace_state", .name = name,
+                          .output = "DP-1", .index = 3};
+  exec_note(&r, &ev);
+  // A copy: the caller's strings may change or go away
+  name[0] = 'x';
+  assert_string_equal(r.last.name, "code");
+  assert_null(r.last.id);
+  char *buf = r.last_buf;
+
+  struct tpl_record next = {.type = "workspace_created", .name = "web",
+                            .id = "ws-2", .output = "HDMI-A-1", .index = 4};
+  exec_note(&r, &next);
+  assert_ptr_equal(r.last_buf, buf);
+  assert_string_equal(r.last.type, "workspace_created");
+  assert_string_equal(r.last.name, "web");
+  assert_string_equal(r.last.id, "ws-2");
+  assert_string_equal(r.last.output, "HDMI-A-1");
+  assert_int_equal(r.last.index, 4);
+  exec_destroy(&r);
+  assert_null(r.last_buf);
+}
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+      cmocka_unit_test(test_exec_zeroed_runner),
+      cmocka_unit_test(test_exec_runs_in_background),
+      cmocka_unit_test(test_exec_coalesces_follow_ups),
+      cmocka_unit_test(test_exec_coalesces_per_key),
+      cmocka_unit_test(test_exec_concurrency_limit),
+      cmocka_unit_test(test_exec_split),
+      cmocka_unit_test(test_exec_direct_with_event_env),
+      cmocka_unit_test(test_exec_direct_missing_program),
+      cmocka_unit_test(test_exec_note_reuses_its_buffer),
+  };
+  return cmocka_run_group_tests(tests, setup, teardown);
+}
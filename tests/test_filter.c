@@ -0,0 +1,93 @@
+#include "../filter.h"
+#include "../event.h"
+#include "../types.h"
+#include <setjmp.h>
+#include <stdarg.h>
+#include <cmocka.h>
+#include <stddef.h>
+#include <string.h>
+
+static void test_filter_empty_accepts_all(void **state) {
+  (void)state;
+  struct event_filter f = {0};
+  assert_true(filter_accepts(&f, EVENT_WORKSPACE_CREATED, NULL, NULL, 0, 0, 0));
+  assert_true(filter_accepts(&f, EVENT_OUTPUT_LEAVE, "ws", "DP-1", 1, 1, 1));
+}
+
+static void test_filter_parse_events(void **state) {
+  (void)state;
+  struct event_filter f = {0};
+  assert_int_equal(filter_parse_events(&f, "state,created"), 0);
+  assert_int_equal(filter_parse_events(&f, "output_enter"), 0);
+  assert_true(filter_accepts(&f, EVENT_WORKSPACE_STATE, "", "", 0, 0, 0));
+  assert_true(filter_accepts(&f, EVENT_WORKSPACE_CREATED, "", "", 0, 0, 0));
+  assert_true(filter_accepts(&f, EVENT_OUTPUT_ENTER, "", "", 0, 0, 0));
+  assert_false(filter_accepts(&f, EVENT_WORKSPACE_NAME, "", "", 0, 0, 0));
+
+  struct event_filter bad = {0};
+  assert_int_equal(filter_parse_events(&bad, "state,bogus"), -1);
+  assert_int_equal(filter_parse_events(&bad, "state,"), -1);
+  assert_int_equal(filter_parse_events(&bad, ""), -1);
+  assert_int_equal(bad.types, 0);
+}
+
+static void test_filter_match_state(void **state) {
+  (void)state;
+  struct event_filter f = {0};
+  assert_int_equal(filter_parse_match(&f, "active=true"), 0);
+  assert_int_equal(filter_parse_match(&f, "urgent=false"), 0);
+  assert_true(filter_accepts(&f, EVENT_WORKSPACE_STATE, "", "", 1, 0, 1));
+  assert_false(filter_accepts(&f, EVENT_WORKSPACE_STATE, "", "", 0, 0, 0));
+  assert_false(filter_accepts(&f, EVENT_WORKSPACE_STATE, "", "", 1, 1, 0));
+
+  // The last value for a key wins
+  assert_int_equal(filter_parse_match(&f, "active=0"), 0);
+  assert_true(filter_accepts(&f, EVENT_WORKSPACE_STATE, "", "", 0, 0, 0));
+
+  assert_int_equal(filter_parse_match(&f, "active=maybe"), -1);
+  assert_int_equal(filter_parse_match(&f, "active"), -1);
+  assert_int_equal(filter_parse_match(&f, "colour=red"), -1);
+}
+
+static void test_filter_match_strings(void **state) {
+  (void)state;
+  struct event_filter f = {0};
+  assert_int_equal(filter_parse_match(&f, "output=DP-1"), 0);
+  assert_true(filter_accepts(&f, EVENT_WORKSPACE_STATE, "1", "DP-1", 0, 0, 0));
+  assert_false(filter_accepts(&f, EVENT_WORKSPACE_STATE, "1", "DP-10", 0, 0, 0));
+  assert_false(filter_accepts(&f, EVENT_WORKSPACE_STATE, "1", NULL, 0, 0, 0));
+  assert_int_equal(filter_parse_match(&f, "name=code"), 0);
+  assert_true(filter_accepts(&f, EVENT_WORKSPACE_STATE, "code", "DP-1", 0, 0, 0));
+  assert_false(filter_accepts(&f, EVENT_WORKSPACE_STATE, "web", "DP-1", 0, 0, 0));
+}
+
+static void test_filter_applied_before_formatting(void **state) {
+  (void)state;
+  struct wayws_state s = {.event_enabled = 1};
+  assert_int_equal(filter_parse_events(&s.event_filter, "state"), 0);
+  assert_int_equal(filter_parse_match(&s.event_filter, "active=true"), 0);
+
+  emit_event(&s, EVENT_WORKSPACE_CREATED, "a", "DP-1", 1, 0, 0, 1, 0, 0,
+             DIR_NONE, NULL);
+  emit_event(&s, EVENT_WORKSPACE_STATE, "b", "DP-1", 2, 0, 0, 0, 0, 0,
+             DIR_NONE, NULL);
+  assert_int_equal(s.event_out.len, 0);
+
+  emit_event(&s, EVENT_WORKSPACE_STATE, "c", "DP-1", 3, 0, 0, 1, 0, 0,
+             DIR_NONE, NULL);
+  assert_true(s.event_out.len > 0);
+  outbuf_putc(&s.event_out, '\0');
+  assert_non_null(strstr(s.event_out.buf, "\"name\":\"c\""));
+  outbuf_free(&s.event_out);
+}
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+      cmocka_unit_test(test_filter_empty_accepts_all),
+      cmocka_unit_test(test_filter_parse_events),
+      cmocka_unit_test(test_filter_match_state),
+      cmocka_unit_test(test_filter_match_strings),
+      cmocka_unit_test(test_filter_applied_before_formatting),
+  };
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,102 @@
+#include "../hash.h"
+#include <setjmp.h>
+#include <stdarg.h>
+#include <cmocka.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+static void test_strmap_put_get(void **state) {
+  (void)state;
+  struct strmap m = {0};
+  int a, b;
+  strmap_put(&m, "one", &a);
+  strmap_put(&m, "two", &b);
+  assert_ptr_equal(strmap_get(&m, "one"), &a);
+  assert_ptr_equal(strmap_get(&m, "two"), &b);
+  assert_null(strmap_get(&m, "three"));
+  assert_int_equal(m.len, 2);
+  strmap_free(&m);
+}
+
+static void test_strmap_overwrite(void **state) {
+  (void)state;
+  struct strmap m = {0};
+  int a, b;
+  strmap_put(&m, "key", &a);
+  strmap_put(&m, "key", &b);
+  assert_ptr_equal(strmap_get(&m, "key"), &b);
+  assert_int_equal(m.len, 1);
+  strmap_free(&m);
+}
+
+static void test_strmap_remove(void **state) {
+  (void)state;
+  struct strmap m = {0};
+  int a;
+  strmap_put(&m, "key", &a);
+  assert_ptr_equal(strmap_remove(&m, "key"), &a);
+  assert_null(strmap_get(&m, "key"));
+  assert_null(strmap_remove(&m, "key"));
+  assert_int_equal(m.len, 0);
+  strmap_free(&m);
+}
+
+static void test_strmap_empty_and_null(void **state) {
+  (void)state;
+  struct strmap m = {0};
+  assert_null(strmap_get(&m, "x"));
+  assert_null(strmap_get(&m, NULL));
+  assert_null(strmap_remove(&m, "x"));
+  strmap_free(&m);
+}
+
+static void test_strmap_grow_and_churn(void **state) {
+  (void)state;
+  struct strmap m = {0};
+  static char keys[1000][8];
+  for (int i = 0; i < 1000; i++) {
+    snprintf(keys[i], sizeof keys[i], "ws%d", i);
+    strmap_put(&m, keys[i], keys[i]);
+  }
+  // Remove and re-add repeatedly so tombstones pile up and get purged.
+  for (int round = 0; round < 20; round++)
+    for (int i = 0; i < 1000; i += 2) {
+      assert_ptr_equal(strmap_remove(&m, keys[i]), keys[i]);
+      strmap_put(&m, keys[i], keys[i]);
+    }
+  assert_int_equal(m.len, 1000);
+  for (int i = 0; i < 1000; i++)
+    assert_ptr_equal(strmap_get(&m, keys[i]), keys[i]);
+  assert_true(m.used < m.cap);
+  strmap_free(&m);
+}
+
+static void test_strintern_ids(void **state) {
+  (void)state;
+  struct strintern t = {0};
+  uint32_t dp1 = strintern_id(&t, "DP-1");
+  uint32_t dp2 = strintern_id(&t, "DP-2");
+  assert_int_equal(dp1, 1);
+  assert_int_equal(dp2, 2);
+  assert_int_equal(strintern_id(&t, "DP-1"), dp1);
+  assert_int_equal(strintern_find(&t, "DP-2"), dp2);
+  assert_int_equal(strintern_find(&t, "HDMI-A-1"), 0);
+  assert_int_equal(strintern_id(&t, NULL), 0);
+  assert_string_equal(strintern_str(&t, dp2), "DP-2");
+  assert_null(strintern_str(&t, 0));
+  assert_null(strintern_str(&t, 3));
+  strintern_free(&t);
+}
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+      cmocka_unit_test(test_strmap_put_get),
+      cmocka_unit_test(test_strmap_overwrite),
+      cmocka_unit_test(test_strmap_remove),
+      cmocka_unit_test(test_strmap_empty_and_null),
+      cmocka_unit_test(test_strmap_grow_and_churn),
+      cmocka_unit_test(test_strintern_ids),
+  };
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
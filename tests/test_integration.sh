@@ -104,15 +104,79 @@ run_test "Event system flag parsing" "./wayws --help | grep -q 'watch.*JSON even
 # Test 17: Exec command flag parsing (test CLI parsing, not actual connection)
 run_test "Exec command flag parsing" "./wayws --help | grep -q 'exec.*CMD'"
 
-# Test 18: Invalid workspace index
+# Test 18: Daemon flag parsing (test CLI parsing, not actual connection)
+run_test "Daemon flag parsing" "./wayws --help | grep -q 'daemon'"
+
+# Test 19: Without a daemon socket the command falls back to a direct connection
+run_test_fail "Daemon fallback without socket" "XDG_RUNTIME_DIR=/nonexistent WAYLAND_DISPLAY=wayws-none ./wayws 1"
+
+# Test 20: Invalid workspace index
 run_test_fail "Invalid workspace index" "./wayws -1"
 
-# Test 19: Large workspace index
+# Test 21: Large workspace index
 run_test_fail "Large workspace index" "./wayws 999999"
 
-# Test 20: Empty workspace name
+# Test 22: Empty workspace name
 run_test_fail "Empty workspace name" "./wayws ''"
 
+# Test 23: Unknown event type in --events
+run_test_fail "Unknown event type" "./wayws -w --events state,bogus"
+
+# Test 24: Malformed --match predicate
+run_test_fail "Malformed match predicate" "./wayws -w --match active=maybe"
+
+# Test 25: Event filters need watch mode
+run_test_fail "Event filter without watch" "./wayws -l --events state"
+
+# Test 26: Unknown field in --format
+run_test_fail "Invalid format template" "./wayws -l --format '{name} {bogus}'"
+
+# Test 27: --exec-direct needs a command
+run_test_fail "Direct exec without command" "./wayws -l --exec-direct"
+
+# Test 28: Rules need watch or daemon mode
+run_test_fail "Rules without watch" "./wayws -l --rules /dev/null"
+
+# Test 29: Unreadable rules file
+run_test_fail "Missing rules file" "./wayws -w --rules /nonexistent/wayws.rules"
+
+# Test 30: --signal needs NAME:SIG
+run_test_fail "Signal without a signal" "./wayws -w --signal waybar"
+run_test_fail "Signal with a bad signal" "./wayws -w --signal waybar:NOPE"
+
+# Test 31: --signal needs watch mode
+run_test_fail "Signal without watch" "./wayws -l --signal waybar:USR1"
+
+# Test 32: --latency needs watch mode JSON events
+run_test_fail "Latency without watch" "./wayws -l --latency"
+run_test_fail "Latency with a format" "./wayws -w --latency --format '{name}'"
+
+# Test 33: --wait needs a switch and a positive timeout
+run_test_fail "Wait without a switch" "./wayws --wait"
+run_test_fail "Wait with a bad timeout" "./wayws --wait=0 2"
+
+# Test 34: --bench-activate picks its own targets
+run_test_fail "Benchmark with zero switches" "./wayws --bench-activate 0"
+run_test_fail "Benchmark with a switch" "./wayws --bench-activate 5 2"
+
+# Test 35: --serve takes no command; filters belong to each watcher
+run_test_fail "Serve with a listing" "./wayws --serve -l"
+run_test_fail "Serve with a filter" "./wayws --serve --events state"
+
+# Test 36: --from-shm only reads listings, and fails without a publisher
+run_test_fail "Snapshot without a listing" "./wayws --from-shm"
+run_test_fail "Snapshot with a switch" "./wayws --from-shm --json 2"
+run_test_fail "Snapshot without a publisher" \
+    "XDG_RUNTIME_DIR=/nonexistent ./wayws --from-shm --json"
+
+# Test 37: --stats reports on watch mode's output queue
+run_test_fail "Stats without watch" "./wayws --stats -l"
+
+# Test 38: --subscribe is for plain JSON watchers only
+run_test_fail "Subscribe without watch" "./wayws --subscribe -l"
+run_test_fail "Subscribe with a format" "./wayws -w --subscribe --format '{name}'"
+run_test_fail "Subscribe without a daemon" "./wayws -w --subscribe --no-daemon"
+
 echo ""
 echo "=================================="
 echo "Integration test results:"
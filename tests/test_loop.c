@@ -0,0 +1,92 @@
+#define _GNU_SOURCE
+
+#include "../loop.h"
+#include <setjmp.h>
+#include <stdarg.h>
+#include <cmocka.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static void count(struct loop_source *src, uint32_t events) {
+  (void)events;
+  (*(int *)src->data)++;
+}
+
+static void test_loop_runs_ready_sources(void **state) {
+  (void)state;
+  struct loop l;
+  assert_int_equal(loop_init(&l), 0);
+  int fds[2], hits = 0;
+  assert_int_equal(pipe(fds), 0);
+  struct loop_source src = {.fd = fds[0], .fn = count, .data = &hits};
+  assert_int_equal(loop_add(&l, &src, EPOLLIN), 0);
+
+  // Nothing ready: the wait times out
+  assert_int_equal(loop_dispatch(&l, 0), 0);
+  assert_int_equal(hits, 0);
+  assert_int_equal(write(fds[1], "x", 1), 1);
+  assert_int_equal(loop_dispatch(&l, -1), 1);
+  assert_int_equal(hits, 1);
+
+  // Gone from the set, though the fd stays ours and readable
+  loop_remove(&l, &src);
+  assert_int_equal(loop_dispatch(&l, 0), 0);
+  assert_int_equal(src.fd, fds[0]);
+  loop_destroy(&l);
+  close(fds[0]);
+  close(fds[1]);
+}
+
+struct seen {
+  int sigs[4];
+  int n;
+};
+
+static void collect(struct loop_source *src, uint32_t events) {
+  (void)events;
+  struct seen *s = src->data;
+  for (int sig; (sig = loop_signal(src)) > 0;)
+    if (s->n < 4)
+      s->sigs[s->n++] = sig;
+}
+
+static void test_loop_takes_signals_through_the_loop(void **state) {
+  (void)state;
+  struct loop l;
+  assert_int_equal(loop_init(&l), 0);
+  struct seen seen = {0};
+  struct loop_source sig = {.fn = collect, .data = &seen};
+  sigset_t set;
+  sigemptyset(&set);
+  sigaddset(&set, SIGUSR1);
+  sigaddset(&set, SIGUSR2);
+  assert_int_equal(loop_add_signals(&l, &sig, &set), 0);
+
+  // Blocked, so no handler runs (SIGUSR1 would end the test run); the
+  // signals wait for the next dispatch
+  raise(SIGUSR1);
+  raise(SIGUSR2);
+  assert_int_equal(loop_dispatch(&l, -1), 1);
+  assert_int_equal(seen.n, 2);
+  assert_int_equal(seen.sigs[0] + seen.sigs[1], SIGUSR1 + SIGUSR2);
+
+  // One signal source per loop
+  struct loop_source again = {.fn = collect, .data = &seen};
+  assert_int_equal(loop_add_signals(&l, &again, &set), -1);
+
+  loop_destroy(&l);
+  sigset_t mask;
+  pthread_sigmask(SIG_SETMASK, NULL, &mask);
+  assert_false(sigismember(&mask, SIGUSR1));
+}
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+      cmocka_unit_test(test_loop_runs_ready_sources),
+      cmocka_unit_test(test_loop_takes_signals_through_the_loop),
+  };
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,316 @@
+#!/bin/bash
+
+# End-to-end tests for wayws against tests/mock_compositor.c
+# Everything runs headless: the mock serves its own Wayland socket in a
+# private XDG_RUNTIME_DIR, so no compositor (and no daemon) of the user's
+# session is touched.
+
+# Colors for output
+RED='\033[0;31m'
+GREEN='\033[0;32m'
+NC='\033[0m' # No Color
+
+TESTS_PASSED=0
+TESTS_FAILED=0
+
+for bin in ./wayws ./mock_compositor; do
+    if [ ! -x "$bin" ]; then
+        echo -e "${RED}Error: $bin not found. Run 'make wayws mock_compositor' first.${NC}"
+        exit 1
+    fi
+done
+
+MOCK_RUNTIME=$(mktemp -d)
+export XDG_RUNTIME_DIR="$MOCK_RUNTIME"
+export WAYLAND_DISPLAY=wayws-mock
+MOCK_PID=
+DAEMON_PID=
+
+pass() {
+    echo -e "${GREEN}PASS${NC}"
+    ((TESTS_PASSED++))
+}
+
+fail() {
+    echo -e "${RED}FAIL${NC} ($1)"
+    ((TESTS_FAILED++))
+}
+
+# start_mock [mock options]: starts the compositor and waits for its socket
+start_mock() {
+    ./mock_compositor --socket "$WAYLAND_DISPLAY" "$@" >/dev/null &
+    MOCK_PID=$!
+    for ((i = 0; i < 100; i++)); do
+        [ -S "$XDG_RUNTIME_DIR/$WAYLAND_DISPLAY" ] && return 0
+        sleep 0.02
+    done
+    echo -e "${RED}Error: mock compositor did not start.${NC}"
+    exit 1
+}
+
+stop_mock() {
+    if [ -n "$MOCK_PID" ]; then
+        kill "$MOCK_PID" 2>/dev/null
+        wait "$MOCK_PID" 2>/dev/null
+        MOCK_PID=
+    fi
+}
+
+# with_script LINES [mock options]: restarts the mock running a script
+with_script() {
+    local script="$MOCK_RUNTIME/script"
+    printf '%s\n' "$1" >"$script"
+    shift
+    stop_mock
+    start_mock --script "$script" "$@"
+}
+
+cleanup() {
+    [ -n "$DAEMON_PID" ] && kill "$DAEMON_PID" 2>/dev/null
+    stop_mock
+    rm -rf "$MOCK_RUNTIME"
+}
+trap cleanup EXIT
+
+# run_test NAME COMMAND [EXIT_CODE]
+run_test() {
+    echo -n "Running test: $1... "
+    eval "$2" >/dev/null 2>&1
+    local exit_code=$?
+    if [ $exit_code -eq "${3:-0}" ]; then
+        pass
+    else
+        fail "expected exit code ${3:-0}, got $exit_code"
+    fi
+}
+
+# check_output NAME COMMAND EXPECTED: COMMAND must succeed and print EXPECTED
+check_output() {
+    echo -n "Running test: $1... "
+    local out
+    out=$(eval "$2" 2>&1)
+    local exit_code=$?
+    if [ $exit_code -ne 0 ]; then
+        fail "exit code $exit_code: $out"
+    elif [ "$out" != "$3" ]; then
+        fail "got '$(echo "$out" | tr '\n' '|')'"
+    else
+        pass
+    fi
+}
+
+echo "Starting wayws tests against the mock compositor..."
+echo "=================================="
+
+start_mock --outputs 2 --workspaces 3
+
+# Test 1: Initial state, topology and output names
+check_output "List workspaces" "./wayws -l --format '{index} {output} {name} {active}'" \
+"1 MOCK-1 1 true
+2 MOCK-1 2 false
+3 MOCK-1 3 false
+4 MOCK-2 4 true
+5 MOCK-2 5 false
+6 MOCK-2 6 false"
+
+# Test 2: Other one-shot outputs
+run_test "JSON output" "./wayws --json | grep -q '\"id\":\"mock-6\"'"
+run_test "Waybar output" "./wayws --waybar --output MOCK-2"
+run_test "Waybar unknown output" "./wayws --waybar --output MOCK-9" 1
+run_test "Debug info" "./wayws --debug-info"
+
+# Test 3: Activation is confirmed with --wait and visible to the next command
+run_test "Activate by index" "./wayws --wait 2"
+check_output "Active after index" "./wayws -l --format '{name} {active}' | grep true" \
+"2 true
+4 true"
+run_test "Activate by id" "./wayws --wait --id mock-6"
+run_test "Activate to the right" "./wayws --wait --right --output MOCK-1"
+check_output "Active after moves" "./wayws -l --format '{name} {active}' | grep true" \
+"3 true
+6 true"
+run_test "Missing workspace" "./wayws --wait 9" 1
+
+# Test 4: --bench-activate reports on every switch
+check_output "Activation benchmark" "./wayws --bench-activate 20 | head -1" "activations 20"
+
+# Test 5: --wait honours its timeout against a slow compositor
+stop_mock
+start_mock --delay 300
+run_test "Wait times out" "./wayws --wait=100 2" 1
+run_test "Wait outlasts the delay" "./wayws --wait=3000 3"
+
+# Test 6: Every activation of a burst arrives, and nothing else
+with_script "wait-client
+burst 10
+sleep 100
+quit"
+check_output "Watch an activation burst" \
+    "timeout 10 ./wayws -w --events state --match active=true | wc -l" "12"
+
+# Test 7: Bursts batched several per done event, with latencies (the
+# initial state, read before the watch loop, has none)
+with_script "wait-client
+sleep 200
+burst 4 2
+sleep 100
+quit"
+check_output "Latency on batched events" \
+    "timeout 10 ./wayws -w --latency --events state | grep -c latency_ns" "8"
+
+# Test 8: Renames, state flags and workspace creation reach watch mode
+with_script "wait-client
+rename 2 mail
+urgent 5 1
+add 1 scratch
+sleep 100
+quit"
+check_output "Watch rename, urgent and add" \
+    "timeout 10 ./wayws -w --events name,state --format '{type} {name} {urgent}' | tail -4" \
+"workspace_name mail false
+workspace_state 5 true
+workspace_name scratch false
+workspace_state scratch false"
+
+# Test 9: An output going away
+with_script "wait-client
+unplug 2
+sleep 100
+quit"
+check_output "Watch an output unplug" \
+    "timeout 10 ./wayws -w --events output_leave --format '{type} {output}'" \
+    "output_leave MOCK-2"
+# output_leave after global_remove names a wl_output we already destroyed
+with_script "wait-client
+unplug-late 2
+activate 2
+sleep 100
+quit"
+check_output "Watch a late output_leave" \
+    "timeout 10 ./wayws -w --events state --match name=2 --format '{type} {name} {active}' | tail -1" \
+    "workspace_state 2 true"
+
+# Test 10: A workspace removed while --wait is pending
+with_script "wait-client
+sleep 100
+remove 3" --delay 1000
+run_test "Wait for a removed workspace" "./wayws --wait=3000 3" 1
+
+# Test 11: Commands forwarded to a daemon
+stop_mock
+start_mock
+./wayws --daemon >/dev/null 2>&1 &
+DAEMON_PID=$!
+for ((i = 0; i < 100; i++)); do
+    [ -S "$XDG_RUNTIME_DIR/wayws-$WAYLAND_DISPLAY.sock" ] && break
+    sleep 0.02
+done
+run_test "Daemon activation" "./wayws --wait 3"
+check_output "Daemon listing" "./wayws -l --format '{name} {active}' | grep true" \
+"3 true
+4 true"
+kill "$DAEMON_PID" 2>/dev/null
+wait "$DAEMON_PID" 2>/dev/null
+DAEMON_PID=
+
+# Test 12: Watchers share the connection of an event server, each with its
+# own filter, when they subscribe. A plain -w still connects directly and
+# prints the initial names.
+with_script "wait-client
+sleep 800
+activate 2
+rename 5 chat
+sleep 200
+quit"
+./wayws --serve >/dev/null 2>&1 &
+DAEMON_PID=$!
+for ((i = 0; i < 100; i++)); do
+    [ -S "$XDG_RUNTIME_DIR/wayws-$WAYLAND_DISPLAY.events.sock" ] && break
+    sleep 0.02
+done
+./wayws -w --subscribe --events state --match active=true \
+    >"$MOCK_RUNTIME/active" 2>/dev/null &
+./wayws -w --subscribe --events name >"$MOCK_RUNTIME/names" 2>/dev/null &
+./wayws -w --events name >"$MOCK_RUNTIME/direct" 2>/dev/null &
+wait "$DAEMON_PID" 2>/dev/null
+DAEMON_PID=
+sleep 0.2
+check_output "Served state subscriber" \
+    "grep -o '\"name\":\"[^\"]*\"' '$MOCK_RUNTIME/active' | cut -d'\"' -f4 | paste -sd' '" \
+    "1 4 2"
+check_output "Served name subscriber" \
+    "grep -o '\"name\":\"[^\"]*\"' '$MOCK_RUNTIME/names' | cut -d'\"' -f4" \
+    "chat"
+check_output "Plain watcher beside a server" \
+    "grep -o '\"name\":\"[^\"]*\"' '$MOCK_RUNTIME/direct' | cut -d'\"' -f4 | sed -n '1p;\$p' | paste -sd' '" \
+    "1 chat"
+
+# Test 13: Readers of the published snapshot see what a connection would,
+# including later switches, and nothing once the publisher is gone
+stop_mock
+start_mock
+./wayws --daemon >/dev/null 2>&1 &
+DAEMON_PID=$!
+for ((i = 0; i < 100; i++)); do
+    ./wayws --from-shm --json >/dev/null 2>&1 && break
+    sleep 0.02
+done
+strip_groups() { sed 's/"group_handle":"[^"]*"//g'; }
+check_output "Snapshot JSON" "./wayws --from-shm --json | strip_groups" \
+    "$(./wayws --no-daemon --json | strip_groups)"
+./wayws --wait 2 >/dev/null 2>&1
+check_output "Snapshot after a switch" \
+    "./wayws --from-shm -l --format '{name} {output} {active}' | grep true" \
+"2 MOCK-1 true
+4 MOCK-2 true"
+kill "$DAEMON_PID" 2>/dev/null
+wait "$DAEMON_PID" 2>/dev/null
+DAEMON_PID=
+run_test "Snapshot without a publisher" "./wayws --from-shm --json" 1
+
+# Test 14: A watcher whose reader stalls keeps dispatching: once the output
+# queue backs up, the burst's state changes collapse to the latest per
+# workspace instead of queueing, and nothing is dropped
+with_script "wait-client
+burst 2000
+sleep 300
+quit"
+mkfifo "$MOCK_RUNTIME/stalled"
+(sleep 1; cat >/dev/null) <"$MOCK_RUNTIME/stalled" &
+check_output "Stalled reader" \
+    "timeout 10 ./wayws -w --stats 2>&1 >'$MOCK_RUNTIME/stalled' |
+     grep -o 'dropped 0 lines, coalesced [0-9]*' | awk '{ print (\$5 > 0) }'" \
+    "1"
+
+# Test 15: An idle watcher sleeps until something happens, instead of
+# waking up on a timer to look for signals; SIGTERM still ends it at once
+with_script "wait-client
+sleep 3000
+quit"
+idle_wakeups() {
+    ./wayws -w --stats >/dev/null 2>&1 &
+    local pid=$! before after
+    sleep 0.5
+    before=$(awk '/^voluntary_ctxt_switches/ { print $2 }' "/proc/$pid/status")
+    sleep 1
+    after=$(awk '/^voluntary_ctxt_switches/ { print $2 }' "/proc/$pid/status")
+    kill -TERM "$pid"
+    timeout 2 tail --pid="$pid" -f /dev/null || return 1
+    echo $((after - before))
+}
+check_output "Idle watcher sleeps" "idle_wakeups" "0"
+
+echo ""
+echo "=================================="
+echo "Mock compositor test results:"
+echo -e "${GREEN}Passed: $TESTS_PASSED${NC}"
+echo -e "${RED}Failed: $TESTS_FAILED${NC}"
+echo "Total: $((TESTS_PASSED + TESTS_FAILED))"
+
+if [ $TESTS_FAILED -eq 0 ]; then
+    echo -e "${GREEN}All mock compositor tests passed!${NC}"
+    exit 0
+else
+    echo -e "${RED}Some mock compositor tests failed!${NC}"
+    exit 1
+fi
@@ -0,0 +1,113 @@
+#include "../outbuf.h"
+#include <setjmp.h>
+#include <stdarg.h>
+#include <cmocka.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+static const char *str_of(struct outbuf *b) {
+  outbuf_putc(b, '\0');
+  b->len--;
+  return b->buf;
+}
+
+static void test_outbuf_numbers(void **state) {
+  (void)state;
+  struct outbuf b = {0};
+  outbuf_put_int(&b, 0);
+  outbuf_putc(&b, ' ');
+  outbuf_put_int(&b, -42);
+  outbuf_putc(&b, ' ');
+  outbuf_put_int(&b, INT64_MIN);
+  outbuf_putc(&b, ' ');
+  outbuf_put_uint(&b, UINT64_MAX);
+  outbuf_putc(&b, ' ');
+  outbuf_put_hex(&b, 0xbeef);
+  outbuf_putc(&b, ' ');
+  outbuf_put_bool(&b, 2);
+  outbuf_put_bool(&b, 0);
+  assert_string_equal(str_of(&b),
+                      "0 -42 -9223372036854775808 18446744073709551615 "
+                      "0xbeef truefalse");
+  outbuf_free(&b);
+}
+
+static void test_outbuf_json_plain(void **state) {
+  (void)state;
+  struct outbuf b = {0};
+  outbuf_put_json_string(&b, NULL);
+  outbuf_put_json_string(&b, "");
+  // Longer than a word, with UTF-8 that must pass through untouched
+  outbuf_put_json_string(&b, "workspace-éü-12345678");
+  assert_string_equal(str_of(&b), "\"\"\"\"\"workspace-éü-12345678\"");
+  outbuf_free(&b);
+}
+
+static void test_outbuf_json_escapes(void **state) {
+  (void)state;
+  struct outbuf b = {0};
+  outbuf_put_json_string(&b, "a\"b\\c\nd\te\x01\x1f");
+  assert_string_equal(str_of(&b), "\"a\\\"b\\\\c\\nd\\te\\u0001\\u001f\"");
+  outbuf_free(&b);
+}
+
+static void test_outbuf_json_escape_every_lane(void **state) {
+  (void)state;
+  // A quote in each position of a 16-byte string hits every word lane
+  for (size_t pos = 0; pos < 16; pos++) {
+    char in[17];
+    char want[20];
+    memset(in, 'x', 16);
+    in[16] = '\0';
+    in[pos] = '"';
+    size_t k = 0;
+    want[k++] = '"';
+    for (size_t i = 0; i < 16; i++) {
+      if (i == pos)
+        want[k++] = '\\';
+      want[k++] = in[i];
+    }
+    want[k++] = '"';
+    want[k] = '\0';
+    struct outbuf b = {0};
+    outbuf_put_json_string(&b, in);
+    assert_string_equal(str_of(&b), want);
+    outbuf_free(&b);
+  }
+}
+
+static void test_outbuf_flush(void **state) {
+  (void)state;
+  struct outbuf b = {0};
+  for (int i = 0; i < 2000; i++)
+    outbuf_lit(&b, "0123456789");
+  assert_true(b.cap >= 20000);
+  int fds[2];
+  assert_int_equal(pipe(fds), 0);
+  // 20000 bytes fits in the pipe, so this write cannot block
+  assert_int_equal(outbuf_flush(&b, fds[1]), 0);
+  assert_int_equal(b.len, 0);
+  char buf[32];
+  assert_int_equal(read(fds[0], buf, 10), 10);
+  assert_memory_equal(buf, "0123456789", 10);
+  close(fds[0]);
+  close(fds[1]);
+  assert_int_equal(outbuf_flush(&b, -1), 0); // nothing to write
+  outbuf_lit(&b, "x");
+  assert_int_equal(outbuf_flush(&b, -1), -1);
+  assert_int_equal(b.len, 0);
+  outbuf_free(&b);
+}
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+      cmocka_unit_test(test_outbuf_numbers),
+      cmocka_unit_test(test_outbuf_json_plain),
+      cmocka_unit_test(test_outbuf_json_escapes),
+      cmocka_unit_test(test_outbuf_json_escape_every_lane),
+      cmocka_unit_test(test_outbuf_flush),
+  };
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
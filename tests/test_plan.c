@@ -0,0 +1,76 @@
+#include "../plan.h"
+#include "../types.h"
+#include <setjmp.h>
+#include <stdarg.h>
+#include <cmocka.h>
+#include <stddef.h>
+
+static void test_plan_index_needs_only_handles(void **state) {
+  (void)state;
+  struct wayws_state s = {.want_idx = 2};
+  assert_int_equal(startup_plan(&s), 0);
+}
+
+static void test_plan_name_needs_workspace_events(void **state) {
+  (void)state;
+  struct wayws_state s = {.want_idx = -1, .want_name = "code"};
+  assert_int_equal(startup_plan(&s), NEED_WS_EVENTS);
+}
+
+static void test_plan_direction_needs_groups(void **state) {
+  (void)state;
+  struct wayws_state s = {.want_idx = -1, .move_dir = DIR_RIGHT};
+  assert_int_equal(startup_plan(&s), NEED_GROUPS | NEED_WS_EVENTS);
+}
+
+static void test_plan_output_filter_needs_outputs(void **state) {
+  (void)state;
+  struct wayws_state s = {
+      .want_idx = -1, .move_dir = DIR_LEFT, .opt_output_name = "DP-1"};
+  assert_int_equal(startup_plan(&s), NEED_ALL);
+}
+
+static void test_plan_wait_needs_workspace_events(void **state) {
+  (void)state;
+  struct wayws_state wait = {.want_idx = 2, .wait_ms = 500};
+  struct wayws_state bench = {.want_idx = -1, .bench_activations = 10};
+  assert_int_equal(startup_plan(&wait), NEED_WS_EVENTS);
+  assert_int_equal(startup_plan(&bench), NEED_WS_EVENTS);
+}
+
+static void test_plan_exec_needs_everything(void **state) {
+  (void)state;
+  struct wayws_state s = {.want_idx = 2, .opt_exec = "notify-send x"};
+  assert_int_equal(startup_plan(&s), NEED_ALL);
+}
+
+static void test_plan_listing_modes_need_everything(void **state) {
+  (void)state;
+  struct wayws_state list = {.flag_list = 1};
+  struct wayws_state watch = {.flag_watch = 1};
+  struct wayws_state json = {.flag_json = 1};
+  struct wayws_state waybar = {.flag_waybar = 1};
+  struct wayws_state daemon = {.flag_daemon = 1};
+  struct wayws_state serve = {.flag_serve = 1};
+  struct wayws_state debug = {.flag_debug = 1};
+  assert_int_equal(startup_plan(&list), NEED_ALL);
+  assert_int_equal(startup_plan(&watch), NEED_ALL);
+  assert_int_equal(startup_plan(&json), NEED_ALL);
+  assert_int_equal(startup_plan(&waybar), NEED_ALL);
+  assert_int_equal(startup_plan(&daemon), NEED_ALL);
+  assert_int_equal(startup_plan(&serve), NEED_ALL);
+  assert_int_equal(startup_plan(&debug), NEED_ALL);
+}
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+      cmocka_unit_test(test_plan_index_needs_only_handles),
+      cmocka_unit_test(test_plan_name_needs_workspace_events),
+      cmocka_unit_test(test_plan_direction_needs_groups),
+      cmocka_unit_test(test_plan_output_filter_needs_outputs),
+      cmocka_unit_test(test_plan_wait_needs_workspace_events),
+      cmocka_unit_test(test_plan_exec_needs_everything),
+      cmocka_unit_test(test_plan_listing_modes_need_everything),
+  };
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
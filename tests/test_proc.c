@@ -0,0 +1,166 @@
+#define _GNU_SOURCE
+
+#include "../proc.h"
+#include <setjmp.h>
+#include <stdarg.h>
+#include <cmocka.h>
+#include <signal.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static int report_fd;
+
+static void on_usr1(int sig) {
+  (void)sig;
+  if (write(report_fd, "s", 1) != 1)
+    _exit(1);
+}
+
+// Forks a child called name that writes one byte to *rfd per SIGUSR1
+static pid_t spawn_named(const char *name, int *rfd) {
+  int p[2];
+  assert_int_equal(pipe(p), 0);
+  pid_t pid = fork();
+  assert_true(pid >= 0);
+  if (pid == 0) {
+    close(p[0]);
+    report_fd = p[1];
+    signal(SIGUSR1, on_usr1);
+    prctl(PR_SET_NAME, name);
+    if (write(p[1], "r", 1) != 1)
+      _exit(1);
+    for (;;)
+      pause();
+  }
+  close(p[1]);
+  char c;
+  assert_int_equal(read(p[0], &c, 1), 1);
+  assert_int_equal(c, 'r');
+  *rfd = p[0];
+  return pid;
+}
+
+static void expect_signalled(int rfd) {
+  char c;
+  assert_int_equal(read(rfd, &c, 1), 1);
+  assert_int_equal(c, 's');
+}
+
+static void reap(pid_t pid, int rfd) {
+  kill(pid, SIGKILL);
+  waitpid(pid, NULL, 0);
+  close(rfd);
+}
+
+static void test_proc_parse_signal(void **state) {
+  (void)state;
+  assert_int_equal(proc_parse_signal("USR1"), SIGUSR1);
+  assert_int_equal(proc_parse_signal("sigterm"), SIGTERM);
+  assert_int_equal(proc_parse_signal("9"), 9);
+  assert_int_equal(proc_parse_signal("RTMIN"), SIGRTMIN);
+  assert_int_equal(proc_parse_signal("SIGRTMIN+2"), SIGRTMIN + 2);
+  assert_int_equal(proc_parse_signal("RTMAX-1"), SIGRTMAX - 1);
+  assert_int_equal(proc_parse_signal("RTMIN-1"), -1);
+  assert_int_equal(proc_parse_signal("RTMIN+999"), -1);
+  assert_int_equal(proc_parse_signal("NOPE"), -1);
+}
+
+static void test_proc_target_parse(void **state) {
+  (void)state;
+  struct proc_target t;
+  assert_int_equal(proc_target_parse(&t, "waybar:RTMIN+1"), 0);
+  assert_string_equal(t.name, "waybar");
+  assert_int_equal(t.sig, SIGRTMIN + 1);
+  assert_int_equal(t.n, 0);
+  proc_target_close(&t);
+  // The signal is after the last colon
+  assert_int_equal(proc_target_parse(&t, "a:b:USR1"), 0);
+  assert_string_equal(t.name, "a:b");
+  proc_target_close(&t);
+
+  assert_int_equal(proc_target_parse(&t, "waybar"), -1);
+  assert_int_equal(proc_target_parse(&t, ":USR1"), -1);
+  assert_int_equal(proc_target_parse(&t, "waybar:NOPE"), -1);
+  assert_int_equal(proc_target_parse(&t, "waybar:"), -1);
+}
+
+static void test_proc_target_caches_and_follows_restarts(void **state) {
+  (void)state;
+  int rfd;
+  pid_t pid = spawn_named("wayws-ptest", &rfd);
+  struct proc_target t;
+  proc_target_init(&t, "wayws-ptest", SIGUSR1);
+
+  assert_int_equal(proc_target_signal(&t), 1);
+  expect_signalled(rfd);
+  assert_int_equal(t.n, 1);
+  assert_int_equal(t.pids[0], pid);
+  // Second send goes to the cached process
+  assert_int_equal(proc_target_signal(&t), 1);
+  expect_signalled(rfd);
+  assert_int_equal(t.pids[0], pid);
+
+  // Restarted under a new pid: the stale entry is dropped and the name is
+  // looked up again
+  reap(pid, rfd);
+  pid = spawn_named("wayws-ptest", &rfd);
+  assert_int_equal(proc_target_signal(&t), 1);
+  expect_signalled(rfd);
+  assert_int_equal(t.n, 1);
+  assert_int_equal(t.pids[0], pid);
+
+  reap(pid, rfd);
+  proc_target_close(&t);
+}
+
+static void test_proc_target_without_process(void **state) {
+  (void)state;
+  struct proc_target t;
+  proc_target_init(&t, "wayws-nobody", SIGUSR1);
+  assert_int_equal(proc_target_signal(&t), 0);
+  assert_int_equal(t.n, 0);
+  proc_target_close(&t);
+  // Closing twice, or a zeroed target, is harmless
+  proc_target_close(&t);
+  struct proc_target z = {0};
+  proc_target_close(&z);
+}
+
+static void test_proc_target_rescans_at_most_once_a_second(void **state) {
+  (void)state;
+  struct proc_target t;
+  proc_target_init(&t, "wayws-ptlate", SIGUSR1);
+  assert_int_equal(proc_target_signal(&t), 0);
+  assert_true(t.rescan_ns > 0);
+
+  // Started right after the empty scan: not looked for again yet
+  int rfd;
+  pid_t pid = spawn_named("wayws-ptlate", &rfd);
+  assert_int_equal(proc_target_signal(&t), 0);
+  assert_int_equal(t.n, 0);
+
+  // As if PROC_RESCAN_MS had passed
+  t.rescan_ns = 1;
+  assert_int_equal(proc_target_signal(&t), 1);
+  expect_signalled(rfd);
+  assert_int_equal(t.pids[0], pid);
+  assert_int_equal(t.rescan_ns, 0);
+
+  reap(pid, rfd);
+  proc_target_close(&t);
+}
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+      cmocka_unit_test(test_proc_parse_signal),
+      cmocka_unit_test(test_proc_target_parse),
+      cmocka_unit_test(test_proc_target_caches_and_follows_restarts),
+      cmocka_unit_test(test_proc_target_without_process),
+      cmocka_unit_test(test_proc_target_rescans_at_most_once_a_second),
+  };
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,200 @@
+#define _GNU_SOURCE
+
+#include "../rules.h"
+#include "../exec.h"
+#include "../types.h"
+#include <setjmp.h>
+#include <stdarg.h>
+#include <cmocka.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/prctl.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static const struct tpl_record active_ev = {
+    .type = "workspace_state",
+    .name = "web",
+    .output = "DP-1",
+    .index = 2,
+    .active = 1,
+};
+
+static void test_rules_parse_and_dispatch_table(void **state) {
+  (void)state;
+  char err[128];
+  struct rule_set *rs = rules_parse(
+      "# bar refresh\n"
+      "\n"
+      "type=state active=true output=DP-1  signal waybar RTMIN+1\n"
+      "  urgent=true exec notify-send \"$WAYWS_NAME\" urgent\n"
+      "type=created,destroyed fifo /tmp/x.fifo\n"
+      "type=state name=web activate 3\n",
+      err, sizeof err);
+  assert_non_null(rs);
+  assert_int_equal(rs->n, 4);
+  assert_int_equal(rs->rules[0].action, RULE_SIGNAL);
+  assert_string_equal(rs->rules[0].arg, "waybar");
+  assert_int_equal(rs->rules[0].target.sig, SIGRTMIN + 1);
+  assert_string_equal(rs->rules[0].match.output, "DP-1");
+  assert_int_equal(rs->rules[1].action, RULE_EXEC);
+  assert_string_equal(rs->rules[1].arg, "notify-send \"$WAYWS_NAME\" urgent");
+  assert_string_equal(rs->rules[2].arg, "/tmp/x.fifo");
+  assert_int_equal(rs->rules[3].action, RULE_ACTIVATE);
+
+  // state: signal, exec (no type=) and activate; created: exec and fifo
+  assert_int_equal(rs->nby_type[EVENT_WORKSPACE_STATE], 3);
+  assert_ptr_equal(rs->by_type[EVENT_WORKSPACE_STATE][0], &rs->rules[0]);
+  assert_int_equal(rs->nby_type[EVENT_WORKSPACE_CREATED], 2);
+  assert_int_equal(rs->nby_type[EVENT_OUTPUT_ENTER], 1);
+  assert_true(rules_want(rs, EVENT_WORKSPACE_DESTROYED));
+  assert_false(rules_want(NULL, EVENT_WORKSPACE_STATE));
+  rules_free(rs);
+}
+
+static void expect_error(const char *text, const char *want) {
+  char err[128] = "";
+  assert_null(rules_parse(text, err, sizeof err));
+  assert_string_equal(err, want);
+}
+
+static void test_rules_parse_errors(void **state) {
+  (void)state;
+  expect_error("\n\ntype=bogus exec true\n", "line 3: bad predicate 'type=bogus'");
+  expect_error("active=true\n", "line 1: missing action");
+  expect_error("reboot now\n", "line 1: unknown action 'reboot'");
+  expect_error("signal waybar\n", "line 1: signal expects a process name and a signal");
+  expect_error("signal waybar FOO\n",
+               "line 1: signal expects a process name and a signal");
+  expect_error("fifo a b\n", "line 1: fifo expects one argument");
+  expect_error("exec   \n", "line 1: exec expects a command");
+}
+
+static void test_rules_load_missing_file(void **state) {
+  (void)state;
+  char err[128];
+  assert_null(rules_load("/nonexistent/wayws.rules", err, sizeof err));
+  assert_non_null(strstr(err, "/nonexistent/wayws.rules"));
+}
+
+static void test_rules_fifo_action(void **state) {
+  (void)state;
+  char dir[] = "/tmp/wayws-rules-XXXXXX";
+  assert_non_null(mkdtemp(dir));
+  char path[64], text[128], err[128];
+  snprintf(path, sizeof path, "%s/fifo", dir);
+  assert_int_equal(mkfifo(path, 0600), 0);
+  snprintf(text, sizeof text, "type=state active=true fifo %s\n", path);
+
+  struct wayws_state s = {0};
+  s.rules = rules_parse(text, err, sizeof err);
+  assert_non_null(s.rules);
+  // No reader yet: the event is dropped instead of blocking
+  rules_dispatch(&s, EVENT_WORKSPACE_STATE, &active_ev);
+
+  int rfd = open(path, O_RDONLY | O_NONBLOCK);
+  assert_true(rfd >= 0);
+  struct tpl_record inactive = active_ev;
+  inactive.active = 0;
+  rules_dispatch(&s, EVENT_WORKSPACE_STATE, &inactive);
+  rules_dispatch(&s, EVENT_WORKSPACE_STATE, &active_ev);
+  char buf[256];
+  ssize_t n = read(rfd, buf, sizeof buf - 1);
+  assert_true(n > 0);
+  buf[n] = '\0';
+  assert_string_equal(buf, "{\"type\":\"workspace_state\",\"workspace\":{\"name\":"
+                           "\"web\",\"index\":2,\"output\":\"DP-1\",\"active\":"
+                           "true,\"urgent\":false,\"hidden\":false}}\n");
+  close(rfd);
+
+  // The reader went away: SIGPIPE keeps its default action (it ends watch
+  // mode when stdout closes) and still does not kill us here
+  signal(SIGPIPE, SIG_DFL);
+  rules_dispatch(&s, EVENT_WORKSPACE_STATE, &active_ev);
+  assert_int_equal(s.rules->rules[0].fifo_fd, -1);
+  sigset_t pending;
+  sigpending(&pending);
+  assert_false(sigismember(&pending, SIGPIPE));
+  rules_free(s.rules);
+  unlink(path);
+  rmdir(dir);
+}
+
+static void test_rules_signal_action(void **state) {
+  (void)state;
+  int sync[2];
+  assert_int_equal(pipe(sync), 0);
+  pid_t pid = fork();
+  assert_true(pid >= 0);
+  if (pid == 0) {
+    signal(SIGUSR1, SIG_DFL);
+    prctl(PR_SET_NAME, "wayws-sigtest");
+    close(sync[0]);
+    if (write(sync[1], "", 1) != 1)
+      _exit(1);
+    pause();
+    _exit(0);
+  }
+  close(sync[1]);
+  char c;
+  assert_int_equal(read(sync[0], &c, 1), 1);
+  close(sync[0]);
+
+  char err[128];
+  struct wayws_state s = {0};
+  s.rules = rules_parse("type=state signal wayws-sigtest USR1\n", err, sizeof err);
+  assert_non_null(s.rules);
+  rules_dispatch(&s, EVENT_WORKSPACE_STATE, &active_ev);
+  int status;
+  assert_int_equal(waitpid(pid, &status, 0), pid);
+  assert_true(WIFSIGNALED(status));
+  assert_int_equal(WTERMSIG(status), SIGUSR1);
+  rules_free(s.rules);
+}
+
+static void test_rules_exec_action(void **state) {
+  (void)state;
+  char path[] = "/tmp/wayws-rules-exec-XXXXXX";
+  int fd = mkstemp(path);
+  assert_true(fd >= 0);
+  close(fd);
+  char text[160], err[128];
+  snprintf(text, sizeof text, "exec echo \"$WAYWS_NAME@$WAYWS_OUTPUT\" > %s\n",
+           path);
+  struct wayws_state s = {0};
+  s.rules = rules_parse(text, err, sizeof err);
+  assert_non_null(s.rules);
+  rules_dispatch(&s, EVENT_WORKSPACE_STATE, &active_ev);
+  assert_int_equal(s.exec.running, 1);
+  for (int i = 0; i < 100 && s.exec.running; i++) {
+    struct pollfd pfd = {.fd = exec_fd(&s.exec), .events = POLLIN};
+    poll(&pfd, 1, 50);
+    exec_reap(&s.exec);
+  }
+  FILE *f = fopen(path, "r");
+  char line[64] = "";
+  assert_non_null(fgets(line, sizeof line, f));
+  fclose(f);
+  assert_string_equal(line, "web@DP-1\n");
+  unlink(path);
+  exec_destroy(&s.exec);
+  rules_free(s.rules);
+}
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+      cmocka_unit_test(test_rules_parse_and_dispatch_table),
+      cmocka_unit_test(test_rules_parse_errors),
+      cmocka_unit_test(test_rules_load_missing_file),
+      cmocka_unit_test(test_rules_fifo_action),
+      cmocka_unit_test(test_rules_signal_action),
+      cmocka_unit_test(test_rules_exec_action),
+  };
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,198 @@
+#define _GNU_SOURCE
+
+#include "../filter.h"
+#include "../serve.h"
+#include <setjmp.h>
+#include <stdarg.h>
+#include <cmocka.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static void append(struct serve *s, wayws_event_type_t type, const char *name,
+                   int index, int active) {
+  wayws_event_t ev = {
+      .type = type,
+      .workspace_name = name,
+      .output_name = "DP-1",
+      .workspace_index = index,
+      .active = active,
+      .timestamp = 1,
+  };
+  serve_append(s, &ev);
+}
+
+// Everything readable on fd right now
+static size_t drain(int fd, char *buf, size_t cap) {
+  size_t len = 0;
+  ssize_t n;
+  while (len < cap - 1 &&
+         (n = recv(fd, buf + len, cap - 1 - len, MSG_DONTWAIT)) > 0)
+    len += (size_t)n;
+  buf[len] = '\0';
+  return len;
+}
+
+static size_t count_lines(const char *s) {
+  size_t n = 0;
+  for (; *s; s++)
+    n += *s == '\n';
+  return n;
+}
+
+static void test_serve_filters_per_subscriber(void **state) {
+  (void)state;
+  struct serve s;
+  serve_init(&s, 4096);
+  int all[2], active[2];
+  assert_int_equal(socketpair(AF_UNIX, SOCK_STREAM, 0, all), 0);
+  assert_int_equal(socketpair(AF_UNIX, SOCK_STREAM, 0, active), 0);
+  struct event_filter f = {0};
+  assert_non_null(serve_add(&s, all[0], &f));
+  assert_int_equal(filter_parse_events(&f, "state"), 0);
+  assert_int_equal(filter_parse_match(&f, "active=true"), 0);
+  assert_non_null(serve_add(&s, active[0], &f));
+
+  append(&s, EVENT_WORKSPACE_NAME, "web", 1, 0);
+  append(&s, EVENT_WORKSPACE_STATE, "web", 1, 1);
+  append(&s, EVENT_WORKSPACE_STATE, "mail", 2, 0);
+  // Nothing goes out before the batch ends
+  char buf[4096];
+  assert_int_equal(drain(all[1], buf, sizeof buf), 0);
+
+  serve_commit(&s);
+  drain(all[1], buf, sizeof buf);
+  assert_int_equal(count_lines(buf), 3);
+  assert_non_null(strstr(buf, "\"type\":\"workspace_name\""));
+  drain(active[1], buf, sizeof buf);
+  assert_int_equal(count_lines(buf), 1);
+  assert_non_null(strstr(buf, "\"name\":\"web\""));
+  assert_non_null(strstr(buf, "\"active\":true"));
+
+  // A subscriber that hangs up is swept; the other keeps going
+  close(active[1]);
+  append(&s, EVENT_WORKSPACE_STATE, "web", 1, 1);
+  serve_commit(&s);
+  for (size_t i = 0; i < s.nsubs; i++)
+    if (s.subs[i].fd == active[0])
+      s.subs[i].dead = 1;
+  serve_sweep(&s);
+  assert_int_equal(s.nsubs, 1);
+  drain(all[1], buf, sizeof buf);
+  assert_int_equal(count_lines(buf), 1);
+
+  serve_free(&s);
+  close(all[1]);
+}
+
+static void test_serve_slow_subscriber_resumes_and_lagging_one_drops(
+    void **state) {
+  (void)state;
+  struct serve s;
+  serve_init(&s, 8192);
+  int slow[2], stuck[2];
+  assert_int_equal(socketpair(AF_UNIX, SOCK_STREAM, 0, slow), 0);
+  assert_int_equal(socketpair(AF_UNIX, SOCK_STREAM, 0, stuck), 0);
+  int small = 4096;
+  setsockopt(slow[0], SOL_SOCKET, SO_SNDBUF, &small, sizeof small);
+  setsockopt(stuck[0], SOL_SOCKET, SO_SNDBUF, &small, sizeof small);
+  struct event_filter f = {0};
+  struct serve_sub *sub = serve_add(&s, slow[0], &f);
+  serve_add(&s, stuck[0], &f);
+
+  // Many batches, several times the ring, read by one subscriber only.
+  // The reader sees every line in order, across the ring's wrap and its
+  // own partial writes.
+  static char got[1 << 20];
+  size_t len = 0;
+  char name[16];
+  for (int i = 0; i < 2000; i++) {
+    snprintf(name, sizeof name, "ws-%d", i);
+    append(&s, EVENT_WORKSPACE_STATE, name, i, 0);
+    if (i % 5 == 4)
+      serve_commit(&s);
+    len += drain(slow[1], got + len, sizeof got - len);
+    for (size_t k = 0; k < s.nsubs; k++)
+      if (s.subs[k].fd == slow[0] && s.subs[k].blocked)
+        serve_pump(&s, &s.subs[k]);
+  }
+  while (sub->cursor != s.committed || sub->part) {
+    len += drain(slow[1], got + len, sizeof got - len);
+    serve_pump(&s, sub);
+  }
+  len += drain(slow[1], got + len, sizeof got - len);
+  assert_int_equal(count_lines(got), 2000);
+  char *p = got;
+  for (int i = 0; i < 2000; i++) {
+    char want[32];
+    snprintf(want, sizeof want, "\"name\":\"ws-%d\"", i);
+    assert_non_null(strstr(p, want));
+    p = strchr(p, '\n') + 1;
+  }
+
+  // The one that never read fell a whole ring behind and was dropped
+  assert_int_equal(s.dropped, 1);
+  serve_sweep(&s);
+  assert_int_equal(s.nsubs, 1);
+  assert_int_equal(s.subs[0].fd, slow[0]);
+
+  serve_free(&s);
+  close(slow[1]);
+  close(stuck[1]);
+}
+
+static void test_serve_snapshot_goes_first(void **state) {
+  (void)state;
+  struct serve s;
+  serve_init(&s, 4096);
+  struct wayws_state ws_state = {0};
+  struct ws w1 = {.name = "1", .index = 0, .active = 1};
+  struct ws w2 = {.name = "2", .index = 1};
+  struct ws *vec[] = {&w1, &w2};
+  ws_state.vec = vec;
+  ws_state.vlen = 2;
+
+  int fds[2];
+  assert_int_equal(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+  struct event_filter f = {0};
+  assert_int_equal(filter_parse_match(&f, "active=false"), 0);
+  struct serve_sub *sub = serve_add(&s, fds[0], &f);
+  serve_snapshot(&ws_state, &sub->filter, &sub->snap);
+  append(&s, EVENT_WORKSPACE_STATE, "3", 3, 0);
+  serve_commit(&s);
+
+  char buf[4096];
+  drain(fds[1], buf, sizeof buf);
+  assert_int_equal(count_lines(buf), 2);
+  char *second = strchr(buf, '\n') + 1;
+  assert_non_null(strstr(buf, "\"name\":\"2\""));
+  assert_true(strstr(buf, "\"name\":\"2\"") < second);
+  assert_non_null(strstr(second, "\"name\":\"3\""));
+
+  serve_free(&s);
+  close(fds[1]);
+}
+
+static void test_serve_socket_path(void **state) {
+  (void)state;
+  char path[128];
+  setenv("XDG_RUNTIME_DIR", "/run/user/1000", 1);
+  setenv("WAYLAND_DISPLAY", "wayland-1", 1);
+  assert_int_equal(serve_socket_path(path, sizeof path), 0);
+  assert_string_equal(path, "/run/user/1000/wayws-wayland-1.events.sock");
+  unsetenv("XDG_RUNTIME_DIR");
+  assert_int_equal(serve_socket_path(path, sizeof path), -1);
+}
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+      cmocka_unit_test(test_serve_filters_per_subscriber),
+      cmocka_unit_test(test_serve_slow_subscriber_resumes_and_lagging_one_drops),
+      cmocka_unit_test(test_serve_snapshot_goes_first),
+      cmocka_unit_test(test_serve_socket_path),
+  };
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,209 @@
+#define _GNU_SOURCE
+
+#include "../output.h"
+#include "../shm.h"
+#include <setjmp.h>
+#include <stdarg.h>
+#include <cmocka.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Two workspaces on DP-1, one more whose group has no output yet
+struct model {
+  struct wayws_state s;
+  struct output out;
+  struct group_output go;
+  struct workspace_group g1, g2;
+  struct ws w[3];
+  struct ws *vec[3];
+};
+
+static void build_model(struct model *m) {
+  memset(m, 0, sizeof *m);
+  m->out.name = "DP-1";
+  m->out.name_id = strintern_id(&m->s.output_names, "DP-1");
+  m->go.output = &m->out;
+  m->g1.outputs = &m->go;
+  m->w[0] = (struct ws){.name = "web", .id = "ws-a", .group = &m->g1,
+                        .active = 1, .x = 0, .y = 0};
+  m->w[1] = (struct ws){.name = "mail", .group = &m->g1, .urgent = 1, .x = 1};
+  m->w[2] = (struct ws){.group = &m->g2, .hidden = 1, .y = -1};
+  for (size_t i = 0; i < 3; i++) {
+    m->w[i].index = i;
+    m->vec[i] = &m->w[i];
+  }
+  m->s.vec = m->vec;
+  m->s.vlen = 3;
+}
+
+static char dir[] = "/tmp/wayws-shm-XXXXXX";
+static char path[64];
+
+static int setup(void **state) {
+  (void)state;
+  if (!mkdtemp(dir))
+    return -1;
+  snprintf(path, sizeof path, "%s/state", dir);
+  return 0;
+}
+
+static int teardown(void **state) {
+  (void)state;
+  unlink(path);
+  return rmdir(dir);
+}
+
+static void test_shm_publish_and_read(void **state) {
+  (void)state;
+  struct model m;
+  build_model(&m);
+  struct shm_publisher *p = shm_publisher_open(path);
+  assert_non_null(p);
+  shm_publish(p, &m.s);
+
+  static struct shm_snapshot snap;
+  assert_int_equal(shm_read(p->map, &snap), SHM_OK);
+  assert_int_equal(snap.nws, 3);
+  assert_int_equal(snap.noutputs, 1);
+  assert_string_equal(snap.strs + snap.outputs[0], "DP-1");
+  assert_string_equal(snap.strs + snap.ws[0].name_off, "web");
+  assert_string_equal(snap.strs + snap.ws[0].id_off, "ws-a");
+  assert_int_equal(snap.ws[0].flags, FILTER_ACTIVE);
+  assert_int_equal(snap.ws[0].output, m.out.name_id);
+  assert_int_equal(snap.ws[0].group, (uintptr_t)&m.g1);
+  assert_int_equal(snap.ws[1].flags, FILTER_URGENT);
+  assert_int_equal(snap.ws[1].x, 1);
+  assert_int_equal(snap.ws[2].flags, FILTER_HIDDEN);
+  assert_int_equal(snap.ws[2].output, 0);
+  assert_int_equal(snap.ws[2].y, -1);
+  assert_string_equal(snap.strs + snap.ws[2].name_off, "");
+
+  // A later batch replaces the table
+  m.s.vlen = 1;
+  m.w[0].active = 0;
+  shm_publish(p, &m.s);
+  assert_int_equal(shm_read(p->map, &snap), SHM_OK);
+  assert_int_equal(snap.nws, 1);
+  assert_int_equal(snap.ws[0].flags, 0);
+
+  shm_publisher_close(p);
+  strintern_free(&m.s.output_names);
+}
+
+static void test_shm_reader_never_takes_a_half_written_table(void **state) {
+  (void)state;
+  struct model m;
+  build_model(&m);
+  struct shm_publisher *p = shm_publisher_open(path);
+  assert_non_null(p);
+  static struct shm_snapshot snap;
+  // Opened but not yet published
+  assert_int_equal(shm_read(p->map, &snap), SHM_BUSY);
+  shm_publish(p, &m.s);
+  uint64_t seq = atomic_load(&p->map->seq);
+  assert_int_equal(seq & 1, 0);
+
+  // A publisher caught mid-write
+  atomic_store(&p->map->seq, seq + 1);
+  assert_int_equal(shm_read(p->map, &snap), SHM_BUSY);
+  atomic_store(&p->map->seq, seq);
+  assert_int_equal(shm_read(p->map, &snap), SHM_OK);
+
+  shm_publisher_close(p);
+  strintern_free(&m.s.output_names);
+}
+
+static void test_shm_one_publisher_per_file(void **state) {
+  (void)state;
+  struct shm_publisher *p = shm_publisher_open(path);
+  assert_non_null(p);
+  assert_null(shm_publisher_open(path));
+  shm_publisher_close(p);
+  assert_int_not_equal(access(path, F_OK), 0);
+  p = shm_publisher_open(path);
+  assert_non_null(p);
+  shm_publisher_close(p);
+}
+
+static void test_shm_too_big_is_refused(void **state) {
+  (void)state;
+  struct model m;
+  build_model(&m);
+  char name[16];
+  for (int i = 0; i < SHM_MAX_OUTPUTS; i++) {
+    snprintf(name, sizeof name, "HDMI-%d", i);
+    strintern_id(&m.s.output_names, name);
+  }
+  struct shm_publisher *p = shm_publisher_open(path);
+  assert_non_null(p);
+  shm_publish(p, &m.s);
+  static struct shm_snapshot snap;
+  assert_int_equal(shm_read(p->map, &snap), SHM_TRUNCATED);
+  shm_publisher_close(p);
+  strintern_free(&m.s.output_names);
+}
+
+// Runs print(s) with stdout going to a buffer
+static void capture(void (*print)(struct wayws_state *, int *),
+                    struct wayws_state *s, int *ret, char *buf, size_t cap) {
+  fflush(stdout);
+  FILE *f = tmpfile();
+  int saved = dup(STDOUT_FILENO);
+  dup2(fileno(f), STDOUT_FILENO);
+  print(s, ret);
+  fflush(stdout);
+  dup2(saved, STDOUT_FILENO);
+  close(saved);
+  rewind(f);
+  size_t n = fread(buf, 1, cap - 1, f);
+  buf[n] = '\0';
+  fclose(f);
+}
+
+static void live_json(struct wayws_state *s, int *ret) {
+  print_json_output(s);
+  *ret = 0;
+}
+
+static void shm_json(struct wayws_state *s, int *ret) {
+  *ret = shm_print(s, path);
+}
+
+static void test_shm_print_matches_live_json(void **state) {
+  (void)state;
+  struct model m;
+  build_model(&m);
+  m.s.flag_json = 1;
+  struct shm_publisher *p = shm_publisher_open(path);
+  assert_non_null(p);
+  shm_publish(p, &m.s);
+
+  char live[4096], snap[4096];
+  int ret;
+  capture(live_json, &m.s, &ret, live, sizeof live);
+  capture(shm_json, &m.s, &ret, snap, sizeof snap);
+  assert_int_equal(ret, 0);
+  assert_string_equal(snap, live);
+  assert_non_null(strstr(snap, "\"monitor\":\"(unknown)\""));
+
+  // Gone with its publisher
+  shm_publisher_close(p);
+  capture(shm_json, &m.s, &ret, snap, sizeof snap);
+  assert_int_equal(ret, 1);
+  assert_string_equal(snap, "");
+  strintern_free(&m.s.output_names);
+}
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+      cmocka_unit_test(test_shm_publish_and_read),
+      cmocka_unit_test(test_shm_reader_never_takes_a_half_written_table),
+      cmocka_unit_test(test_shm_one_publisher_per_file),
+      cmocka_unit_test(test_shm_too_big_is_refused),
+      cmocka_unit_test(test_shm_print_matches_live_json),
+  };
+  return cmocka_run_group_tests(tests, setup, teardown);
+}
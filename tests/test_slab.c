@@ -0,0 +1,107 @@
+#include "../slab.h"
+#include <setjmp.h>
+#include <stdarg.h>
+#include <cmocka.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct obj {
+  int value;
+  char pad[13];
+};
+
+static void test_slab_alloc_zeroed(void **state) {
+  (void)state;
+  struct slab s;
+  slab_init(&s, sizeof(struct obj));
+  struct obj *a = slab_alloc(&s);
+  struct obj *b = slab_alloc(&s);
+  assert_non_null(a);
+  assert_non_null(b);
+  assert_ptr_not_equal(a, b);
+  assert_int_equal(a->value, 0);
+  assert_int_equal(((uintptr_t)b) % _Alignof(max_align_t), 0);
+  a->value = 42;
+  slab_release(&s, a);
+  // Recycled slots come back zeroed
+  struct obj *c = slab_alloc(&s);
+  assert_ptr_equal(c, a);
+  assert_int_equal(c->value, 0);
+  assert_int_equal(s.live, 2);
+  slab_destroy(&s);
+}
+
+static void test_slab_stale_handle(void **state) {
+  (void)state;
+  struct slab s;
+  slab_init(&s, sizeof(struct obj));
+  struct obj *a = slab_alloc(&s);
+  slab_handle_t h = slab_handle(&s, a);
+  assert_int_not_equal(h, SLAB_NULL);
+  assert_ptr_equal(slab_get(&s, h), a);
+  slab_release(&s, a);
+  assert_null(slab_get(&s, h));
+  // Reusing the slot must not revive the old handle
+  struct obj *b = slab_alloc(&s);
+  assert_ptr_equal(b, a);
+  assert_null(slab_get(&s, h));
+  assert_ptr_equal(slab_get(&s, slab_handle(&s, b)), b);
+  assert_null(slab_get(&s, SLAB_NULL));
+  slab_destroy(&s);
+}
+
+static void test_slab_double_release(void **state) {
+  (void)state;
+  struct slab s;
+  slab_init(&s, sizeof(struct obj));
+  struct obj *a = slab_alloc(&s);
+  slab_release(&s, a);
+  slab_release(&s, a);
+  slab_release(&s, NULL);
+  assert_int_equal(s.live, 0);
+  // A second release must not put the slot on the free list twice
+  struct obj *b = slab_alloc(&s);
+  struct obj *c = slab_alloc(&s);
+  assert_ptr_not_equal(b, c);
+  slab_destroy(&s);
+}
+
+static void count_live(void *obj, void *data) {
+  struct obj *o = obj;
+  int *sum = data;
+  *sum += o->value;
+}
+
+static void test_slab_foreach_and_growth(void **state) {
+  (void)state;
+  struct slab s;
+  slab_init(&s, sizeof(struct obj));
+  struct obj *objs[300];
+  for (int i = 0; i < 300; i++) {
+    objs[i] = slab_alloc(&s);
+    objs[i]->value = 1;
+  }
+  // Chunks never move, so early pointers stay valid as the slab grows
+  objs[0]->value = 2;
+  for (int i = 1; i < 300; i += 2)
+    slab_release(&s, objs[i]);
+  int sum = 0;
+  slab_foreach(&s, count_live, &sum);
+  assert_int_equal(sum, 151);
+  assert_int_equal(s.live, 150);
+  slab_destroy(&s);
+  assert_int_equal(s.live, 0);
+  sum = 0;
+  slab_foreach(&s, count_live, &sum);
+  assert_int_equal(sum, 0);
+}
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+      cmocka_unit_test(test_slab_alloc_zeroed),
+      cmocka_unit_test(test_slab_stale_handle),
+      cmocka_unit_test(test_slab_double_release),
+      cmocka_unit_test(test_slab_foreach_and_growth),
+  };
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,60 @@
+#!/bin/bash
+
+# Per-command startup time for wayws
+# Runs each one-shot command repeatedly against the current compositor and
+# reports the mean wall-clock time. Commands that need less of the protocol
+# (see plan.c) should start measurably faster than full listings.
+
+# Colors for output
+GREEN='\033[0;32m'
+YELLOW='\033[1;33m'
+NC='\033[0m' # No Color
+
+RUNS="${RUNS:-50}"
+
+# Check if wayws binary exists
+if [ ! -f "./wayws" ]; then
+    echo "Error: wayws binary not found. Run 'make' first."
+    exit 1
+fi
+
+if [ -z "$WAYLAND_DISPLAY" ] || ! ./wayws --no-daemon -l >/dev/null 2>&1; then
+    echo -e "${YELLOW}Startup timing skipped: no ext-workspace-v1 compositor available.${NC}"
+    exit 0
+fi
+
+# Mean time of one invocation in microseconds
+measure() {
+    local start end
+    start=$(date +%s%N)
+    for ((i = 0; i < RUNS; i++)); do
+        ./wayws "$@" >/dev/null 2>&1
+    done
+    end=$(date +%s%N)
+    echo $(((end - start) / RUNS / 1000))
+}
+
+report() {
+    local label="$1"
+    shift
+    printf "  %-28s %8s us\n" "$label" "$(measure "$@")"
+}
+
+first_name=$(./wayws --no-daemon -l | awk 'NR == 1 { print $3 }')
+
+echo "Startup time per command ($RUNS runs each, direct connection)"
+echo "=================================="
+report "activate by index" --no-daemon 1
+report "activate by name" --no-daemon "$first_name"
+report "list (full model)" --no-daemon -l
+report "json (full model)" --no-daemon --json
+
+if [ -n "$XDG_RUNTIME_DIR" ] && [ -S "$XDG_RUNTIME_DIR/wayws-$(basename "$WAYLAND_DISPLAY").sock" ]; then
+    echo ""
+    echo "Through the running daemon"
+    echo "=================================="
+    report "activate by index" 1
+    report "list (full model)" -l
+fi
+
+echo -e "${GREEN}Startup timing done.${NC}"
@@ -0,0 +1,92 @@
+#include "../template.h"
+#include "../outbuf.h"
+#include <setjmp.h>
+#include <stdarg.h>
+#include <cmocka.h>
+#include <stddef.h>
+#include <string.h>
+
+static const struct tpl_record rec = {
+    .name = "code",
+    .id = "ws-7",
+    .output = "DP-1",
+    .type = "workspace_state",
+    .index = 3,
+    .x = -1,
+    .y = 2,
+    .active = 1,
+    .urgent = 0,
+    .hidden = 0,
+    .timestamp = 1700000000,
+};
+
+static const char *render(const char *src, const struct tpl_record *r) {
+  static char out[256];
+  struct template t;
+  assert_int_equal(template_compile(&t, src), 0);
+  struct outbuf b = {0};
+  template_render(&t, &b, r);
+  assert_true(b.len < sizeof out);
+  memcpy(out, b.buf, b.len);
+  out[b.len] = '\0';
+  outbuf_free(&b);
+  template_free(&t);
+  return out;
+}
+
+static void test_template_fields(void **state) {
+  (void)state;
+  assert_string_equal(render("{name}\\t{output}\\t{active}", &rec),
+                      "code\tDP-1\ttrue\n");
+  assert_string_equal(render("{index} {id} {x},{y} {urgent}{hidden}", &rec),
+                      "3 ws-7 -1,2 falsefalse\n");
+  assert_string_equal(render("{type}@{timestamp}", &rec),
+                      "workspace_state@1700000000\n");
+}
+
+static void test_template_literals(void **state) {
+  (void)state;
+  assert_string_equal(render("", &rec), "\n");
+  assert_string_equal(render("{{{name}}} \\\\ \\n", &rec), "{code} \\ \n\n");
+}
+
+static void test_template_null_strings(void **state) {
+  (void)state;
+  struct tpl_record r = {.index = 1};
+  assert_string_equal(render("[{name}|{id}|{type}]", &r), "[||]\n");
+}
+
+static void test_template_compact(void **state) {
+  (void)state;
+  struct template t;
+  assert_int_equal(template_compile(&t, "ws {name} on {output}!"), 0);
+  // Literal runs are merged: "ws ", name, " on ", output, "!"
+  assert_int_equal(t.nops, 5);
+  assert_int_equal(t.ops[0].field, TPL_LITERAL);
+  assert_int_equal(t.ops[0].len, 3);
+  assert_int_equal(t.ops[1].field, TPL_NAME);
+  assert_int_equal(t.ops[3].field, TPL_OUTPUT);
+  template_free(&t);
+  assert_null(t.ops);
+}
+
+static void test_template_errors(void **state) {
+  (void)state;
+  struct template t;
+  assert_int_equal(template_compile(&t, "{nope}"), -1);
+  assert_null(t.ops);
+  assert_int_equal(template_compile(&t, "{name"), -1);
+  assert_int_equal(template_compile(&t, "name}"), -1);
+  assert_int_equal(template_compile(&t, "{}"), -1);
+}
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+      cmocka_unit_test(test_template_fields),
+      cmocka_unit_test(test_template_literals),
+      cmocka_unit_test(test_template_null_strings),
+      cmocka_unit_test(test_template_compact),
+      cmocka_unit_test(test_template_errors),
+  };
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
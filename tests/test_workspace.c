@@ -4,6 +4,7 @@
 #include <stdarg.h>
 #include <cmocka.h>
 #include <stddef.h>
+#include <stdlib.h>
 
 // Mocking the die function to avoid exiting the test runner
 void __wrap_die(const char *msg) { check_expected(msg); }
@@ -23,12 +24,17 @@ static void test_current_ws_no_output_name(void **state) {
 
 static void test_current_ws_with_output_name(void **state) {
   struct wayws_state s = {0};
-  struct output out1 = {.name = "out1"};
-  struct output out2 = {.name = "out2"};
-  struct group_output go1 = {.output = &out1};
-  struct group_output go2 = {.output = &out2};
-  struct workspace_group g1 = {.outputs = &go1};
-  struct workspace_group g2 = {.outputs = &go2};
+  struct output out1 = {0};
+  struct output out2 = {0};
+  struct workspace_group g1 = {0};
+  struct workspace_group g2 = {0};
+  model_init(&s);
+  output_set_name(&s, &out1, "out1");
+  output_set_name(&s, &out2, "out2");
+  out1.next = &out2;
+  s.all_outputs = &out1;
+  group_output_link(&s, &g1, &out1);
+  group_output_link(&s, &g2, &out2);
   struct ws ws1 = {
       .name = "ws1", .active = 1, .last_active_seq = 1, .group = &g1};
   struct ws ws2 = {
@@ -36,11 +42,33 @@ static void test_current_ws_with_output_name(void **state) {
   struct ws *vec[] = {&ws1, &ws2};
   s.vec = vec;
   s.vlen = 2;
+  group_add_ws(&g1, &ws1);
+  group_add_ws(&g2, &ws2);
   s.opt_output_name = "out2";
 
   struct ws *current = current_ws(&s, NULL);
   assert_non_null(current);
   assert_string_equal(current->name, "ws2");
+
+  // Filtering on out1 picks its active workspace even though ws2 is newer
+  s.opt_output_name = "out1";
+  current = current_ws(&s, NULL);
+  assert_non_null(current);
+  assert_string_equal(current->name, "ws1");
+
+  group_output_unlink(&s, &g1, &out1);
+  group_output_unlink(&s, &g2, &out2);
+  assert_int_equal(out1.ngroups, 0);
+  assert_null(g2.outputs);
+  free(out1.name);
+  free(out2.name);
+  free(out1.groups);
+  free(out2.groups);
+  free(g1.members);
+  free(g2.members);
+  strintern_free(&s.output_names);
+  assert_int_equal(s.link_slab.live, 0);
+  slab_destroy(&s.link_slab);
 }
 
 static void test_current_ws_multi_output_group(void **state) {
@@ -51,17 +79,26 @@ static void test_current_ws_multi_output_group(void **state) {
   struct group_output go2 = {.output = &out2};
   go1.next = &go2;
   struct workspace_group g1 = {.outputs = &go1};
-  struct ws ws1 = {
-      .name = "ws1", .active = 1, .last_active_seq = 1, .group = &g1};
-  struct ws ws2 = {
-      .name = "ws2", .active = 1, .last_active_seq = 2, .group = &g1};
+  struct ws ws1 = {.name = "ws1",
+                   .index = 0,
+                   .active = 1,
+                   .last_active_seq = 1,
+                   .group = &g1};
+  struct ws ws2 = {.name = "ws2",
+                   .index = 1,
+                   .active = 1,
+                   .last_active_seq = 2,
+                   .group = &g1};
   struct ws *vec[] = {&ws1, &ws2};
   s.vec = vec;
   s.vlen = 2;
+  group_add_ws(&g1, &ws1);
+  group_add_ws(&g1, &ws2);
 
   struct ws *current = current_ws(&s, NULL);
   assert_non_null(current);
   assert_string_equal(current->name, "ws2");
+  free(g1.members);
 }
 
 static void test_neighbor_right(void **state) {
@@ -78,10 +115,14 @@ static void test_neighbor_right(void **state) {
   ws1.group = &g;
   ws2.group = &g;
   ws3.group = &g;
+  group_add_ws(&g, &ws1);
+  group_add_ws(&g, &ws2);
+  group_add_ws(&g, &ws3);
 
   struct ws *n = neighbor(&s, DIR_RIGHT);
   assert_non_null(n);
   assert_string_equal(n->name, "ws2");
+  free(g.members);
 }
 
 static void test_neighbor_left_edge(void **state) {
@@ -96,9 +137,190 @@ static void test_neighbor_left_edge(void **state) {
   struct workspace_group g = {0};
   ws1.group = &g;
   ws2.group = &g;
+  group_add_ws(&g, &ws1);
+  group_add_ws(&g, &ws2);
 
   struct ws *n = neighbor(&s, DIR_LEFT);
   assert_null(n);
+  free(g.members);
+}
+
+static void test_group_members_stay_sorted(void **state) {
+  struct wayws_state s = {0};
+  struct workspace_group g = {0};
+  struct ws ws[5];
+  struct ws *vec[5];
+  for (size_t i = 0; i < 5; i++) {
+    ws[i] = (struct ws){.index = i, .listed = 1, .group = &g};
+    vec[i] = &ws[i];
+  }
+  s.vec = vec;
+  s.vlen = 5;
+
+  // Enter out of order; members come back in index order
+  group_add_ws(&g, &ws[3]);
+  group_add_ws(&g, &ws[0]);
+  group_add_ws(&g, &ws[4]);
+  group_add_ws(&g, &ws[1]);
+  group_add_ws(&g, &ws[1]);
+  assert_int_equal(group_size(&s, &g), 4);
+  assert_ptr_equal(g.members[0], &ws[0]);
+  assert_ptr_equal(g.members[1], &ws[1]);
+  assert_ptr_equal(g.members[2], &ws[3]);
+  assert_ptr_equal(g.members[3], &ws[4]);
+
+  // Removing a workspace renumbers the rest without breaking the order
+  group_remove_ws(&g, &ws[1]);
+  unlist_ws(&s, &ws[1]);
+  assert_int_equal(s.vlen, 4);
+  assert_int_equal(ws[3].index, 2);
+  assert_int_equal(ws[4].index, 3);
+  assert_int_equal(group_size(&s, &g), 3);
+  assert_ptr_equal(g.members[1], &ws[3]);
+  assert_ptr_equal(s.vec[2], &ws[3]);
+  free(g.members);
+}
+
+static void test_ws_index_by_name_and_id(void **state) {
+  struct wayws_state s = {0};
+  struct ws ws1 = {.index = 0};
+  struct ws ws2 = {.index = 1};
+  struct ws *vec[] = {&ws1, &ws2};
+  s.vec = vec;
+  s.vlen = 2;
+
+  ws_set_name(&s, &ws1, "code");
+  ws_set_name(&s, &ws2, "web");
+  ws_set_id(&s, &ws1, "id-1");
+  ws_set_id(&s, &ws2, "id-2");
+  assert_ptr_equal(ws_by_name(&s, "code"), &ws1);
+  assert_ptr_equal(ws_by_name(&s, "web"), &ws2);
+  assert_ptr_equal(ws_by_id(&s, "id-2"), &ws2);
+  assert_null(ws_by_name(&s, "missing"));
+
+  // Renames move the entry
+  ws_set_name(&s, &ws1, "editor");
+  assert_null(ws_by_name(&s, "code"));
+  assert_ptr_equal(ws_by_name(&s, "editor"), &ws1);
+
+  ws_unindex(&s, &ws2);
+  assert_null(ws_by_name(&s, "web"));
+  assert_null(ws_by_id(&s, "id-2"));
+  assert_ptr_equal(ws_by_id(&s, "id-1"), &ws1);
+  free(ws1.name);
+  free(ws1.id);
+  free(ws2.name);
+  free(ws2.id);
+  strmap_free(&s.ws_by_name);
+  strmap_free(&s.ws_by_id);
+}
+
+static void test_ws_index_duplicate_names(void **state) {
+  struct wayws_state s = {0};
+  struct ws ws1 = {.index = 0};
+  struct ws ws2 = {.index = 1};
+  struct ws *vec[] = {&ws1, &ws2};
+  s.vec = vec;
+  s.vlen = 2;
+
+  // The lower global index wins, as with the old linear scan
+  ws_set_name(&s, &ws2, "dup");
+  ws_set_name(&s, &ws1, "dup");
+  assert_ptr_equal(ws_by_name(&s, "dup"), &ws1);
+
+  // Renaming the winner promotes the other holder of the name
+  ws_set_name(&s, &ws1, "other");
+  assert_ptr_equal(ws_by_name(&s, "dup"), &ws2);
+  free(ws1.name);
+  free(ws2.name);
+  strmap_free(&s.ws_by_name);
+}
+
+static void test_find_target_workspace(void **state) {
+  struct wayws_state s = {0};
+  struct workspace_group g = {0};
+  struct ws ws1 = {.index = 0, .active = 1, .last_active_seq = 1, .group = &g};
+  struct ws ws2 = {.index = 1, .group = &g};
+  struct ws *vec[] = {&ws1, &ws2};
+  s.vec = vec;
+  s.vlen = 2;
+  s.grid_cols = 2;
+  group_add_ws(&g, &ws1);
+  group_add_ws(&g, &ws2);
+  ws_set_name(&s, &ws1, "1");
+  ws_set_name(&s, &ws2, "web");
+  ws_set_id(&s, &ws2, "id-2");
+
+  s.want_idx = 2;
+  assert_ptr_equal(find_target_workspace(&s), &ws2);
+  s.want_idx = 3;
+  assert_null(find_target_workspace(&s));
+
+  // A name beats the index, and falls back to it when nothing matches
+  s.want_idx = 1;
+  s.want_name = "web";
+  assert_ptr_equal(find_target_workspace(&s), &ws2);
+  s.want_name = "missing";
+  assert_ptr_equal(find_target_workspace(&s), &ws1);
+
+  // An id never falls back
+  s.want_id = "missing";
+  assert_null(find_target_workspace(&s));
+  s.want_id = "id-2";
+  s.want_name = NULL;
+  assert_ptr_equal(find_target_workspace(&s), &ws2);
+
+  // A direction overrides everything
+  s.move_dir = DIR_LEFT;
+  assert_null(find_target_workspace(&s));
+  s.move_dir = DIR_RIGHT;
+  assert_ptr_equal(find_target_workspace(&s), &ws2);
+  free(ws1.name);
+  free(ws2.name);
+  free(ws2.id);
+  free(g.members);
+  strmap_free(&s.ws_by_name);
+  strmap_free(&s.ws_by_id);
+}
+
+static void test_ws_output_outlives_group(void **state) {
+  (void)state;
+  struct wayws_state s = {0};
+  struct output out = {0};
+  struct workspace_group g = {0}, g2 = {0};
+  model_init(&s);
+  output_set_name(&s, &out, "DP-1");
+  group_output_link(&s, &g, &out);
+  group_output_link(&s, &g2, &out);
+  struct ws ws1 = {.name = "ws1", .group = &g};
+  struct ws ws2 = {.name = "ws2", .group = &g2};
+  group_add_ws(&g, &ws1);
+  group_add_ws(&g2, &ws2);
+  assert_int_equal(ws_output_id(&ws1), out.name_id);
+
+  // Left its group (what a removed workspace does first)
+  ws_leave_group(&ws1, &g);
+  group_remove_ws(&g, &ws1);
+  ws1.group = NULL;
+  assert_string_equal(strintern_str(&s.output_names, ws_output_id(&ws1)),
+                      "DP-1");
+
+  // Or its group left the output
+  group_output_unlink(&s, &g2, &out);
+  assert_null(g2.outputs);
+  assert_int_equal(ws_output_id(&ws2), out.name_id);
+
+  // Never on one
+  struct ws ws3 = {.name = "ws3"};
+  assert_int_equal(ws_output_id(&ws3), 0);
+
+  group_output_unlink(&s, &g, &out);
+  free(out.name);
+  free(out.groups);
+  free(g.members);
+  free(g2.members);
+  strintern_free(&s.output_names);
+  slab_destroy(&s.link_slab);
 }
 
 int main(void) {
@@ -108,6 +330,11 @@ int main(void) {
       cmocka_unit_test(test_current_ws_multi_output_group),
       cmocka_unit_test(test_neighbor_right),
       cmocka_unit_test(test_neighbor_left_edge),
+      cmocka_unit_test(test_group_members_stay_sorted),
+      cmocka_unit_test(test_ws_index_by_name_and_id),
+      cmocka_unit_test(test_ws_index_duplicate_names),
+      cmocka_unit_test(test_find_target_workspace),
+      cmocka_unit_test(test_ws_output_outlives_group),
   };
   return cmocka_run_group_tests(tests, NULL, NULL);
 }
@@ -0,0 +1,161 @@
+#define _GNU_SOURCE
+
+#include "../writer.h"
+#include <fcntl.h>
+#include <setjmp.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <cmocka.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// Reads exactly n bytes
+static void read_n(int fd, char *buf, size_t n) {
+  size_t got = 0;
+  while (got < n) {
+    ssize_t r = read(fd, buf + got, n - got);
+    assert_true(r > 0);
+    got += (size_t)r;
+  }
+  buf[got] = '\0';
+}
+
+static void test_writer_keeps_order_across_wrap(void **state) {
+  (void)state;
+  int fds[2];
+  assert_int_equal(pipe(fds), 0);
+  struct writer *w = writer_start(fds[1], 64);
+  assert_non_null(w);
+  char line[32], got[32];
+  for (int i = 0; i < 200; i++) {
+    int n = snprintf(line, sizeof line, "line-%d\n", i);
+    writer_push(w, line, (size_t)n);
+    read_n(fds[0], got, (size_t)n);
+    assert_string_equal(got, line);
+  }
+  struct writer_stats st;
+  writer_stop(w, &st);
+  assert_int_equal(st.dropped, 0);
+  assert_int_equal(st.depth, 0);
+  assert_true(st.high_water <= 64);
+  close(fds[0]);
+  close(fds[1]);
+}
+
+static void test_writer_never_blocks_on_a_stalled_reader(void **state) {
+  (void)state;
+  int fds[2];
+  assert_int_equal(pipe(fds), 0);
+  fcntl(fds[1], F_SETPIPE_SZ, 4096);
+  struct writer *w = writer_start(fds[1], 1024);
+  assert_non_null(w);
+
+  // Far more than the pipe and the ring hold, with nobody reading. Every
+  // push returns; what does not fit is dropped a whole line at a time.
+  char line[33];
+  for (int i = 0; i < 1000; i++) {
+    snprintf(line, sizeof line, "%031d\n", i);
+    writer_push(w, line, 32);
+  }
+  struct writer_stats st;
+  writer_get_stats(w, &st);
+  assert_true(st.dropped > 0);
+  assert_true(st.depth <= 1024);
+  assert_true(st.high_water <= 1024);
+  assert_true(st.high_water >= st.depth);
+
+  // What was kept arrives intact and in order
+  size_t kept = 1000 - st.dropped;
+  static char buf[1000 * 32 + 1];
+  read_n(fds[0], buf, kept * 32);
+  long prev = -1;
+  for (size_t i = 0; i < kept; i++) {
+    assert_int_equal(buf[i * 32 + 31], '\n');
+    long n = strtol(buf + i * 32, NULL, 10);
+    assert_true(n > prev);
+    prev = n;
+  }
+  writer_stop(w, &st);
+  assert_int_equal(st.depth, 0);
+  close(fds[0]);
+  close(fds[1]);
+}
+
+static void test_writer_stop_drains(void **state) {
+  (void)state;
+  int fds[2];
+  assert_int_equal(pipe(fds), 0);
+  struct writer *w = writer_start(fds[1], 4096);
+  assert_non_null(w);
+  const char batch[] = "a\nb\nc\n";
+  for (int i = 0; i < 100; i++)
+    writer_push(w, batch, sizeof batch - 1);
+  writer_stop(w, NULL);
+  char buf[700];
+  read_n(fds[0], buf, 600);
+  for (int i = 0; i < 100; i++)
+    assert_memory_equal(buf + i * 6, batch, 6);
+  close(fds[0]);
+  close(fds[1]);
+}
+
+static void test_writer_stop_gives_up_on_a_stalled_reader(void **state) {
+  (void)state;
+  int fds[2];
+  assert_int_equal(pipe(fds), 0);
+  fcntl(fds[1], F_SETPIPE_SZ, 4096);
+  struct writer *w = writer_start(fds[1], 65536);
+  assert_non_null(w);
+  // Far more than the pipe holds, and nobody ever reads
+  char line[33];
+  for (int i = 0; i < 1000; i++) {
+    snprintf(line, sizeof line, "%031d\n", i);
+    writer_push(w, line, 32);
+  }
+  struct timespec t0, t1;
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  struct writer_stats st;
+  writer_stop(w, &st);
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  long ms = (t1.tv_sec - t0.tv_sec) * 1000 + (t1.tv_nsec - t0.tv_nsec) / 1000000;
+  assert_true(ms >= WRITER_STOP_MS - 50 && ms < WRITER_STOP_MS + 1000);
+  // Counted, not left queued. A write() cut short by the stop cannot say
+  // how much of it the pipe took, so that part counts as dropped too.
+  assert_true(st.dropped > 0 && st.dropped <= 1000);
+  assert_int_equal(st.depth, 0);
+  close(fds[0]);
+  close(fds[1]);
+}
+
+static void test_writer_survives_a_closed_pipe(void **state) {
+  (void)state;
+  signal(SIGPIPE, SIG_IGN);
+  int fds[2];
+  assert_int_equal(pipe(fds), 0);
+  close(fds[0]);
+  struct writer *w = writer_start(fds[1], 64);
+  assert_non_null(w);
+  for (int i = 0; i < 100; i++)
+    writer_push(w, "gone\n", 5);
+  struct writer_stats st;
+  writer_stop(w, &st);
+  assert_true(st.failed);
+  assert_int_equal(st.depth, 0);
+  close(fds[1]);
+  signal(SIGPIPE, SIG_DFL);
+}
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+      cmocka_unit_test(test_writer_keeps_order_across_wrap),
+      cmocka_unit_test(test_writer_never_blocks_on_a_stalled_reader),
+      cmocka_unit_test(test_writer_stop_drains),
+      cmocka_unit_test(test_writer_stop_gives_up_on_a_stalled_reader),
+      cmocka_unit_test(test_writer_survives_a_closed_pipe),
+  };
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -1,14 +1,31 @@
 #ifndef TYPES_H
 #define TYPES_H
 
+#include "backlog.h"
+#include "exec.h"
 #include "ext_workspace_client.h"
+#include "hash.h"
+#include "outbuf.h"
+#include "proc.h"
+#include "slab.h"
+#include "template.h"
 #include <stdbool.h>
 #include <wayland-client.h>
 
+struct rule_set;
+struct serve;
+struct shm_publisher;
+struct writer;
+
 struct output {
   struct wl_output *output;
+  uint32_t global_name; // registry name, for global_remove
   char *name;
+  uint32_t name_id; // interned name, 0 until the name event arrives
   int32_t x, y, width, height;
+  struct workspace_group **groups; // groups currently shown on this output
+  size_t ngroups, groups_cap;
+  int done; // initial wl_output.done seen
   struct output *next;
 };
 
@@ -20,19 +37,27 @@ struct group_output {
 struct workspace_group {
   struct ext_workspace_group_handle_v1 *h;
   struct group_output *outputs;
+  struct ws **members; // kept sorted by ws->index
+  size_t nmembers, members_cap;
   struct workspace_group *next;
 };
 
 struct ws {
   struct ext_workspace_handle_v1 *h;
   char *name;
+  char *id; // stable protocol id, if the compositor sends one
   int active, urgent, hidden;
   size_t index;
   int listed;
   int32_t x, y;
   struct workspace_group *group;
+  uint32_t last_output; // output_names id of where it was last shown
   int pending_enter;
   unsigned long last_active_seq;
+  struct pending_event *pending_head, *pending_tail; // FIFO
+  // Where its latest state, name and coordinates events wait in the watch
+  // backlog (see backlog.h)
+  unsigned long backlog_seq[3];
 };
 
 enum dir { DIR_NONE, DIR_UP, DIR_DOWN, DIR_LEFT, DIR_RIGHT };
@@ -56,7 +81,7 @@ typedef enum {
     EVENT_OUTPUT_ENTER,           // output_enter event from group
     EVENT_OUTPUT_LEAVE,           // output_leave event from group
     
-
+    EVENT_TYPE_COUNT
 } wayws_event_type_t;
 
 // Event structure
@@ -68,10 +93,52 @@ typedef struct {
     int x, y;
     int active, urgent, hidden;
     enum dir direction;
-    unsigned long timestamp;
-    void *additional_data;
+    uint64_t timestamp; // CLOCK_MONOTONIC, ns
+    void *additional_data; // the struct ws of workspace events, else NULL
 } wayws_event_t;
 
+// Which events watch mode prints (--events, --match). A zeroed filter
+// accepts everything; types == 0 means all types.
+enum { FILTER_ACTIVE = 1, FILTER_URGENT = 2, FILTER_HIDDEN = 4 };
+
+struct event_filter {
+  uint32_t types;     // 1 << wayws_event_type_t
+  unsigned state_mask; // FILTER_* bits that are constrained
+  unsigned state_want; // their required values
+  const char *output;  // borrowed from argv
+  const char *name;
+};
+
+// --latency: a queued event whose latency_ns is filled in when it is
+// written. off is where the number goes in event_out.
+struct latency_mark {
+  size_t off;
+  uint64_t read_ns;
+};
+
+// An event held back until its workspace's output is known
+struct pending_event {
+  wayws_event_type_t type;
+  int x, y;
+  int active, urgent, hidden;
+  enum dir direction;
+  struct pending_event *next;
+};
+
+// Pending events are carved from fixed-size chunks and recycled through a
+// free list, so the startup burst does not malloc per deferred event.
+#define PENDING_CHUNK_SIZE 64
+
+struct pending_chunk {
+  struct pending_chunk *next;
+  struct pending_event nodes[PENDING_CHUNK_SIZE];
+};
+
+struct pending_pool {
+  struct pending_event *free;
+  struct pending_chunk *chunks;
+};
+
 // Event callback function type
 typedef void (*wayws_event_callback)(const wayws_event_t *event, void *user_data);
 
@@ -87,35 +154,91 @@ struct wayws_state {
   struct output *all_outputs;
   struct workspace_group *workspace_groups;
 
+  // Backing storage for the model objects above (see model_init)
+  struct slab ws_slab;
+  struct slab group_slab;
+  struct slab output_slab;
+  struct slab link_slab; // struct group_output nodes
+
+  // Lookup indexes over vec, maintained from the protocol callbacks
+  struct strmap ws_by_name;
+  struct strmap ws_by_id;
+  int ws_keys_shared; // some name/id was seen on two workspaces at once
+  struct strintern output_names;
+
+  // Startup synchronisation and batch tracking
+  unsigned plan; // enum startup_need bits, see plan.h
+  int registry_done;
+  uint32_t mgr_name; // registry name of the manager, bound once synced
+  int mgr_done;
+  int outputs_pending;
+  unsigned long batch_seq;
+
   // CLI flags
   int flag_list;
   int flag_watch;
   int flag_waybar;
   int flag_json;
   int flag_debug;
+  int flag_daemon;
+  int flag_no_daemon;
+  int flag_subscribe; // --subscribe: -w reads a running --serve's events
+  int flag_serve;
+  int flag_from_shm;
   char *opt_exec;
+  int flag_exec_direct;
+  char **exec_argv; // opt_exec split into words for --exec-direct
   char *opt_output_name;
+  char *opt_format;
+  struct template format; // opt_format, compiled by parse_cli
   char *glyph_active;
   char *glyph_empty;
   int want_idx;
   char *want_name;
+  char *want_id;
   enum dir move_dir;
+  int wait_ms;           // --wait, 0 = fire and forget
+  int bench_activations; // --bench-activate N
   int grid_cols;
   
   // Enhanced event system
   wayws_event_callback event_callback;
   void *event_user_data;
   int event_enabled;  // 0=disabled, 1=enabled
+  struct outbuf event_out; // JSON lines waiting for the end of the batch
+  struct event_filter event_filter;
+  unsigned long batch_events; // printed since the last end_event_batch
+  int flag_latency;
+  int flag_stats; // --stats: report on the output ring
+  uint64_t read_ns; // when wl_display_read_events() last returned, 0 = unknown
+  struct latency_mark *lat_marks;
+  size_t nlat, lat_cap;
+  struct outbuf lat_out; // event_out with the latencies spliced in
+  // Watch mode's stdout once the main loop runs; NULL writes directly
+  struct writer *writer;
+  // Batches held back while the writer's reader is behind; backlogging is
+  // decided between batches
+  struct backlog backlog;
+  int backlogging;
+
+  // Background --exec hooks
+  struct exec_runner exec;
+
+  // --signal NAME:SIG targets, sent once per batch that printed events
+  struct proc_target *signals;
+  size_t nsignals;
+
+  // --rules, loaded once at startup (see rules.h)
+  struct rule_set *rules;
+
+  // --serve: printed events go to the subscribers' ring instead of stdout
+  struct serve *serve;
+
+  // Where the model is published for --from-shm readers, if anywhere
+  struct shm_publisher *shm;
   
-  // Pending events for deferred emission
-  struct pending_event {
-    wayws_event_type_t type;
-    struct ws *workspace;
-    int x, y;
-    int active, urgent, hidden;
-    enum dir direction;
-    struct pending_event *next;
-  } *pending_events;
+  // Pool backing the per-workspace pending event queues
+  struct pending_pool pending_pool;
 };
 
 #endif // TYPES_H
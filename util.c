@@ -3,6 +3,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 void *xrealloc(void *p, size_t n) {
   void *q = realloc(p, n);
@@ -35,3 +36,9 @@ void die(const char *msg) {
   fputs(msg, stderr);
   exit(1);
 }
+
+uint64_t monotonic_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
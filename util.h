@@ -2,10 +2,13 @@
 #define UTIL_H
 
 #include <stddef.h>
+#include <stdint.h>
 
 void *xrealloc(void *p, size_t n);
 char *xstrdup(const char *s);
 int isnum(const char *s);
 void die(const char *msg);
+// CLOCK_MONOTONIC in nanoseconds
+uint64_t monotonic_ns(void);
 
 #endif // UTIL_H
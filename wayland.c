@@ -3,6 +3,7 @@
 #include "util.h"
 #include "workspace.h"
 #include "event.h"
+#include "plan.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -16,9 +17,8 @@ void wayland_set_global_state(struct wayws_state *state) {
 
 static void cb_name(void *d, struct ext_workspace_handle_v1 *h, const char *n) {
   struct wayws_state *state = g_state;
-  struct ws *w = ctx_of(h);
-  free(w->name);
-  w->name = xstrdup(n);
+  struct ws *w = ctx_of(g_state, h);
+  ws_set_name(state, w, n);
   
   // Emit workspace name event (may be deferred if output not available)
   const char *output_name = get_output_name_for_workspace(w);
@@ -28,7 +28,7 @@ static void cb_name(void *d, struct ext_workspace_handle_v1 *h, const char *n) {
                      w->active, w->urgent, w->hidden, DIR_NONE);
   } else {
     emit_event(state, EVENT_WORKSPACE_NAME, w->name, output_name, w->index + 1,
-               w->x, w->y, w->active, w->urgent, w->hidden, DIR_NONE, NULL);
+               w->x, w->y, w->active, w->urgent, w->hidden, DIR_NONE, w);
   }
 }
 
@@ -36,7 +36,7 @@ static void cb_coordinates(void *d, struct ext_workspace_handle_v1 *h,
                            struct wl_array *coords) {
   (void)d;
   struct wayws_state *state = g_state;
-  struct ws *w = ctx_of(h);
+  struct ws *w = ctx_of(g_state, h);
   if (coords->size >= (sizeof(int32_t) * 2)) {
     int32_t *data = coords->data;
     w->x = data[0];
@@ -51,14 +51,14 @@ static void cb_coordinates(void *d, struct ext_workspace_handle_v1 *h,
                      w->active, w->urgent, w->hidden, DIR_NONE);
   } else {
     emit_event(state, EVENT_WORKSPACE_COORDINATES, w->name, output_name, w->index + 1,
-               w->x, w->y, w->active, w->urgent, w->hidden, DIR_NONE, NULL);
+               w->x, w->y, w->active, w->urgent, w->hidden, DIR_NONE, w);
   }
 }
 
 static void cb_state(void *d, struct ext_workspace_handle_v1 *h,
                      uint32_t bits) {
   struct wayws_state *state = g_state;
-  struct ws *w = ctx_of(h);
+  struct ws *w = ctx_of(g_state, h);
   int was_active = w->active;
   w->active = !!(bits & EXT_WORKSPACE_HANDLE_V1_STATE_ACTIVE);
   w->urgent = !!(bits & EXT_WORKSPACE_HANDLE_V1_STATE_URGENT);
@@ -75,14 +75,13 @@ static void cb_state(void *d, struct ext_workspace_handle_v1 *h,
                      w->active, w->urgent, w->hidden, DIR_NONE);
   } else {
     emit_event(state, EVENT_WORKSPACE_STATE, w->name, output_name, w->index + 1,
-               w->x, w->y, w->active, w->urgent, w->hidden, DIR_NONE, NULL);
+               w->x, w->y, w->active, w->urgent, w->hidden, DIR_NONE, w);
   }
 }
 
-static void stub_id(void *d, struct ext_workspace_handle_v1 *h, const char *s) {
+static void cb_id(void *d, struct ext_workspace_handle_v1 *h, const char *id) {
   (void)d;
-  (void)h;
-  (void)s;
+  ws_set_id(g_state, ctx_of(g_state, h), id);
 }
 
 static void stub_u32(void *d, struct ext_workspace_handle_v1 *h, uint32_t v) {
@@ -93,36 +92,33 @@ static void stub_u32(void *d, struct ext_workspace_handle_v1 *h, uint32_t v) {
 
 static void cb_ws_removed(void *d, struct ext_workspace_handle_v1 *h) {
   struct wayws_state *state = g_state;
-  struct ws *w = ctx_of(h);
+  struct ws *w = ctx_of(g_state, h);
   if (!w) return;
   
   // Clean up any pending events for this workspace
   cleanup_pending_events_for_workspace(state, w);
   
-  // Emit workspace destroyed event
-  emit_event(state, EVENT_WORKSPACE_DESTROYED, w->name, NULL, w->index + 1,
-             w->x, w->y, w->active, w->urgent, w->hidden, DIR_NONE, NULL);
+  // Emit workspace destroyed event, on the output it was last seen on so
+  // that --match output= still lets it through
+  emit_event(state, EVENT_WORKSPACE_DESTROYED, w->name,
+             strintern_str(&state->output_names, ws_output_id(w)),
+             w->index + 1, w->x, w->y, w->active, w->urgent, w->hidden,
+             DIR_NONE, w);
   
-  // Remove from vector
-  for (size_t i = 0; i < state->vlen; i++) {
-    if (state->vec[i] == w) {
-      state->vec[i] = state->vec[state->vlen - 1];
-      state->vlen--;
-      break;
-    }
-  }
+  ws_unindex(state, w);
   
-  // Clean up workspace data
-  free(w->name);
-  w->name = NULL;
+  // Drop from its group first: member lookup relies on the current index
+  if (w->group) {
+    group_remove_ws(w->group, w);
+    w->group = NULL;
+  }
+  unlist_ws(state, w);
   
-  // Don't destroy the wayland object here - let wayland handle it
-  // ext_workspace_handle_v1_destroy(h);
-  // free(w);
+  ws_destroy(state, w);
 }
 
 static const struct ext_workspace_handle_v1_listener ws_listener = {
-    .id = stub_id,
+    .id = cb_id,
     .name = cb_name,
     .coordinates = cb_coordinates,
     .state = cb_state,
@@ -147,7 +143,7 @@ static void out_geometry(void *d, struct wl_output *o, int32_t x, int32_t y,
 
 static void out_name(void *d, struct wl_output *o, const char *name) {
   (void)o;
-  ((struct output *)d)->name = xstrdup(name);
+  output_set_name(g_state, d, name);
 }
 
 static void out_description(void *d, struct wl_output *o, const char *desc) {
@@ -157,8 +153,14 @@ static void out_description(void *d, struct wl_output *o, const char *desc) {
 }
 
 static void out_done(void *d, struct wl_output *o) {
-  (void)d;
   (void)o;
+  struct output *out = d;
+  struct wayws_state *state = g_state;
+  if (!out->done) {
+    out->done = 1;
+    state->outputs_pending--;
+  }
+  end_event_batch(state);
 }
 
 static void out_scale(void *d, struct wl_output *o, int32_t factor) {
@@ -198,17 +200,16 @@ static void group_output_enter(void *d, struct ext_workspace_group_handle_v1 *h,
   (void)h;
   struct workspace_group *g = d;
   struct wayws_state *state = g_state;
-  struct group_output *node = calloc(1, sizeof *node);
-  if (!node) return;
-  
-  for (struct output *o = state->all_outputs; o; o = o->next) {
-    if (o->output == output) {
-      node->output = o;
-      break;
-    }
-  }
-  node->next = g->outputs;
-  g->outputs = node;
+  // NULL once we destroyed the proxy on global_remove
+  if (!output)
+    return;
+  // Our struct output is the listener data of the bound wl_output proxy
+  struct output *o = wl_proxy_get_user_data((struct wl_proxy *)output);
+  if (!o)
+    return;
+  struct group_output *node = group_output_link(state, g, o);
+  if (!node)
+    return;
   if (node->output) {
     // Emit output enter event
     emit_event(state, EVENT_OUTPUT_ENTER, NULL, 
@@ -216,18 +217,19 @@ static void group_output_enter(void *d, struct ext_workspace_group_handle_v1 *h,
                0, 0, 0, 0, 0, 0, DIR_NONE, NULL);
     
     // Emit workspace enter events for pending workspaces and emit pending events
-    for (size_t i = 0; i < state->vlen; ++i) {
-      if (state->vec[i]->group == g && state->vec[i]->pending_enter) {
+    for (size_t i = 0; i < g->nmembers; ++i) {
+      struct ws *w = g->members[i];
+      if (w->pending_enter) {
         const char *out_name = node->output->name ? node->output->name : "(unknown)";
         emit_event(state, EVENT_WORKSPACE_ENTER, 
-                   state->vec[i]->name ? state->vec[i]->name : "", out_name,
-                   state->vec[i]->index + 1, state->vec[i]->x, state->vec[i]->y,
-                   state->vec[i]->active, state->vec[i]->urgent, state->vec[i]->hidden,
-                   DIR_NONE, NULL);
-        state->vec[i]->pending_enter = 0;
+                   w->name ? w->name : "", out_name,
+                   w->index + 1, w->x, w->y,
+                   w->active, w->urgent, w->hidden,
+                   DIR_NONE, w);
+        w->pending_enter = 0;
         
         // Emit any pending events for this workspace now that output is available
-        emit_pending_events_for_workspace(state, state->vec[i]);
+        emit_pending_events_for_workspace(state, w);
       }
     }
   }
@@ -238,20 +240,16 @@ static void group_output_leave(void *d, struct ext_workspace_group_handle_v1 *h,
   (void)h;
   struct workspace_group *g = d;
   struct wayws_state *state = g_state;
-  struct group_output **pp = &g->outputs;
-  while (*pp) {
-    if ((*pp)->output && (*pp)->output->output == output) {
-      struct group_output *tmp = *pp;
-      // Emit output leave event
-      emit_event(state, EVENT_OUTPUT_LEAVE, NULL,
-                 tmp->output && tmp->output->name ? tmp->output->name : "(unknown)",
-                 0, 0, 0, 0, 0, 0, DIR_NONE, NULL);
-      *pp = tmp->next;
-      free(tmp);
-      break;
-    }
-    pp = &(*pp)->next;
-  }
+  // The output's global may be gone already (reg_remove() unlinked it)
+  if (!output)
+    return;
+  struct output *o = wl_proxy_get_user_data((struct wl_proxy *)output);
+  if (!o)
+    return;
+  // Emit output leave event
+  emit_event(state, EVENT_OUTPUT_LEAVE, NULL, o->name ? o->name : "(unknown)",
+             0, 0, 0, 0, 0, 0, DIR_NONE, NULL);
+  group_output_unlink(state, g, o);
 }
 
 static void group_workspace_enter(void *d,
@@ -260,14 +258,17 @@ static void group_workspace_enter(void *d,
   (void)h;
   struct workspace_group *g = d;
   struct wayws_state *state = g_state;
-  struct ws *w = ctx_of(workspace);
+  struct ws *w = ctx_of(state, workspace);
+  if (w->group && w->group != g)
+    group_remove_ws(w->group, w);
   w->group = g;
+  group_add_ws(g, w);
   if (g->outputs && g->outputs->output && g->outputs->output->name) {
     // Emit workspace enter event
     emit_event(state, EVENT_WORKSPACE_ENTER, 
                w->name ? w->name : "", g->outputs->output->name,
                w->index + 1, w->x, w->y, w->active, w->urgent, w->hidden,
-               DIR_NONE, NULL);
+               DIR_NONE, w);
     
     // Emit any pending events for this workspace now that output is available
     emit_pending_events_for_workspace(state, w);
@@ -282,7 +283,7 @@ static void group_workspace_leave(void *d,
   (void)h;
   struct workspace_group *g = d;
   struct wayws_state *state = g_state;
-  struct ws *w = ctx_of(workspace);
+  struct ws *w = ctx_of(state, workspace);
   const char *out_name = "(unknown)";
   if (g->outputs && g->outputs->output && g->outputs->output->name)
     out_name = g->outputs->output->name;
@@ -290,8 +291,11 @@ static void group_workspace_leave(void *d,
   emit_event(state, EVENT_WORKSPACE_LEAVE, 
              w->name ? w->name : "", out_name,
              w->index + 1, w->x, w->y, w->active, w->urgent, w->hidden,
-             DIR_NONE, NULL);
-  w->group = NULL;
+             DIR_NONE, w);
+  ws_leave_group(w, g);
+  group_remove_ws(g, w);
+  if (w->group == g)
+    w->group = NULL;
   w->pending_enter = 0;
 }
 
@@ -307,14 +311,9 @@ static void group_removed(void *d, struct ext_workspace_group_handle_v1 *h) {
     }
     pp = &(*pp)->next;
   }
-  for (struct group_output *n = g->outputs, *next; n; n = next) {
-    next = n->next;
-    free(n);
-  }
-  for (size_t i = 0; i < state->vlen; ++i)
-    if (state->vec[i]->group == g)
-      state->vec[i]->group = NULL;
-  free(g);
+  while (g->outputs)
+    group_output_unlink(state, g, g->outputs->output);
+  group_destroy(state, g);
 }
 
 static const struct ext_workspace_group_handle_v1_listener group_listener = {
@@ -330,18 +329,15 @@ static void mgr_workspace(void *d, struct ext_workspace_manager_v1 *m,
                           struct ext_workspace_handle_v1 *h) {
   (void)d;
   struct wayws_state *state = g_state;
-  struct ws *w = ctx_of(h);
+  struct ws *w = ctx_of(g_state, h);
   
-  ext_workspace_handle_v1_add_listener(h, &ws_listener, w);
+  if (state->plan & NEED_WS_EVENTS)
+    ext_workspace_handle_v1_add_listener(h, &ws_listener, w);
   
-  // Add workspace to vector
-  if (state->vlen >= state->vcap) {
-    state->vcap = state->vcap ? state->vcap * 2 : 8;
-    state->vec = xrealloc(state->vec, state->vcap * sizeof *state->vec);
-  }
-  w->index = state->vlen;
-  w->listed = 1;  // Mark as listed to prevent duplicates in list_ws
-  state->vec[state->vlen++] = w;
+  // Add workspace to vector (appending keeps every group's members sorted)
+  list_ws(state, w);
+  if (w->group)
+    group_add_ws(w->group, w);
   
   // Emit workspace created event (may be deferred if output not available)
   const char *output_name = get_output_name_for_workspace(w);
@@ -351,7 +347,7 @@ static void mgr_workspace(void *d, struct ext_workspace_manager_v1 *m,
                      w->active, w->urgent, w->hidden, DIR_NONE);
   } else {
     emit_event(state, EVENT_WORKSPACE_CREATED, w->name, output_name, w->index + 1,
-               w->x, w->y, w->active, w->urgent, w->hidden, DIR_NONE, NULL);
+               w->x, w->y, w->active, w->urgent, w->hidden, DIR_NONE, w);
   }
 }
 
@@ -359,12 +355,22 @@ static void mgr_workspace_group(void *d, struct ext_workspace_manager_v1 *m,
                                 struct ext_workspace_group_handle_v1 *h) {
   (void)d;
   struct wayws_state *state = g_state;
-  struct workspace_group *g = group_ctx_of(h);
+  // Without a listener libwayland silently drops the group's events.
+  if (!(state->plan & NEED_GROUPS))
+    return;
+  struct workspace_group *g = group_ctx_of(state, h);
   ext_workspace_group_handle_v1_add_listener(h, &group_listener, g);
   g->next = state->workspace_groups;
   state->workspace_groups = g;
 }
 
+static void mgr_done(void *d, struct ext_workspace_manager_v1 *m) {
+  (void)m;
+  struct wayws_state *state = d;
+  state->mgr_done = 1;
+  end_event_batch(state);
+}
+
 static void stub_mgr(void *d, struct ext_workspace_manager_v1 *m) {
   (void)d;
   (void)m;
@@ -373,7 +379,7 @@ static void stub_mgr(void *d, struct ext_workspace_manager_v1 *m) {
 static const struct ext_workspace_manager_v1_listener mgr_listener = {
     .workspace_group = mgr_workspace_group,
     .workspace = mgr_workspace,
-    .done = stub_mgr,
+    .done = mgr_done,
     .finished = stub_mgr,
 };
 
@@ -382,27 +388,51 @@ static void reg_global(void *d, struct wl_registry *r, uint32_t name,
   (void)r;
   struct wayws_state *state = d;
   if (strcmp(iface, "ext_workspace_manager_v1") == 0) {
-    state->mgr = wl_registry_bind(r, name, &ext_workspace_manager_v1_interface, 1);
+    // Bound once the registry is synced: its initial burst names wl_outputs
+    // in output_enter, and those may be announced after the manager
+    if (!state->mgr_name)
+      state->mgr_name = name;
   } else if (strcmp(iface, "wl_output") == 0) {
-    struct output *out = calloc(1, sizeof *out);
-    if (!out) return;
+    if (!(state->plan & NEED_OUTPUTS))
+      return;
+    struct output *out = slab_alloc(&state->output_slab);
+    out->global_name = name;
     
-    out->output = wl_registry_bind(r, name, &wl_output_interface, 4);
+    // name/description need v4; done exists since v2
+    out->output = wl_registry_bind(r, name, &wl_output_interface, ver < 4 ? ver : 4);
     if (!out->output) {
-      free(out);
+      slab_release(&state->output_slab, out);
       return;
     }
     
     wl_output_add_listener(out->output, &out_listener, out);
+    if (ver >= 2)
+      state->outputs_pending++;
+    else
+      out->done = 1;
     out->next = state->all_outputs;
     state->all_outputs = out;
   }
 }
 
 static void reg_remove(void *d, struct wl_registry *r, uint32_t n) {
-  (void)d;
   (void)r;
-  (void)n;
+  struct wayws_state *state = d;
+  struct output **pp = &state->all_outputs;
+  while (*pp && (*pp)->global_name != n)
+    pp = &(*pp)->next;
+  struct output *o = *pp;
+  if (!o)
+    return;
+  *pp = o->next;
+  // Groups normally send output_leave first; drop any links that remain
+  while (o->ngroups)
+    group_output_unlink(state, o->groups[o->ngroups - 1], o);
+  if (!o->done) {
+    o->done = 1;
+    state->outputs_pending--;
+  }
+  output_destroy(state, o);
 }
 
 static const struct wl_registry_listener reg_listener = {
@@ -410,24 +440,58 @@ static const struct wl_registry_listener reg_listener = {
     .global_remove = reg_remove,
 };
 
+static void registry_synced(void *d, struct wl_callback *cb, uint32_t data) {
+  (void)data;
+  struct wayws_state *state = d;
+  wl_callback_destroy(cb);
+  // Every global has been announced, and every output bound, by now.
+  state->registry_done = 1;
+  if (!state->mgr_name)
+    die("Compositor does not support ext-workspace-v1.\n");
+}
+
+static const struct wl_callback_listener registry_sync_listener = {
+    .done = registry_synced,
+};
+
+static int startup_complete(const struct wayws_state *state) {
+  return state->registry_done && state->mgr_done && state->outputs_pending <= 0;
+}
+
 void wayland_init(struct wayws_state *state) {
   state->dpy = wl_display_connect(NULL);
   if (!state->dpy)
     die("Failed to connect to Wayland display.\n");
   state->mgr = NULL;
+  state->mgr_name = 0;
+  state->registry_done = 0;
+  state->mgr_done = 0;
+  state->outputs_pending = 0;
   
   // Clear any existing workspace data
   state->vlen = 0;
   state->vcap = 0;
   state->vec = NULL;
   
+  // Outputs are bound from reg_global() as they are announced; the sync
+  // callback tells us the announcement is over, and only then is the
+  // manager bound, so that every wl_output its groups enter is already
+  // ours. After that we wait for the compositor's own "state is complete"
+  // signals (manager done plus the initial done of every bound output)
+  // instead of a second blind roundtrip.
   struct wl_registry *reg = wl_display_get_registry(state->dpy);
   wl_registry_add_listener(reg, &reg_listener, state);
-  wl_display_roundtrip(state->dpy);
-  if (!state->mgr)
-    die("Compositor does not support ext-workspace-v1.\n");
+  struct wl_callback *cb = wl_display_sync(state->dpy);
+  wl_callback_add_listener(cb, &registry_sync_listener, state);
+  while (!state->registry_done)
+    if (wl_display_dispatch(state->dpy) < 0)
+      die("Lost connection to the Wayland compositor during startup.\n");
+  state->mgr = wl_registry_bind(reg, state->mgr_name,
+                                &ext_workspace_manager_v1_interface, 1);
   ext_workspace_manager_v1_add_listener(state->mgr, &mgr_listener, state);
-  wl_display_roundtrip(state->dpy);
+  while (!startup_complete(state))
+    if (wl_display_dispatch(state->dpy) < 0)
+      die("Lost connection to the Wayland compositor during startup.\n");
 }
 
 void wayland_destroy(struct wayws_state *state) {
@@ -6,6 +6,13 @@
  *   - Activate by index, name, or relative direction (grid navigation)
  *   - Watch mode printing events (-w)
  *   - Waybar / JSON output
+ *   - Daemon mode (--daemon) keeping the connection and model alive; one-shot
+ *     invocations forward their command line to it over a Unix socket
+ *   - Event server (--serve) sharing one connection between watchers on the
+ *     display; a -w started with --subscribe registers its filter with it
+ *     over a Unix socket
+ *   - Shared-memory snapshot: long-running modes publish the model, and
+ *     --from-shm prints -l / --json from it without connecting
  *
  * Directional movement treats each *output* as its own grid (width --grid N).
  * The order inside a grid is the order we discovered workspaces (stable).
@@ -23,17 +30,17 @@
  *   associated with an output (initial mapping / migration). Activating an
  *   already‑mapped workspace does NOT send workspace_enter. We *do* get a
  *   state event each time ACTIVE bit changes, so we attach a monotonically
- *   increasing last_active_seq there. Because main() performs two roundtrips
- *   before acting on CLI switches, one‑shot commands already have the full
- *   initial state and activation ordering.
+ *   increasing last_active_seq there. Because wayland_init() waits for the
+ *   manager's done event (and every output's done) before main() acts on CLI
+ *   switches, one‑shot commands already have the full initial state and
+ *   activation ordering.
  */
 
 #define _POSIX_C_SOURCE 200809L
 #define _DEFAULT_SOURCE
 
 #include <ctype.h>
-#include <getopt.h>
-#include <poll.h>
+#include <errno.h>
 #include <signal.h>
 #include <stdbool.h>
 #include <stdint.h>
@@ -51,150 +58,61 @@
 #include "wayland.h"
 #include "workspace.h"
 #include "event.h"
+#include "daemon.h"
+#include "plan.h"
+#include "filter.h"
+#include "template.h"
+#include "rules.h"
+#include "proc.h"
+#include "activate.h"
+#include "serve.h"
+#include "shm.h"
+#include "writer.h"
+#include "backlog.h"
+#include "loop.h"
+#include "cli.h"
 
-static void usage(const struct wayws_state *state, const char *prg) {
-  printf("Usage: %s [options] [<index>|<name>]\n\n"
-         "Options:\n"
-         "  -l, --list           List workspaces\n"
-         "  -w, --watch          Stay running and print JSON events\n"
-         "  -g, --grid N         Set grid width (default: 3)\n"
-         "  -e, --exec CMD       Execute command after an event or switch\n"
-         "      --waybar         Output in Waybar JSON format\n"
-         "      --json           Output in raw JSON format\n"
-         "      --output NAME    Filter output by output name\n"
-         "      --glyph-active G Set active workspace glyph (default: %s)\n"
-         "      --glyph-empty G  Set empty workspace glyph (default: %s)\n"
-         "      --up, --down, --left, --right  Navigate workspaces\n"
-         "      --debug-info     Print debugging information\n",
-         prg, state->glyph_active, state->glyph_empty);
-  exit(1);
-}
-
-static void parse_cli(struct wayws_state *state, int ac, char **av) {
-  static struct option longopts[] = {{"list", 0, 0, 'l'},
-                                     {"watch", 0, 0, 'w'},
-                                     {"grid", 1, 0, 'g'},
-                                     {"exec", 1, 0, 'e'},
-                                     {"waybar", 0, 0, 1004},
-                                     {"json", 0, 0, 1009},
-                                     {"output", 1, 0, 1010},
-                                     {"glyph-active", 1, 0, 1005},
-                                     {"glyph-empty", 1, 0, 1006},
-                                     {"up", 0, 0, 1000},
-                                     {"down", 0, 0, 1001},
-                                     {"left", 0, 0, 1002},
-                                     {"right", 0, 0, 1003},
-                                     {"debug-info", 0, 0, 1008},
-                                     {0, 0, 0, 0}};
-  int ch;
-  while ((ch = getopt_long(ac, av, "lwg:e:", longopts, NULL)) != -1) {
-    switch (ch) {
-    case 'l':
-      state->flag_list = 1;
-      break;
-    case 'w':
-      state->flag_watch = 1;
-      state->event_enabled = 1;  // Enable events when watch mode is on
-      break;
-    case 'g':
-      state->grid_cols = atoi(optarg);
-      if (state->grid_cols <= 0)
-        usage(state, av[0]);
-      break;
-    case 'e':
-      state->opt_exec = optarg;
-      break;
-    case 1000:
-      state->move_dir = DIR_UP;
-      break;
-    case 1001:
-      state->move_dir = DIR_DOWN;
-      break;
-    case 1002:
-      state->move_dir = DIR_LEFT;
-      break;
-    case 1003:
-      state->move_dir = DIR_RIGHT;
-      break;
-    case 1004:
-      state->flag_waybar = 1;
-      break;
-    case 1009:
-      state->flag_json = 1;
-      break;
-    case 1010:
-      state->opt_output_name = optarg;
-      break;
-    case 1005:
-      state->glyph_active = optarg;
-      break;
-    case 1006:
-      state->glyph_empty = optarg;
-      break;
-    case 1008:
-      state->flag_debug = 1;
-      break;
-    default:
-      usage(state, av[0]);
-    }
-  }
-  if (optind < ac) {
-    if (state->move_dir != DIR_NONE)
-      die("Error: Cannot combine a directional move with an index or name.\n");
-    if (isnum(av[optind]))
-      state->want_idx = atoi(av[optind]);
-    else
-      state->want_name = av[optind];
-    ++optind;
-  }
-  if (optind != ac)
-    usage(state, av[0]);
-  int switching =
-      (state->want_idx > 0) || state->want_name || state->move_dir != DIR_NONE;
-  if (!state->flag_list && !switching && !state->flag_watch &&
-      !state->flag_waybar && !state->flag_json && !state->flag_debug)
-    usage(state, av[0]);
+// Lines lost count both the ring's and the backlog's
+static void print_stats(const struct wayws_state *state,
+                        const struct writer_stats *st) {
+  fprintf(stderr,
+          "wayws: output queue %zu bytes, depth %zu, high-water %zu, "
+          "dropped %lu lines, coalesced %lu events%s\n",
+          st->cap, st->depth, st->high_water,
+          st->dropped + state->backlog.dropped, state->backlog.coalesced,
+          st->failed ? ", write failed" : "");
 }
 
 static void cleanup(struct wayws_state *state) {
-  // Clean up workspaces - only free our wrapper objects, not the wayland objects
-  if (state->vec) {
-    for (size_t i = 0; i < state->vlen; i++) {
-      if (state->vec[i]) {
-        free(state->vec[i]->name);
-        // Don't free the wayland object, let wayland handle it
-        free(state->vec[i]);
-      }
-    }
-    free(state->vec);
-    state->vec = NULL;
-    state->vlen = 0;
-    state->vcap = 0;
+  flush_events(state);
+  if (state->writer) {
+    // Whatever is held back goes out before the thread stops
+    backlog_take(&state->backlog, &state->event_out, monotonic_ns());
+    flush_events(state);
+    struct writer_stats st;
+    writer_stop(state->writer, &st);
+    state->writer = NULL;
+    if (state->flag_stats)
+      print_stats(state, &st);
   }
-
-  // Clean up outputs - only free our wrapper objects
-  while (state->all_outputs) {
-    struct output *next = state->all_outputs->next;
-    free(state->all_outputs->name);
-    // Don't destroy the wayland output, let wayland handle it
-    free(state->all_outputs);
-    state->all_outputs = next;
-  }
-
-  // Clean up workspace groups - only free our wrapper objects
-  while (state->workspace_groups) {
-    struct workspace_group *next_group = state->workspace_groups->next;
-    for (struct group_output *n = state->workspace_groups->outputs, *next;
-         n;
-         n = next) {
-      next = n->next;
-      free(n);
-    }
-    // Don't destroy the wayland group, let wayland handle it
-    free(state->workspace_groups);
-    state->workspace_groups = next_group;
-  }
-
+  backlog_free(&state->backlog);
+  state->backlogging = 0;
+  outbuf_free(&state->event_out);
+  outbuf_free(&state->lat_out);
+  free(state->lat_marks);
+  state->lat_marks = NULL;
+  state->nlat = state->lat_cap = 0;
+  template_free(&state->format);
+  exec_destroy(&state->exec);
+  exec_free_argv(state->exec_argv);
+  state->exec_argv = NULL;
+  free_signals(state);
+  rules_free(state->rules);
+  state->rules = NULL;
+  shm_publisher_close(state->shm);
+  state->shm = NULL;
+  // Proxies first, while the display is still connected
+  model_destroy(state);
   wayland_destroy(state);
 }
 
@@ -206,11 +124,11 @@ static void signal_handler(int sig) {
   g_interrupted = 1;
 }
 
-// Don't use atexit cleanup - let wayland handle its own cleanup
+// Runs on every exit path, including die(). Both halves of cleanup() leave
+// the state empty, so running it twice is harmless.
 static void global_cleanup(void) {
-  // Disabled to avoid segfaults
-  // if (g_state)
-  //   cleanup(g_state);
+  if (g_state)
+    cleanup(g_state);
 }
 
 static void print_debug_info(struct wayws_state *state) {
@@ -254,48 +172,184 @@ static void print_debug_info(struct wayws_state *state) {
   printf("------------------\n");
 }
 
-static struct ws *find_target_workspace(struct wayws_state *state) {
-  if (state->move_dir != DIR_NONE) {
-    return neighbor(state, state->move_dir);
+static int fail(const char *msg) {
+  fputs(msg, stderr);
+  return 1;
+}
+
+// Runs the parsed one-shot command (listing, output formats, activation)
+// against an initialised model. Errors are reported instead of exiting so
+// the daemon survives a bad request.
+static int run_command(struct wayws_state *state) {
+  if (state->flag_debug) {
+    print_debug_info(state);
   }
-  if (state->want_name) {
-    if (!state->vec || state->vlen == 0) {
-      return NULL;
+
+  if (state->flag_list) {
+    if (!state->vec || state->vlen == 0)
+      return fail("No workspaces found to list.\n");
+    if (state->opt_format) {
+      print_formatted_list(state);
+    } else {
+      struct tpl_record r;
+      for (size_t i = 0; i < state->vlen; i++) {
+        workspace_record(state->vec[i], &r);
+        print_list_record(&r);
+      }
     }
-    for (size_t i = 0; i < state->vlen; i++)
-      if (state->vec[i]->name &&
-          strcmp(state->vec[i]->name, state->want_name) == 0)
-        return state->vec[i];
   }
-  if (state->want_idx > 0) {
-    if (!state->vec || state->vlen == 0) {
-      return NULL;
+
+  if (state->flag_waybar) {
+    if (!state->vec || state->vlen == 0)
+      return fail("No workspaces found for Waybar output.\n");
+    if (print_waybar_output(state) != 0)
+      return 1;
+  }
+
+  if (state->flag_json) {
+    if (!state->vec || state->vlen == 0)
+      return fail("No workspaces found for JSON output.\n");
+    // -l already printed the formatted records
+    if (!state->opt_format)
+      print_json_output(state);
+    else if (!state->flag_list)
+      print_formatted_list(state);
+  }
+
+  if (state->bench_activations)
+    return activate_bench(state, state->bench_activations,
+                          state->wait_ms ? state->wait_ms : ACTIVATE_WAIT_MS,
+                          &g_interrupted);
+
+  struct ws *target = find_target_workspace(state);
+  if (target) {
+    activate_workspace(state, target);
+    if (state->wait_ms) {
+      int r = activate_wait(state, slab_handle(&state->ws_slab, target),
+                            state->wait_ms);
+      if (r > 0)
+        return fail("Timed out waiting for the workspace to become active.\n");
+      if (r < 0)
+        return fail("Workspace went away before it became active.\n");
     }
-    if ((size_t)state->want_idx <= state->vlen)
-      return state->vec[state->want_idx - 1];
+  } else if (state->want_idx > 0 || state->want_name || state->want_id ||
+             state->move_dir != DIR_NONE) {
+    return fail("workspace not found / edge\n");
   }
-  return NULL;
+  return 0;
 }
 
-static void activate_workspace(struct wayws_state *state, struct ws *target) {
-  ext_workspace_handle_v1_activate(target->h);
-  ext_workspace_manager_v1_commit(state->mgr);
-  wl_display_flush(state->dpy);
-  
-  // Execute command for all workspace activations
-  if (state->opt_exec) {
-    system(state->opt_exec);
+static int run_forwarded(struct wayws_state *state, int argc, char **argv) {
+  // Pick up anything the compositor sent since the last command (e.g. the
+  // state change caused by a previous activation) before acting on it.
+  if (wl_display_roundtrip(state->dpy) < 0)
+    return 1;
+  set_cli_defaults(state);
+  // The client parsed it too, but not in our working directory (--rules)
+  // and maybe not with our parser
+  optind = 0;
+  if (parse_cli(state, argc, argv, 1) != 0)
+    return 1;
+  return run_command(state);
+}
+
+// The watch loop's sources, each pointing back here through its data
+struct watch {
+  struct wayws_state *state;
+  struct loop loop;
+  struct loop_source wl, sig, room;
+  int read; // the Wayland fd was read this round
+  int lost; // and that failed: the compositor is gone
+};
+
+static void on_wayland(struct loop_source *src, uint32_t events) {
+  (void)events;
+  struct watch *w = src->data;
+  w->read = 1;
+  if (wl_display_read_events(w->state->dpy) != 0)
+    w->lost = 1;
+  else
+    w->state->read_ns = monotonic_ns();
+}
+
+static void on_signal(struct loop_source *src, uint32_t events) {
+  (void)events;
+  struct watch *w = src->data;
+  for (int sig; (sig = loop_signal(src)) > 0;) {
+    if (sig == SIGCHLD) {
+      exec_reap(&w->state->exec);
+    } else if (sig == SIGUSR1) {
+      if (w->state->writer) {
+        struct writer_stats st;
+        writer_get_stats(w->state->writer, &st);
+        print_stats(w->state, &st);
+      }
+    } else {
+      g_interrupted = 1;
+    }
   }
 }
 
-int main(int argc, char **argv) {
-  struct wayws_state state = {
-      .glyph_active = "●",
-      .glyph_empty = "○",
-      .grid_cols = 3,
-      .want_idx = -1,
-      .event_enabled = 0,  // Events disabled by default
+static void on_room(struct loop_source *src, uint32_t events) {
+  (void)events;
+  struct watch *w = src->data;
+  uint64_t n;
+  ssize_t r = read(src->fd, &n, sizeof n); // spent; drain_backlog() re-arms
+  (void)r;
+  // Mid-batch this does nothing, and the end of the batch drains instead
+  drain_backlog(w->state);
+}
+
+// Dispatches until SIGINT/SIGTERM or until the compositor goes away. Signals
+// come through the loop's signalfd rather than handlers, so there is no
+// window between checking g_interrupted and going to sleep, and nothing to
+// wake up for while the compositor is quiet.
+static void watch_run(struct wayws_state *state) {
+  struct watch w = {
+      .state = state,
+      .wl = {.fd = wl_display_get_fd(state->dpy), .fn = on_wayland, .data = &w},
+      .sig = {.fn = on_signal, .data = &w},
+      .room = {.fd = state->writer ? writer_room_fd(state->writer) : -1,
+               .fn = on_room,
+               .data = &w},
   };
+  // Hooks finishing raise SIGCHLD; never wait on a child here
+  sigset_t set;
+  sigemptyset(&set);
+  sigaddset(&set, SIGINT);
+  sigaddset(&set, SIGTERM);
+  sigaddset(&set, SIGCHLD);
+  if (state->flag_stats)
+    sigaddset(&set, SIGUSR1);
+  if (loop_init(&w.loop) != 0 || loop_add(&w.loop, &w.wl, EPOLLIN) != 0 ||
+      loop_add_signals(&w.loop, &w.sig, &set) != 0 ||
+      (w.room.fd >= 0 && loop_add(&w.loop, &w.room, EPOLLIN) != 0))
+    die("Failed to set up the watch loop.\n");
+  // Any hook that ended before SIGCHLD was blocked
+  exec_reap(&state->exec);
+
+  while (!g_interrupted && !w.lost) {
+    while (wl_display_prepare_read(state->dpy) != 0)
+      wl_display_dispatch_pending(state->dpy);
+    wl_display_flush(state->dpy);
+    w.read = 0;
+    int n = loop_dispatch(&w.loop, -1);
+    if (!w.read)
+      wl_display_cancel_read(state->dpy);
+    if (n < 0)
+      break;
+    wl_display_dispatch_pending(state->dpy);
+  }
+
+  loop_remove(&w.loop, &w.room);
+  loop_remove(&w.loop, &w.wl);
+  loop_destroy(&w.loop);
+}
+
+int main(int argc, char **argv) {
+  // Static so that global_cleanup can still reach it after main returns
+  static struct wayws_state state;
+  set_cli_defaults(&state);
   g_state = &state;
   atexit(global_cleanup);
   
@@ -303,90 +357,62 @@ int main(int argc, char **argv) {
   signal(SIGINT, signal_handler);
   signal(SIGTERM, signal_handler);
 
-  parse_cli(&state, argc, argv);
-  
-  wayland_set_global_state(&state);
-  wayland_init(&state);
+  parse_cli(&state, argc, argv, 0);
 
-  if (state.flag_debug) {
-    print_debug_info(&state);
+  // Straight from a publisher's snapshot, without Wayland or a daemon
+  if (state.flag_from_shm) {
+    char path[256];
+    if (shm_path(path, sizeof path) != 0)
+      die("XDG_RUNTIME_DIR is not set; cannot find the snapshot.\n");
+    return shm_print(&state, path);
   }
 
-  if (state.flag_list) {
-    if (!state.vec || state.vlen == 0)
-      die("No workspaces found to list.\n");
-    else {
-      for (size_t i = 0; i < state.vlen; i++) {
-        const char *out_name = "(unknown)";
-        if (state.vec[i]->group && state.vec[i]->group->outputs &&
-            state.vec[i]->group->outputs->output &&
-            state.vec[i]->group->outputs->output->name)
-          out_name = state.vec[i]->group->outputs->output->name;
-        printf("%2zu  %-15s %-10s %s\n", i + 1, out_name,
-               (state.vec[i]->name && state.vec[i]->name[0]) ? state.vec[i]->name
-                                                             : "(unnamed)",
-               state.vec[i]->active ? "*" : "");
-      }
-    }
+  // Hand one-shot commands to a running daemon; fall back to connecting
+  // ourselves when there is none.
+  if (!state.flag_watch && !state.flag_daemon && !state.flag_serve &&
+      !state.flag_no_daemon) {
+    int status;
+    if (daemon_forward(argc, argv, &status) == 0)
+      return status;
   }
-
-  if (state.flag_waybar) {
-    if (!state.vec || state.vlen == 0)
-      die("No workspaces found for Waybar output.\n");
-    print_waybar_output(&state);
+  // Watchers that asked for it subscribe to a running event server. Only
+  // on request: its stream starts from a state snapshot rather than the
+  // initial events a connection of our own prints.
+  if (state.flag_subscribe) {
+    int status = serve_subscribe(&state.event_filter, &g_interrupted);
+    if (status >= 0)
+      return status;
   }
+  
+  state.plan = startup_plan(&state);
+  model_init(&state);
+  wayland_set_global_state(&state);
+  wayland_init(&state);
 
-  if (state.flag_json) {
-    if (!state.vec || state.vlen == 0)
-      die("No workspaces found for JSON output.\n");
-    print_json_output(&state);
+  // Long-running modes publish the model for --from-shm readers; the
+  // first one on the display wins
+  if (state.flag_watch || state.flag_daemon || state.flag_serve) {
+    char path[256];
+    if (shm_path(path, sizeof path) == 0 &&
+        (state.shm = shm_publisher_open(path)))
+      shm_publish(state.shm, &state);
   }
 
-  struct ws *target = find_target_workspace(&state);
-  if (target) {
-    activate_workspace(&state, target);
-  } else if (state.want_idx > 0 || state.want_name ||
-             state.move_dir != DIR_NONE) {
-    die("workspace not found / edge\n");
-  }
+  if (state.flag_daemon)
+    return daemon_run(&state, run_forwarded, &g_interrupted);
+  if (state.flag_serve)
+    return serve_run(&state, &g_interrupted);
+
+  int ret = run_command(&state);
+  if (ret != 0)
+    return ret;
 
   if (state.flag_watch) {
-    while (!g_interrupted) {
-      // Prepare to read events
-      if (wl_display_prepare_read(state.dpy) != 0) {
-        // Events are pending, dispatch them
-        wl_display_dispatch_pending(state.dpy);
-        continue;
-      }
-      
-      // Set up poll to wait for events with timeout
-      struct pollfd pfd = {
-        .fd = wl_display_get_fd(state.dpy),
-        .events = POLLIN,
-      };
-      
-      // Poll with 100ms timeout to allow signal checking
-      int poll_ret = poll(&pfd, 1, 100);
-      if (poll_ret == -1) {
-        // Poll error (likely interrupted by signal)
-        wl_display_cancel_read(state.dpy);
-        break;
-      } else if (poll_ret == 0) {
-        // Timeout - check if we should exit
-        wl_display_cancel_read(state.dpy);
-        continue;
-      }
-      
-      // Read events
-      int ret = wl_display_read_events(state.dpy);
-      if (ret != 0) {
-        // Error occurred, break
-        break;
-      }
-      
-      // Dispatch any pending events
-      wl_display_dispatch_pending(state.dpy);
-    }
+    // From here on events reach stdout through the writer thread, so a
+    // slow reader cannot hold up dispatch. Whatever -l printed goes first.
+    fflush(stdout);
+    state.writer = writer_start(STDOUT_FILENO, WRITER_RING_SIZE);
+    watch_run(&state);
   }
 
   return 0;
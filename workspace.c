@@ -1,10 +1,69 @@
 #include "workspace.h"
 #include "types.h"
 #include "util.h"
+#include "hash.h"
+#include "slab.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 
+void model_init(struct wayws_state *state) {
+  slab_init(&state->ws_slab, sizeof(struct ws));
+  slab_init(&state->group_slab, sizeof(struct workspace_group));
+  slab_init(&state->output_slab, sizeof(struct output));
+  slab_init(&state->link_slab, sizeof(struct group_output));
+}
+
+static void ws_teardown(void *obj, void *data) {
+  (void)data;
+  struct ws *w = obj;
+  free(w->name);
+  free(w->id);
+  if (w->h)
+    ext_workspace_handle_v1_destroy(w->h);
+}
+
+static void group_teardown(void *obj, void *data) {
+  (void)data;
+  struct workspace_group *g = obj;
+  free(g->members);
+  if (g->h)
+    ext_workspace_group_handle_v1_destroy(g->h);
+}
+
+static void output_teardown(void *obj, void *data) {
+  (void)data;
+  struct output *o = obj;
+  free(o->name);
+  free(o->groups);
+  if (!o->output)
+    return;
+  if (wl_proxy_get_version((struct wl_proxy *)o->output) >= 3)
+    wl_output_release(o->output);
+  else
+    wl_output_destroy(o->output);
+}
+
+// Releases the whole model in one pass over the slabs; the group -> output
+// nodes and any half-linked state go away with their chunks.
+void model_destroy(struct wayws_state *state) {
+  slab_foreach(&state->ws_slab, ws_teardown, NULL);
+  slab_foreach(&state->group_slab, group_teardown, NULL);
+  slab_foreach(&state->output_slab, output_teardown, NULL);
+  slab_destroy(&state->ws_slab);
+  slab_destroy(&state->group_slab);
+  slab_destroy(&state->output_slab);
+  slab_destroy(&state->link_slab);
+  free(state->vec);
+  state->vec = NULL;
+  state->vlen = state->vcap = 0;
+  state->all_outputs = NULL;
+  state->workspace_groups = NULL;
+  strmap_free(&state->ws_by_name);
+  strmap_free(&state->ws_by_id);
+  strintern_free(&state->output_names);
+}
+
 void list_ws(struct wayws_state *state, struct ws *w) {
   if (w->listed)
     return;
@@ -17,47 +76,179 @@ void list_ws(struct wayws_state *state, struct ws *w) {
   state->vec[state->vlen++] = w;
 }
 
-struct ws *ctx_of(struct ext_workspace_handle_v1 *h) {
+// Removes w from vec keeping discovery order. Later workspaces shift down
+// by one, which preserves the relative order of every group's members.
+void unlist_ws(struct wayws_state *state, struct ws *w) {
+  if (!w->listed || w->index >= state->vlen || state->vec[w->index] != w)
+    return;
+  size_t i = w->index;
+  memmove(&state->vec[i], &state->vec[i + 1],
+          (state->vlen - i - 1) * sizeof *state->vec);
+  state->vlen--;
+  for (; i < state->vlen; i++)
+    state->vec[i]->index = i;
+  w->listed = 0;
+}
+
+// First position in g->members whose index is >= idx
+static size_t member_pos(const struct workspace_group *g, size_t idx) {
+  size_t lo = 0, hi = g->nmembers;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (g->members[mid]->index < idx)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+void group_add_ws(struct workspace_group *g, struct ws *w) {
+  size_t pos = member_pos(g, w->index);
+  if (pos < g->nmembers && g->members[pos] == w)
+    return;
+  if (g->nmembers == g->members_cap) {
+    g->members_cap = g->members_cap ? g->members_cap * 2 : 8;
+    g->members = xrealloc(g->members, g->members_cap * sizeof *g->members);
+  }
+  memmove(&g->members[pos + 1], &g->members[pos],
+          (g->nmembers - pos) * sizeof *g->members);
+  g->members[pos] = w;
+  g->nmembers++;
+}
+
+void group_remove_ws(struct workspace_group *g, struct ws *w) {
+  size_t pos = member_pos(g, w->index);
+  if (pos >= g->nmembers || g->members[pos] != w)
+    return;
+  memmove(&g->members[pos], &g->members[pos + 1],
+          (g->nmembers - pos - 1) * sizeof *g->members);
+  g->nmembers--;
+}
+
+struct ws *ctx_of(struct wayws_state *state, struct ext_workspace_handle_v1 *h) {
   struct ws *w = wl_proxy_get_user_data((void *)h);
   if (!w) {
-    w = calloc(1, sizeof *w);
-    if (!w) return NULL;
+    w = slab_alloc(&state->ws_slab);
     w->h = h;
     wl_proxy_set_user_data((void *)h, w);
   }
   return w;
 }
 
-struct workspace_group *group_ctx_of(struct ext_workspace_group_handle_v1 *h) {
+// Frees a workspace the compositor removed. The caller must already have
+// dropped it from vec, its group, the indexes and the pending queues.
+void ws_destroy(struct wayws_state *state, struct ws *w) {
+  ws_teardown(w, NULL);
+  slab_release(&state->ws_slab, w);
+}
+
+void output_set_name(struct wayws_state *state, struct output *o,
+                     const char *name) {
+  free(o->name);
+  o->name = xstrdup(name);
+  o->name_id = strintern_id(&state->output_names, name);
+}
+
+// Frees an output whose global went away; it must no longer be linked.
+void output_destroy(struct wayws_state *state, struct output *o) {
+  output_teardown(o, NULL);
+  slab_release(&state->output_slab, o);
+}
+
+// Records that g is shown on o, in both directions. Returns the new
+// group -> output node, or NULL if the pair was already linked.
+struct group_output *group_output_link(struct wayws_state *state,
+                                       struct workspace_group *g,
+                                       struct output *o) {
+  for (struct group_output *go = g->outputs; go; go = go->next)
+    if (go->output == o)
+      return NULL;
+  struct group_output *node = slab_alloc(&state->link_slab);
+  node->output = o;
+  node->next = g->outputs;
+  g->outputs = node;
+  if (o->ngroups == o->groups_cap) {
+    o->groups_cap = o->groups_cap ? o->groups_cap * 2 : 4;
+    o->groups = xrealloc(o->groups, o->groups_cap * sizeof *o->groups);
+  }
+  o->groups[o->ngroups++] = g;
+  return node;
+}
+
+void ws_leave_group(struct ws *w, const struct workspace_group *g) {
+  if (g->outputs && g->outputs->output && g->outputs->output->name_id)
+    w->last_output = g->outputs->output->name_id;
+}
+
+uint32_t ws_output_id(const struct ws *w) {
+  const struct workspace_group *g = w->group;
+  if (g && g->outputs && g->outputs->output && g->outputs->output->name_id)
+    return g->outputs->output->name_id;
+  return w->last_output;
+}
+
+void group_output_unlink(struct wayws_state *state, struct workspace_group *g,
+                         struct output *o) {
+  // The members' output, if it was this one, is about to go
+  if (g->outputs && g->outputs->output == o)
+    for (size_t i = 0; i < g->nmembers; i++)
+      ws_leave_group(g->members[i], g);
+  for (struct group_output **pp = &g->outputs; *pp; pp = &(*pp)->next) {
+    if ((*pp)->output == o) {
+      struct group_output *tmp = *pp;
+      *pp = tmp->next;
+      slab_release(&state->link_slab, tmp);
+      break;
+    }
+  }
+  for (size_t i = 0; i < o->ngroups; i++) {
+    if (o->groups[i] == g) {
+      memmove(&o->groups[i], &o->groups[i + 1],
+              (o->ngroups - i - 1) * sizeof *o->groups);
+      o->ngroups--;
+      break;
+    }
+  }
+}
+
+struct workspace_group *group_ctx_of(struct wayws_state *state,
+                                     struct ext_workspace_group_handle_v1 *h) {
   struct workspace_group *g = wl_proxy_get_user_data((void *)h);
   if (!g) {
-    g = calloc(1, sizeof *g);
-    if (!g) return NULL;
+    g = slab_alloc(&state->group_slab);
     g->h = h;
     wl_proxy_set_user_data((void *)h, g);
   }
   return g;
 }
 
+// Frees a removed group after it was unlinked from its outputs and list.
+void group_destroy(struct wayws_state *state, struct workspace_group *g) {
+  for (size_t i = 0; i < g->nmembers; ++i)
+    g->members[i]->group = NULL;
+  group_teardown(g, NULL);
+  slab_release(&state->group_slab, g);
+}
+
 size_t group_size(struct wayws_state *state, struct workspace_group *g) {
-  size_t n = 0;
-  for (size_t i = 0; i < state->vlen; ++i)
-    if (state->vec[i]->group == g)
-      ++n;
-  return n;
+  (void)state;
+  return g->nmembers;
 }
 
 struct ws *current_ws(struct wayws_state *state, size_t *out) {
   if (state->opt_output_name) {
+    // output -> groups -> members; names compare as interned ids
+    uint32_t want = strintern_find(&state->output_names, state->opt_output_name);
     struct ws *best = NULL;
-    for (size_t i = 0; i < state->vlen; ++i) {
-      struct ws *w = state->vec[i];
-      if (!w->active || !w->group)
+    for (struct output *o = state->all_outputs; o && want; o = o->next) {
+      if (o->name_id != want)
         continue;
-      for (struct group_output *go = w->group->outputs; go; go = go->next) {
-        if (go->output && go->output->name &&
-            strcmp(go->output->name, state->opt_output_name) == 0) {
-          if (!best || w->last_active_seq > best->last_active_seq)
+      for (size_t g = 0; g < o->ngroups; ++g) {
+        struct workspace_group *grp = o->groups[g];
+        for (size_t i = 0; i < grp->nmembers; ++i) {
+          struct ws *w = grp->members[i];
+          if (w->active && (!best || w->last_active_seq > best->last_active_seq))
             best = w;
         }
       }
@@ -101,45 +292,16 @@ struct ws *neighbor(struct wayws_state *state, enum dir d) {
   if (!cur || !cur->group)
     return NULL;
   
-  // Count workspaces in this group first
-  size_t count = 0;
-  for (size_t i = 0; i < state->vlen; ++i) {
-    if (state->vec[i]->group == cur->group)
-      count++;
-  }
-  
+  // The group's members are already in index order
+  struct ws **group_ws = cur->group->members;
+  size_t count = cur->group->nmembers;
   if (!count)
     return NULL;
-    
-  // Allocate array on heap to avoid stack overflow
-  struct ws **group_ws = malloc(count * sizeof(struct ws *));
-  if (!group_ws) return NULL;
-  
-  // Fill the array
-  size_t idx = 0;
-  for (size_t i = 0; i < state->vlen; ++i) {
-    if (state->vec[i]->group == cur->group)
-      group_ws[idx++] = state->vec[i];
-  }
-  // Sort by index
-  for (size_t i = 0; i + 1 < count; ++i) {
-    for (size_t j = i + 1; j < count; ++j) {
-      if (group_ws[i]->index > group_ws[j]->index) {
-        struct ws *t = group_ws[i];
-        group_ws[i] = group_ws[j];
-        group_ws[j] = t;
-      }
-    }
-  }
   
   // Find current position
-  size_t cur_pos = 0;
-  while (cur_pos < count && group_ws[cur_pos] != cur)
-    cur_pos++;
-  if (cur_pos == count) {
-    free(group_ws);
+  size_t cur_pos = member_pos(cur->group, cur->index);
+  if (cur_pos == count || group_ws[cur_pos] != cur)
     return NULL;
-  }
   
   // Calculate grid position
   int x = (int)(cur_pos % state->grid_cols),
@@ -149,45 +311,109 @@ struct ws *neighbor(struct wayws_state *state, enum dir d) {
   // Calculate new position based on direction
   switch (d) {
   case DIR_UP:
-    if (y == 0) {
-      free(group_ws);
+    if (y == 0)
       return NULL;
-    }
     --y;
     break;
   case DIR_DOWN:
-    if (y >= rows - 1) {
-      free(group_ws);
+    if (y >= rows - 1)
       return NULL;
-    }
     ++y;
     break;
   case DIR_LEFT:
-    if (x == 0) {
-      free(group_ws);
+    if (x == 0)
       return NULL;
-    }
     --x;
     break;
   case DIR_RIGHT:
-    if (x >= state->grid_cols - 1) {
-      free(group_ws);
+    if (x >= state->grid_cols - 1)
       return NULL;
-    }
     ++x;
     break;
   default:
-    free(group_ws);
     return NULL;
   }
   
   size_t new_pos = (size_t)(y * state->grid_cols + x);
-  if (new_pos >= count) {
-    free(group_ws);
+  if (new_pos >= count)
     return NULL;
+  return group_ws[new_pos];
+}
+
+// The workspace a switch command asks for: a direction, else the id, else
+// the name, else the 1-based index.
+struct ws *find_target_workspace(struct wayws_state *state) {
+  if (state->move_dir != DIR_NONE)
+    return neighbor(state, state->move_dir);
+  if (state->want_id)
+    return ws_by_id(state, state->want_id);
+  if (state->want_name) {
+    struct ws *w = ws_by_name(state, state->want_name);
+    if (w)
+      return w;
   }
-  
-  struct ws *result = group_ws[new_pos];
-  free(group_ws);
-  return result;
-}
\ No newline at end of file
+  if (state->want_idx > 0 && (size_t)state->want_idx <= state->vlen)
+    return state->vec[state->want_idx - 1];
+  return NULL;
+}
+
+// Name and id indexes. When two workspaces share a key the one with the
+// lower global index wins, matching the linear scan they replaced.
+static const char *name_key(const struct ws *w) { return w->name; }
+static const char *id_key(const struct ws *w) { return w->id; }
+
+static void index_put(struct wayws_state *state, struct strmap *m,
+                      const char *key, struct ws *w) {
+  struct ws *cur = strmap_get(m, key);
+  if (cur && cur != w)
+    state->ws_keys_shared = 1;
+  if (!cur || cur == w || w->index < cur->index)
+    strmap_put(m, key, w);
+}
+
+static void index_drop(struct wayws_state *state, struct strmap *m,
+                       struct ws *w, const char *(*key_of)(const struct ws *)) {
+  const char *key = key_of(w);
+  if (!key || strmap_get(m, key) != w)
+    return;
+  strmap_remove(m, key);
+  if (!state->ws_keys_shared)
+    return;
+  // Another workspace may carry the same key; promote it.
+  for (size_t i = 0; i < state->vlen; i++) {
+    struct ws *o = state->vec[i];
+    const char *k = key_of(o);
+    if (o != w && k && strcmp(k, key) == 0)
+      index_put(state, m, k, o);
+  }
+}
+
+void ws_set_name(struct wayws_state *state, struct ws *w, const char *name) {
+  index_drop(state, &state->ws_by_name, w, name_key);
+  free(w->name);
+  w->name = xstrdup(name);
+  if (w->name)
+    index_put(state, &state->ws_by_name, w->name, w);
+}
+
+void ws_set_id(struct wayws_state *state, struct ws *w, const char *id) {
+  index_drop(state, &state->ws_by_id, w, id_key);
+  free(w->id);
+  w->id = xstrdup(id);
+  if (w->id)
+    index_put(state, &state->ws_by_id, w->id, w);
+}
+
+// Must run before w leaves vec and before its strings are freed.
+void ws_unindex(struct wayws_state *state, struct ws *w) {
+  index_drop(state, &state->ws_by_name, w, name_key);
+  index_drop(state, &state->ws_by_id, w, id_key);
+}
+
+struct ws *ws_by_name(struct wayws_state *state, const char *name) {
+  return strmap_get(&state->ws_by_name, name);
+}
+
+struct ws *ws_by_id(struct wayws_state *state, const char *id) {
+  return strmap_get(&state->ws_by_id, id);
+}
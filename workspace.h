@@ -3,11 +3,38 @@
 
 #include "types.h"
 
+void model_init(struct wayws_state *state);
+void model_destroy(struct wayws_state *state);
 void list_ws(struct wayws_state *state, struct ws *w);
-struct ws *ctx_of(struct ext_workspace_handle_v1 *h);
-struct workspace_group *group_ctx_of(struct ext_workspace_group_handle_v1 *h);
+void unlist_ws(struct wayws_state *state, struct ws *w);
+void group_add_ws(struct workspace_group *g, struct ws *w);
+void group_remove_ws(struct workspace_group *g, struct ws *w);
+struct ws *ctx_of(struct wayws_state *state, struct ext_workspace_handle_v1 *h);
+void ws_destroy(struct wayws_state *state, struct ws *w);
+void output_set_name(struct wayws_state *state, struct output *o,
+                     const char *name);
+void output_destroy(struct wayws_state *state, struct output *o);
+struct group_output *group_output_link(struct wayws_state *state,
+                                       struct workspace_group *g,
+                                       struct output *o);
+void group_output_unlink(struct wayws_state *state, struct workspace_group *g,
+                         struct output *o);
+// Remembers the output g shows w on, before the two part
+void ws_leave_group(struct ws *w, const struct workspace_group *g);
+// The output_names id of the output w is on, or was last on once it has
+// none (a removed workspace has usually left its group already); 0 if never
+uint32_t ws_output_id(const struct ws *w);
+struct workspace_group *group_ctx_of(struct wayws_state *state,
+                                     struct ext_workspace_group_handle_v1 *h);
+void group_destroy(struct wayws_state *state, struct workspace_group *g);
 size_t group_size(struct wayws_state *state, struct workspace_group *g);
 struct ws *current_ws(struct wayws_state *state, size_t *out);
 struct ws *neighbor(struct wayws_state *state, enum dir d);
+struct ws *find_target_workspace(struct wayws_state *state);
+void ws_set_name(struct wayws_state *state, struct ws *w, const char *name);
+void ws_set_id(struct wayws_state *state, struct ws *w, const char *id);
+void ws_unindex(struct wayws_state *state, struct ws *w);
+struct ws *ws_by_name(struct wayws_state *state, const char *name);
+struct ws *ws_by_id(struct wayws_state *state, const char *id);
 
 #endif // WORKSPACE_H
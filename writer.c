@@ -0,0 +1,207 @@
+#define _GNU_SOURCE
+
+#include "writer.h"
+#include <errno.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <time.h>
+#include <unistd.h>
+
+static void wake(int fd) {
+  uint64_t one = 1;
+  ssize_t r = write(fd, &one, sizeof one);
+  (void)r; // the counter only overflows after 2^64 - 1 unread wakeups
+}
+
+static size_t depth(struct writer *w) {
+  return atomic_load(&w->head) - atomic_load(&w->tail);
+}
+
+static void *writer_main(void *arg) {
+  struct writer *w = arg;
+  size_t tail = atomic_load_explicit(&w->tail, memory_order_relaxed);
+  for (;;) {
+    size_t head = atomic_load_explicit(&w->head, memory_order_acquire);
+    if (head == tail) {
+      if (atomic_load(&w->stop))
+        break;
+      // Pairs with writer_push(): either it sees sleeping set and wakes
+      // us, or we see its new head here
+      atomic_store(&w->sleeping, 1);
+      if (atomic_load(&w->head) == tail && !atomic_load(&w->stop)) {
+        uint64_t n;
+        ssize_t r = read(w->wake, &n, sizeof n);
+        (void)r;
+      }
+      atomic_store(&w->sleeping, 0);
+      continue;
+    }
+    // Up to the end of the ring; the rest on the next round
+    size_t off = tail & (w->cap - 1);
+    size_t len = head - tail;
+    if (len > w->cap - off)
+      len = w->cap - off;
+    ssize_t n = atomic_load_explicit(&w->failed, memory_order_relaxed)
+                    ? (ssize_t)len
+                    : write(w->fd, w->ring + off, len);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0) {
+      // Same as outbuf_flush(): the data is dropped, the loop goes on
+      atomic_store_explicit(&w->failed, 1, memory_order_relaxed);
+      n = (ssize_t)len;
+    }
+    tail += (size_t)n;
+    // Pairs with writer_want_room(): either it sees the new tail or we see
+    // want_room set
+    atomic_store(&w->tail, tail);
+    if (atomic_load(&w->want_room) && depth(w) <= WRITER_BACKED_UP_AT / 2 &&
+        atomic_exchange(&w->want_room, 0))
+      wake(w->room);
+  }
+  return NULL;
+}
+
+struct writer *writer_start(int fd, size_t cap) {
+  struct writer *w = calloc(1, sizeof *w);
+  if (!w)
+    return NULL;
+  w->ring = malloc(cap);
+  w->cap = cap;
+  w->fd = fd;
+  w->wake = eventfd(0, EFD_CLOEXEC);
+  w->room = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (!w->ring || w->wake < 0 || w->room < 0) {
+    if (w->wake >= 0)
+      close(w->wake);
+    if (w->room >= 0)
+      close(w->room);
+    free(w->ring);
+    free(w);
+    return NULL;
+  }
+  // Signals are for the main loop; only SIGPIPE, raised by the thread's own
+  // write(), stays deliverable so a closed pipe still ends us as before
+  sigset_t all, old;
+  sigfillset(&all);
+  sigdelset(&all, SIGPIPE);
+  pthread_sigmask(SIG_SETMASK, &all, &old);
+  int err = pthread_create(&w->thread, NULL, writer_main, w);
+  pthread_sigmask(SIG_SETMASK, &old, NULL);
+  if (err != 0) {
+    close(w->wake);
+    close(w->room);
+    free(w->ring);
+    free(w);
+    return NULL;
+  }
+  return w;
+}
+
+static void ring_copy(struct writer *w, size_t head, const char *buf,
+                      size_t len) {
+  size_t off = head & (w->cap - 1);
+  size_t first = len < w->cap - off ? len : w->cap - off;
+  memcpy(w->ring + off, buf, first);
+  memcpy(w->ring, buf + first, len - first);
+}
+
+void writer_push(struct writer *w, const char *buf, size_t len) {
+  size_t head = atomic_load_explicit(&w->head, memory_order_relaxed);
+  size_t tail = atomic_load_explicit(&w->tail, memory_order_acquire);
+  size_t room = w->cap - (head - tail);
+  if (len <= room) {
+    ring_copy(w, head, buf, len);
+    head += len;
+  } else {
+    // As many whole lines as fit, in order; the rest is lost
+    const char *p = buf, *end = buf + len;
+    while (p < end) {
+      const char *nl = memchr(p, '\n', (size_t)(end - p));
+      size_t n = nl ? (size_t)(nl - p) + 1 : (size_t)(end - p);
+      if (n <= room) {
+        ring_copy(w, head, p, n);
+        head += n;
+        room -= n;
+      } else {
+        w->dropped++;
+      }
+      p += n;
+    }
+  }
+  if (head - tail > w->high_water)
+    w->high_water = head - tail;
+  atomic_store(&w->head, head);
+  if (atomic_load(&w->sleeping))
+    wake(w->wake);
+}
+
+void writer_get_stats(struct writer *w, struct writer_stats *st) {
+  size_t head = atomic_load_explicit(&w->head, memory_order_relaxed);
+  size_t tail = atomic_load_explicit(&w->tail, memory_order_acquire);
+  *st = (struct writer_stats){
+      .cap = w->cap,
+      .depth = head - tail,
+      .high_water = w->high_water,
+      .dropped = w->dropped,
+      .failed = atomic_load_explicit(&w->failed, memory_order_relaxed),
+  };
+}
+
+int writer_backed_up(struct writer *w) {
+  return depth(w) > WRITER_BACKED_UP_AT;
+}
+
+int writer_want_room(struct writer *w) {
+  uint64_t n;
+  ssize_t r = read(w->room, &n, sizeof n); // an earlier signal is spent
+  (void)r;
+  atomic_store(&w->want_room, 1);
+  if (depth(w) > WRITER_BACKED_UP_AT / 2)
+    return 0;
+  atomic_store(&w->want_room, 0);
+  return 1;
+}
+
+int writer_room_fd(const struct writer *w) { return w->room; }
+
+// Lines (or what is left of one) queued between tail and head
+static unsigned long count_lines(const struct writer *w, size_t tail,
+                                 size_t head) {
+  unsigned long n = 0;
+  for (size_t i = tail; i != head; i++)
+    n += w->ring[i & (w->cap - 1)] == '\n';
+  return n + (head != tail && w->ring[(head - 1) & (w->cap - 1)] != '\n');
+}
+
+void writer_stop(struct writer *w, struct writer_stats *st) {
+  if (!w)
+    return;
+  atomic_store(&w->stop, 1);
+  wake(w->wake);
+  // The thread may be stuck in write() on a reader that never reads again;
+  // exiting must not wait for it. write() is a cancellation point.
+  struct timespec deadline;
+  clock_gettime(CLOCK_REALTIME, &deadline);
+  deadline.tv_sec += WRITER_STOP_MS / 1000;
+  deadline.tv_nsec += (long)(WRITER_STOP_MS % 1000) * 1000000;
+  if (deadline.tv_nsec >= 1000000000) {
+    deadline.tv_sec++;
+    deadline.tv_nsec -= 1000000000;
+  }
+  if (pthread_timedjoin_np(w->thread, NULL, &deadline) != 0) {
+    pthread_cancel(w->thread);
+    pthread_join(w->thread, NULL);
+    size_t head = atomic_load(&w->head), tail = atomic_load(&w->tail);
+    w->dropped += count_lines(w, tail, head);
+    atomic_store(&w->tail, head);
+  }
+  if (st)
+    writer_get_stats(w, st);
+  close(w->wake);
+  close(w->room);
+  free(w->ring);
+  free(w);
+}
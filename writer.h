@@ -0,0 +1,65 @@
+#ifndef WRITER_H
+#define WRITER_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Watch mode's stdout, written from a thread of its own. The main loop
+// copies each batch of lines into a single-producer/single-consumer ring
+// and carries on dispatching; the thread does the blocking write()s. A
+// stalled reader of our stdout therefore fills the ring instead of stalling
+// Wayland dispatch. Lines that do not fit are dropped whole and counted.
+#define WRITER_RING_SIZE (4u << 20)
+// Past this much queued output the reader counts as behind, and watch mode
+// holds events back in its backlog (see backlog.h) instead of queueing them
+#define WRITER_BACKED_UP_AT (64u << 10)
+// How long writer_stop() lets a slow reader take what is still queued
+#define WRITER_STOP_MS 1000
+
+struct writer_stats {
+  size_t cap;
+  size_t depth;      // bytes queued right now
+  size_t high_water; // most bytes ever queued at once
+  unsigned long dropped; // lines that did not fit, or never went out
+  int failed;            // a write() failed; output is being discarded
+};
+
+struct writer {
+  char *ring;
+  size_t cap; // power of two
+  int fd;
+  // head is only written by the producer and tail by the writer thread;
+  // each side only reads the other's
+  _Atomic size_t head, tail;
+  _Atomic int sleeping; // the thread is (about to be) waiting on wake
+  _Atomic int stop;
+  _Atomic int failed;
+  _Atomic int want_room; // signal room once half of WRITER_BACKED_UP_AT is left
+  int wake;              // eventfd
+  int room;              // eventfd, see writer_want_room()
+  pthread_t thread;
+  // Producer side only
+  size_t high_water;
+  unsigned long dropped;
+};
+
+// Starts the thread writing to fd; cap must be a power of two. Returns
+// NULL if it cannot, and the caller keeps writing fd itself.
+struct writer *writer_start(int fd, size_t cap);
+// Queues the newline-terminated lines in buf[0, len) without blocking
+void writer_push(struct writer *w, const char *buf, size_t len);
+void writer_get_stats(struct writer *w, struct writer_stats *st);
+// Whether more than WRITER_BACKED_UP_AT bytes are waiting
+int writer_backed_up(struct writer *w);
+// Nonzero if the queue is down to half of WRITER_BACKED_UP_AT. Otherwise
+// writer_room_fd() becomes readable once it is.
+int writer_want_room(struct writer *w);
+int writer_room_fd(const struct writer *w);
+// Writes out whatever is still queued, ends the thread and frees w. A
+// reader that has not taken it all within WRITER_STOP_MS loses the rest,
+// counted as dropped lines. The final stats go to st unless it is NULL.
+void writer_stop(struct writer *w, struct writer_stats *st);
+
+#endif // WRITER_H